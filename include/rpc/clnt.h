@@ -275,6 +275,23 @@ struct rpc_timers {
  */
 #define CLSET_RETRY_TIMEOUT 4   /* set retry timeout (timeval) */
 #define CLGET_RETRY_TIMEOUT 5   /* get retry timeout (timeval) */
+#define	CLGET_RTT		19	/* get rtt estimate (clnt_rtt) */
+
+/*
+ * Round trip estimate of the server endpoint, see CLGET_RTT; shared by
+ * all connectionless handles addressing the endpoint.  Procedures are
+ * estimated by timer class, the one reported is that of the handle's last
+ * call.  The adaptive timeout never retransmits more often than the retry
+ * timeout; setting CLSET_RETRY_TIMEOUT disables it for that handle.
+ */
+struct clnt_rtt {
+	struct timeval	cr_srtt;	/* smoothed round trip time */
+	struct timeval	cr_rttvar;	/* round trip variance */
+	struct timeval	cr_rto;		/* retransmit timeout */
+	u_long		cr_samples;	/* replies sampled */
+	u_long		cr_timeouts;	/* calls timed out */
+	int		cr_adaptive;	/* rto applies to this handle */
+};
 
 /*
  * void
@@ -345,6 +362,52 @@ LIBRPC_API CLIENT *clnt_create_vers(const char *, const rpcprog_t, rpcvers_t *,
  */
 
 
+/*
+ * Pooled client creation; leases a handle from the process wide pool,
+ * creating one with clnt_create() as required.  Leased handles are
+ * returned with clnt_pool_put(), never destroyed; set discard after a
+ * transport failure.  See rpc_control(RPC_CLNT_POOL_*).
+ */
+LIBRPC_API CLIENT *clnt_pool_get(const char *, const rpcprog_t,
+				  const rpcvers_t, const char *);
+LIBRPC_API void clnt_pool_put(CLIENT *, int);
+/*
+ *	const char *hostname;			-- hostname
+ *	const rpcprog_t prog;			-- program number
+ *	const rpcvers_t vers;			-- version number
+ *	const char *nettype;			-- network type
+ *
+ *	CLIENT *clnt;				-- leased handle
+ *	int discard;				-- destroy, do not reuse
+ */
+
+/*
+ * Asynchronous calls; the call is queued and done(stat, res, cookie)
+ * called once its reply is received, within clnt_async_wait() or a later
+ * clnt_call_async().  Calls pipeline on connection-oriented handles,
+ * elsewhere they complete before clnt_call_async() returns.
+ */
+typedef void (*clnt_done_t)(enum clnt_stat, caddr_t, void *);
+
+LIBRPC_API enum clnt_stat clnt_call_async(CLIENT *, rpcproc_t, xdrproc_t,
+				   const char *, xdrproc_t, caddr_t,
+				   clnt_done_t, void *, struct timeval);
+LIBRPC_API enum clnt_stat clnt_async_wait(CLIENT *, u_int, struct timeval);
+/*
+ *	CLIENT *clnt;				-- client handle
+ *	rpcproc_t proc;				-- procedure number
+ *	xdrproc_t xargs;			-- xdr routine for args
+ *	const char *argsp;			-- pointer to args
+ *	xdrproc_t xres;				-- xdr routine for results
+ *	caddr_t resp;				-- pointer to results
+ *	clnt_done_t done;			-- completion routine
+ *	void *cookie;				-- ... and its argument
+ *	struct timeval timeout;			-- reply timeout
+ *
+ *	u_int max;				-- wait until no more
+ *						   calls outstanding
+ */
+
 /*
  * Generic client creation routine. It takes a netconfig structure
  * instead of nettype
@@ -406,6 +469,22 @@ LIBRPC_API CLIENT *clnt_dg_create(const int, const struct netbuf *,
  *	const unsigned recvsz;			-- buffer send size
  */
 
+/*
+ * Low level clnt create routine for connectionless transports, where the
+ * socket is shared by any number of handles and concurrent calls.
+ */
+LIBRPC_API CLIENT *clnt_dg_mux_create(const int, const struct netbuf *,
+				   const rpcprog_t, const rpcvers_t,
+				   /*const*/ unsigned int, /*const*/ unsigned int);
+/*
+ *	const int fd;				-- open file descriptor
+ *	const struct netbuf *svcaddr;		-- servers address
+ *	const rpcprog_t program;		-- program number
+ *	const rpcvers_t version;		-- version number
+ *	const unsigned sendsz;			-- buffer send size
+ *	const unsigned recvsz;			-- buffer recv size
+ */
+
 /*
  * Memory based rpc (for speed check and testing)
  * CLIENT *
@@ -518,10 +597,37 @@ __END_DECLS
  *	const int 		inittime;	-- how long to wait initially
  *	const int 		waittime;	-- maximum time to wait
  *	const char		*nettype;	-- Transport type
+ *
+ * extern enum clnt_stat
+ * rpc_broadcast_opts(prog, vers, proc, xargs, argsp, xresults, resultsp,
+ *			eachresult, inittime, waittime, nettype, opts)
+ *	...					-- as rpc_broadcast_exp()
+ *	struct rpc_bcastopts	*opts;		-- options and counters
+ *
+ * When opts->bo_workers is non-zero, eachresult is called concurrently
+ * from that many threads, each with its own results of bo_ressize bytes;
+ * replies are queued for them and dropped when the queue is full.
  */
 
 typedef bool_t (*resultproc_t)(caddr_t, ...);
 
+struct rpc_bcaststats {
+	u_long	bs_sent;		/* requests sent */
+	u_long	bs_received;		/* replies received */
+	u_long	bs_stray;		/* datagrams not replies to us */
+	u_long	bs_dropped;		/* replies lost, queue full */
+	u_long	bs_results;		/* replies passed to eachresult */
+	u_int	bs_maxqueued;		/* queue high water mark */
+};
+
+struct rpc_bcastopts {
+	u_int	bo_workers;		/* callback threads, 0 = inline */
+	u_int	bo_queuelen;		/* reply queue, 0 = default */
+	u_int	bo_ressize;		/* size of results, for workers */
+	int	bo_rcvbuf;		/* socket receive buffer, 0 = default */
+	struct rpc_bcaststats bo_stats;	/* returned */
+};
+
 __BEGIN_DECLS
 LIBRPC_API enum clnt_stat rpc_broadcast(const rpcprog_t, const rpcvers_t,
     const rpcproc_t, const xdrproc_t, const char *, const xdrproc_t, caddr_t,
@@ -529,6 +635,10 @@ LIBRPC_API enum clnt_stat rpc_broadcast(const rpcprog_t, const rpcvers_t,
 LIBRPC_API enum clnt_stat rpc_broadcast_exp(const rpcprog_t, const rpcvers_t,
     const rpcproc_t, const xdrproc_t, const char *, const xdrproc_t, caddr_t,
     const resultproc_t, const int, const int, const char *);
+LIBRPC_API enum clnt_stat rpc_broadcast_opts(const rpcprog_t, const rpcvers_t,
+    const rpcproc_t, const xdrproc_t, const char *, const xdrproc_t, caddr_t,
+    const resultproc_t, const int, const int, const char *,
+    struct rpc_bcastopts *);
 __END_DECLS
 
 /* For backward compatibility */
@@ -60,5 +60,92 @@ __END_DECLS
  */
 #define RPC_SVC_CONNMAXREC_SET	0	/* set max rec size, enable nonblock */
 #define RPC_SVC_CONNMAXREC_GET	1
+#define RPC_CLNT_RPCBCACHE_STATS 2	/* get rpcbind address cache stats */
+#define RPC_CLNT_RPCBCACHE_FLUSH 3	/* discard cached addresses */
+#define RPC_SVC_AUTHSTATS_GET	4	/* get per-flavor auth counters */
+#define RPC_CLNT_POOL_STATS	5	/* get client pool counters */
+#define RPC_CLNT_POOL_GETPARAMS	6	/* get client pool limits */
+#define RPC_CLNT_POOL_SETPARAMS	7	/* set client pool limits */
+#define RPC_CLNT_POOL_FLUSH	8	/* destroy idle pooled handles */
+#define RPC_SVC_MTMODE_SET	9	/* set the svc_run() threading mode */
+#define RPC_SVC_MTMODE_GET	10
+#define RPC_SVC_THRMAX_SET	11	/* set the svc_run() worker count */
+#define RPC_SVC_THRMAX_GET	12
+#define RPC_SVC_PROCSTATS_GET	13	/* get per-procedure counters */
+#define RPC_SVC_PROCSTATS_RESET	14	/* zero them, by program version */
+
+/*
+ * Threading modes, see RPC_SVC_MTMODE_SET.
+ */
+#define RPC_SVC_MT_NONE		0	/* single threaded (default) */
+#define RPC_SVC_MT_AUTO		1	/* transports served by a worker pool */
+
+/*
+ * Client rpcbind address cache statistics, see RPC_CLNT_RPCBCACHE_STATS.
+ */
+struct rpcb_cachestats {
+	u_long	rc_lookups;		/* cache lookups */
+	u_long	rc_hits;		/* ... answered with an address */
+	u_long	rc_neghits;		/* ... answered "not registered" */
+	u_long	rc_inserts;		/* entries added */
+	u_long	rc_evictions;		/* entries evicted when full */
+	u_long	rc_invalidations;	/* entries dropped on failure */
+	u_int	rc_entries;		/* current entries */
+};
+
+/*
+ * Server authentication counters, see RPC_SVC_AUTHSTATS_GET; the caller
+ * names the flavor.
+ */
+struct svc_authstats {
+	int	as_flavor;		/* in: credential flavor */
+	u_long	as_ok;			/* requests authenticated */
+	u_long	as_failed;		/* requests rejected */
+};
+
+/*
+ * Per-procedure service statistics, see RPC_SVC_PROCSTATS_GET; the
+ * caller names the procedure.  Kept by the dispatchers of rpcgen -T;
+ * the mean service time is ps_usecs / ps_calls.
+ * RPC_SVC_PROCSTATS_RESET takes the program version, or NULL for all.
+ */
+struct svc_procstats {
+	rpcprog_t ps_prog;		/* in: program */
+	rpcvers_t ps_vers;		/* in: version */
+	rpcproc_t ps_proc;		/* in: procedure */
+	u_long	ps_calls;		/* requests dispatched */
+	u_long	ps_errors;		/* ... undecodable, or reply failed */
+	uint64_t ps_usecs;		/* cumulative service time, usecs */
+};
+
+/*
+ * Client pool limits, see RPC_CLNT_POOL_SETPARAMS; times in seconds.
+ */
+struct clnt_poolparams {
+	u_int	cp_maxconn;		/* handles per endpoint, > 0 */
+	u_int	cp_idle;		/* destroy handles idle this long */
+	u_int	cp_check;		/* ping handles idle this long */
+	u_int	cp_wait;		/* wait at the cap this long */
+};
+
+/*
+ * Client pool statistics, see RPC_CLNT_POOL_STATS; the reuse rate is
+ * cp_reuses / cp_leases.
+ */
+struct clnt_poolstats {
+	u_long	cp_leases;		/* clnt_pool_get() calls */
+	u_long	cp_reuses;		/* ... answered with an idle handle */
+	u_long	cp_creates;		/* handles created */
+	u_long	cp_createfails;		/* ... creation failures */
+	u_long	cp_checks;		/* idle handles pinged */
+	u_long	cp_checkfails;		/* ... found dead */
+	u_long	cp_evictions;		/* idle handles expired */
+	u_long	cp_discards;		/* handles discarded on return */
+	u_long	cp_waits;		/* waits at the endpoint cap */
+	u_long	cp_timeouts;		/* ... which timed out */
+	u_int	cp_endpoints;		/* current endpoints */
+	u_int	cp_idle;		/* current idle handles */
+	u_int	cp_leased;		/* current leased handles */
+};
 
 #endif /* _RPC_RPCCOM_H */
@@ -276,6 +276,31 @@ LIBRPC_API int	rpc_reg(rpcprog_t, rpcvers_t, rpcproc_t,
 			     char *);
 __END_DECLS
 
+/*
+ * Per-procedure counters, kept by table-driven dispatchers (rpcgen -T)
+ * and read by rpc_control(RPC_SVC_PROCSTATS_GET).
+ *
+ * svc_proccount_reg(prog, vers, counts, nproc)
+ *	counts: struct svc_proccount[nproc], indexed by procedure
+ * svc_proccount_start(start)
+ *	start: struct timeval *, the request's start
+ * svc_proccount_done(pc, start, failed)
+ *	pc: struct svc_proccount *, the procedure's counters
+ */
+struct svc_proccount {
+	u_long	pc_calls;		/* requests dispatched */
+	u_long	pc_errors;		/* ... undecodable, or reply failed */
+	uint64_t pc_usecs;		/* cumulative service time, usecs */
+};
+
+__BEGIN_DECLS
+LIBRPC_API bool_t svc_proccount_reg(rpcprog_t, rpcvers_t,
+			     struct svc_proccount *, u_int);
+LIBRPC_API void	svc_proccount_start(struct timeval *);
+LIBRPC_API void	svc_proccount_done(struct svc_proccount *,
+			     const struct timeval *, bool_t);
+__END_DECLS
+
 /*
  * Lowest level dispatching -OR- who owns this process anyway.
  * Somebody has to wait for incoming requests and then call the correct
@@ -0,0 +1,398 @@
+/*
+ *  C++ XDR bindings support, see rpcgen -x.
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+#ifndef _RPC_XDR_CXX_H
+#define	_RPC_XDR_CXX_H
+
+/*
+ * xdr_cxx.h
+ *
+ * Marshaling for the types generated by rpcgen -x.  Each type T has a
+ * specialization of rpcxx::codec<T> whose encode() and decode() are
+ * inline, so a structure is marshaled by direct calls resolved at
+ * compile time rather than through xdrproc_t pointers.
+ *
+ * Owned types hold their data in std::string, std::vector, std::array
+ * and std::unique_ptr and are move-only.  Each also has a _view form
+ * in which strings and variable length opaques are std::string_view
+ * and rpcxx::opaque_view, borrowing from the decode buffer: valid only
+ * while that buffer is, and decoded only when the stream can lend the
+ * bytes (XDR_INLINE), as memory streams always can.
+ *
+ * rpcxx::xdrproc<T>() adapts a codec for clnt_call() and svc_getargs().
+ */
+
+#if !defined(__cplusplus)
+#error rpc/xdr_cxx.h requires C++
+#endif
+
+#include <rpc/rpc.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if (__cplusplus >= 202002L) || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#include <span>
+#define	RPCXX_SPAN
+#endif
+
+namespace rpcxx {
+
+/*
+ * Borrowed variable length opaque data.
+ */
+#if defined(RPCXX_SPAN)
+typedef std::span<const char> opaque_view;
+#else
+class opaque_view {
+public:
+	typedef const char element_type;
+	typedef char value_type;
+	typedef std::size_t size_type;
+	typedef const char *iterator;
+
+	constexpr opaque_view() noexcept : data_(nullptr), size_(0) { }
+	constexpr opaque_view(const char *data, std::size_t size) noexcept :
+		data_(data), size_(size) { }
+	opaque_view(const std::vector<char> &v) noexcept :
+		data_(v.data()), size_(v.size()) { }
+
+	constexpr const char *data() const noexcept { return data_; }
+	constexpr std::size_t size() const noexcept { return size_; }
+	constexpr bool empty() const noexcept { return size_ == 0; }
+	constexpr const char *begin() const noexcept { return data_; }
+	constexpr const char *end() const noexcept { return data_ + size_; }
+	constexpr const char &operator[](std::size_t i) const { return data_[i]; }
+
+private:
+	const char *data_;
+	std::size_t size_;
+};
+#endif
+
+/*
+ * Type marshaling; specialized for every type.
+ */
+template <class T, class Enable = void> struct codec;
+
+template <class T> inline bool
+encode(XDR *xdrs, const T &v)
+{
+	return codec<T>::encode(xdrs, v);
+}
+
+template <class T> inline bool
+decode(XDR *xdrs, T &v)
+{
+	return codec<T>::decode(xdrs, v);
+}
+
+/*
+ * Primitives, by the stream's routines.
+ */
+#define	RPCXX_PRIMITIVE(T, proc)					\
+	template <> struct codec<T> {					\
+		static bool encode(XDR *xdrs, const T &v) {		\
+			T t = v;					\
+			return (proc(xdrs, &t) != 0);			\
+		}							\
+		static bool decode(XDR *xdrs, T &v) {			\
+			return (proc(xdrs, &v) != 0);			\
+		}							\
+	}
+
+RPCXX_PRIMITIVE(char, xdr_char);
+RPCXX_PRIMITIVE(unsigned char, xdr_u_char);
+RPCXX_PRIMITIVE(int16_t, xdr_int16_t);
+RPCXX_PRIMITIVE(uint16_t, xdr_u_int16_t);
+RPCXX_PRIMITIVE(int32_t, xdr_int32_t);
+RPCXX_PRIMITIVE(uint32_t, xdr_u_int32_t);
+RPCXX_PRIMITIVE(int64_t, xdr_int64_t);
+RPCXX_PRIMITIVE(uint64_t, xdr_u_int64_t);
+RPCXX_PRIMITIVE(float, xdr_float);
+RPCXX_PRIMITIVE(double, xdr_double);
+RPCXX_PRIMITIVE(long double, xdr_quadruple);
+
+#undef	RPCXX_PRIMITIVE
+
+template <> struct codec<bool> {
+	static bool encode(XDR *xdrs, const bool &v) {
+		bool_t t = v ? TRUE : FALSE;
+		return (xdr_bool(xdrs, &t) != 0);
+	}
+	static bool decode(XDR *xdrs, bool &v) {
+		bool_t t;
+		if (!xdr_bool(xdrs, &t))
+			return false;
+		v = (t != FALSE);
+		return true;
+	}
+};
+
+/*
+ * Enumerations, as int.
+ */
+template <class T>
+struct codec<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+	static bool encode(XDR *xdrs, const T &v) {
+		int32_t t = static_cast<int32_t>(v);
+		return (xdr_int32_t(xdrs, &t) != 0);
+	}
+	static bool decode(XDR *xdrs, T &v) {
+		int32_t t;
+		if (!xdr_int32_t(xdrs, &t))
+			return false;
+		v = static_cast<T>(t);
+		return true;
+	}
+};
+
+/*
+ * Fixed length arrays; opaque as bytes.
+ */
+template <class T, std::size_t N> struct codec<std::array<T, N> > {
+	static bool encode(XDR *xdrs, const std::array<T, N> &v) {
+		for (const T &e : v)
+			if (!codec<T>::encode(xdrs, e))
+				return false;
+		return true;
+	}
+	static bool decode(XDR *xdrs, std::array<T, N> &v) {
+		for (T &e : v)
+			if (!codec<T>::decode(xdrs, e))
+				return false;
+		return true;
+	}
+};
+
+template <std::size_t N> struct codec<std::array<char, N> > {
+	static bool encode(XDR *xdrs, const std::array<char, N> &v) {
+		return (xdr_opaque(xdrs, const_cast<char *>(v.data()),
+		    (u_int)N) != 0);
+	}
+	static bool decode(XDR *xdrs, std::array<char, N> &v) {
+		return (xdr_opaque(xdrs, v.data(), (u_int)N) != 0);
+	}
+};
+
+/*
+ * Optional data.
+ */
+template <class T> struct codec<std::unique_ptr<T> > {
+	static bool encode(XDR *xdrs, const std::unique_ptr<T> &v) {
+		bool_t more = (v ? TRUE : FALSE);
+		if (!xdr_bool(xdrs, &more))
+			return false;
+		return (!more || codec<T>::encode(xdrs, *v));
+	}
+	static bool decode(XDR *xdrs, std::unique_ptr<T> &v) {
+		bool_t more;
+		if (!xdr_bool(xdrs, &more))
+			return false;
+		if (!more) {
+			v.reset();
+			return true;
+		}
+		if (!v)
+			v.reset(new T());
+		return codec<T>::decode(xdrs, *v);
+	}
+};
+
+/*
+ * Bounded strings and variable length opaques.
+ */
+inline bool
+encode_bytes(XDR *xdrs, const char *data, std::size_t size, u_int maxsize)
+{
+	u_int len = (u_int)size;
+
+	if (size > maxsize || !xdr_u_int(xdrs, &len))
+		return false;
+	return (xdr_opaque(xdrs, const_cast<char *>(data), len) != 0);
+}
+
+inline bool
+encode_string(XDR *xdrs, std::string_view v, u_int maxsize)
+{
+	return encode_bytes(xdrs, v.data(), v.size(), maxsize);
+}
+
+inline bool
+decode_string(XDR *xdrs, std::string &v, u_int maxsize)
+{
+	u_int len;
+
+	if (!xdr_u_int(xdrs, &len) || len > maxsize)
+		return false;
+	v.resize(len);
+	return (xdr_opaque(xdrs, &v[0], len) != 0);
+}
+
+inline bool
+encode_bytes(XDR *xdrs, const std::vector<char> &v, u_int maxsize)
+{
+	return encode_bytes(xdrs, v.data(), v.size(), maxsize);
+}
+
+inline bool
+encode_bytes(XDR *xdrs, opaque_view v, u_int maxsize)
+{
+	return encode_bytes(xdrs, v.data(), v.size(), maxsize);
+}
+
+inline bool
+decode_bytes(XDR *xdrs, std::vector<char> &v, u_int maxsize)
+{
+	u_int len;
+
+	if (!xdr_u_int(xdrs, &len) || len > maxsize)
+		return false;
+	v.resize(len);
+	return (xdr_opaque(xdrs, v.data(), len) != 0);
+}
+
+/*
+ * Borrow len bytes, plus padding, from the stream.
+ */
+inline const char *
+borrow(XDR *xdrs, u_int len)
+{
+	if (len == 0)
+		return "";
+	if (RNDUP(len) < len)
+		return NULL;
+	return (const char *)XDR_INLINE(xdrs, RNDUP(len));
+}
+
+inline bool
+decode_string(XDR *xdrs, std::string_view &v, u_int maxsize)
+{
+	const char *data;
+	u_int len;
+
+	if (!xdr_u_int(xdrs, &len) || len > maxsize ||
+	    (data = borrow(xdrs, len)) == NULL)
+		return false;
+	v = std::string_view(data, len);
+	return true;
+}
+
+inline bool
+decode_bytes(XDR *xdrs, opaque_view &v, u_int maxsize)
+{
+	const char *data;
+	u_int len;
+
+	if (!xdr_u_int(xdrs, &len) || len > maxsize ||
+	    (data = borrow(xdrs, len)) == NULL)
+		return false;
+	v = opaque_view(data, len);
+	return true;
+}
+
+/*
+ * Bounded variable length arrays.
+ */
+template <class T> inline bool
+encode_array(XDR *xdrs, const std::vector<T> &v, u_int maxsize)
+{
+	u_int len = (u_int)v.size();
+
+	if (v.size() > maxsize || !xdr_u_int(xdrs, &len))
+		return false;
+	for (const T &e : v)
+		if (!codec<T>::encode(xdrs, e))
+			return false;
+	return true;
+}
+
+template <class T> inline bool
+decode_array(XDR *xdrs, std::vector<T> &v, u_int maxsize)
+{
+	u_int len, i;
+
+	if (!xdr_u_int(xdrs, &len) || len > maxsize)
+		return false;
+	v.clear();
+	v.reserve(len < 1024 ? len : 1024);	/* length is untrusted */
+	for (i = 0; i < len; i++) {
+		v.emplace_back();
+		if (!codec<T>::decode(xdrs, v.back()))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * xdrproc_t adaptor; owned types free themselves.
+ */
+template <class T> bool_t
+xdr_proc(XDR *xdrs, const void *objp)
+{
+	switch (xdrs->x_op) {
+	case XDR_ENCODE:
+		return codec<T>::encode(xdrs, *static_cast<const T *>(objp));
+	case XDR_DECODE:
+		return codec<T>::decode(xdrs,
+		    *static_cast<T *>(const_cast<void *>(objp)));
+	case XDR_FREE:
+		return TRUE;
+	}
+	return FALSE;
+}
+
+template <class T> inline xdrproc_t
+xdrproc()
+{
+	return &xdr_proc<T>;
+}
+
+/*
+ * No arguments or results.
+ */
+struct none { };
+
+template <> struct codec<none> {
+	static bool encode(XDR *, const none &) { return true; }
+	static bool decode(XDR *, none &) { return true; }
+};
+
+template <class A, class R> inline enum clnt_stat
+call(CLIENT *clnt, rpcproc_t proc, const A &arg, R &res,
+    struct timeval timeout)
+{
+	return clnt_call(clnt, proc, xdrproc<A>(), &arg, xdrproc<R>(), &res,
+	    timeout);
+}
+
+}	/* namespace rpcxx */
+
+#endif	/* _RPC_XDR_CXX_H */
@@ -36,6 +36,7 @@ __RCSID("$NetBSD: __rpc_getxid.c,v 1.3 2003/09/13 21:27:46 itojun Exp $");
 #endif
 
 #include "namespace.h"
+#include "reentrant.h"
 
 #include <sys/types.h>
 #include <stdlib.h>
@@ -43,16 +44,93 @@ __RCSID("$NetBSD: __rpc_getxid.c,v 1.3 2003/09/13 21:27:46 itojun Exp $");
 #include <rpc/rpc.h>
 #include "rpc_internal.h"
 
+/*
+ * Transaction ids are the image of a counter under a keyed 32-bit
+ * permutation (a balanced Feistel network on 16-bit halves), the key
+ * being drawn once from randomid().  As the permutation is a bijection,
+ * distinct counter values give distinct ids; each thread reserves a
+ * block of counter values from a shared counter and then draws ids
+ * without further synchronisation, so ids cannot collide within the
+ * process until 2^32 have been issued.
+ */
+#define	XID_ROUNDS	6		/* Feistel rounds */
+#define	XID_BLOCK	1024		/* counter values reserved per thread */
+
+static u_int32_t xid_key[XID_ROUNDS];
+static volatile u_int32_t xid_counter;
+
+#if defined(_WIN32)
+#define	XID_RESERVE()	((u_int32_t)InterlockedExchangeAdd((LONG volatile *)&xid_counter, XID_BLOCK))
+#else
+#define	XID_RESERVE()	__atomic_fetch_add(&xid_counter, XID_BLOCK, __ATOMIC_RELAXED)
+#endif
+
+#if defined(__MINGW32__)
+#define	XID_THREAD	__thread
+#elif defined(_WIN32)
+#define	XID_THREAD	__declspec(thread)
+#else
+#define	XID_THREAD	__thread
+#endif
+
+static XID_THREAD u_int32_t xid_next, xid_limit;
+
+#ifdef _REENTRANT
+static once_t xid_once = ONCE_INITIALIZER;
+#else
+static int xid_ready;
+#endif
+
+static void xid_setup(void);
+static u_int32_t xid_permute(u_int32_t);
+
+static void
+xid_setup(void)
+{
+	randomid_t ctx;
+	int i;
+
+	ctx = randomid_new(32, RANDOMID_TIMEO_DEFAULT);
+	if (!ctx)
+		abort();
+	for (i = 0; i < XID_ROUNDS; ++i)
+		xid_key[i] = randomid(ctx);
+	xid_counter = randomid(ctx);
+	randomid_delete(ctx);
+}
+
+static u_int32_t
+xid_permute(u_int32_t x)
+{
+	u_int32_t l = x >> 16, r = x & 0xffff, f;
+	int i;
+
+	for (i = 0; i < XID_ROUNDS; ++i) {
+		f = (r ^ xid_key[i]) * 0x9e3779b1U;
+		f ^= f >> 15;
+		f = (f * 0x85ebca6bU) >> 16;
+		f = l ^ f;
+		l = r;
+		r = f;
+	}
+	return ((l << 16) | r);
+}
+
 u_int32_t
 __rpc_getxid(void)
 {
-	static randomid_t ctx = NULL;
 
-	if (!ctx) {
-		ctx = randomid_new(32, RANDOMID_TIMEO_DEFAULT);
-		if (!ctx)
-			abort();
+	if (xid_next == xid_limit) {
+#ifdef _REENTRANT
+		thr_once(&xid_once, xid_setup);
+#else
+		if (!xid_ready) {
+			xid_setup();
+			xid_ready = 1;
+		}
+#endif
+		xid_next = XID_RESERVE();
+		xid_limit = xid_next + XID_BLOCK;
 	}
-
-	return randomid(ctx);
+	return xid_permute(xid_next++);
 }
@@ -57,6 +57,9 @@ __RCSID("$NetBSD: auth_none.c,v 1.16 2013/03/11 20:19:28 tron Exp $");
 #include <rpc/types.h>
 #include <rpc/xdr.h>
 #include <rpc/auth.h>
+#include <rpc/rpc.h>
+
+#include "rpc_internal.h"
 
 #ifdef __weak_alias
 __weak_alias(authnone_create,_authnone_create)
@@ -129,6 +132,22 @@ authnone_marshal(AUTH *client, XDR *xdrs)
 	    ap->marshalled_client, ap->mcnt));
 }
 
+/*
+ * Returns the marshalled credential and verifier, which never change.
+ */
+bool_t
+__authnone_image(AUTH *client, const char **image, u_int *len, u_int *gen)
+{
+	struct authnone_private *ap = authnone_private;
+
+	if (ap == 0 || client != &ap->no_client)
+		return (FALSE);
+	*image = ap->marshalled_client;
+	*len = ap->mcnt;
+	*gen = 0;
+	return (TRUE);
+}
+
 /*ARGSUSED*/
 static void 
 authnone_verf(AUTH *client)
@@ -69,6 +69,9 @@ __RCSID("$NetBSD: auth_unix.c,v 1.26 2014/10/18 08:33:23 snj Exp $");
 #include <rpc/xdr.h>
 #include <rpc/auth.h>
 #include <rpc/auth_unix.h>
+#include <rpc/rpc.h>
+
+#include "rpc_internal.h"
 
 #ifdef __weak_alias
 __weak_alias(authunix_create,_authunix_create)
@@ -94,9 +97,22 @@ struct audata {
 	u_long			au_shfaults;	/* short hand cache faults */
 	char			au_marshed[MAX_AUTH_BYTES];
 	u_int			au_mpos;	/* xdr pos at end of marshed */
+	u_int			au_gen;		/* au_marshed generation */
 };
 #define	AUTH_PRIVATE(auth)	((struct audata *)auth->ah_private)
 
+/*
+ * Generations are unique within the process, so a client template
+ * cannot mistake a new handle at a recycled address for an old one.
+ */
+static volatile u_int au_generation;
+
+#if defined(_WIN32)
+#define	AU_NEXTGEN()	((u_int)InterlockedIncrement((LONG volatile *)&au_generation))
+#else
+#define	AU_NEXTGEN()	__atomic_add_fetch(&au_generation, 1, __ATOMIC_RELAXED)
+#endif
+
 #if defined(_WIN32)
 LIBRPC_API const struct opaque_auth *
 _svcauth_null_auth(void)
@@ -345,7 +361,7 @@ authunix_destroy(AUTH *auth)
 
 /*
  * Marshals (pre-serializes) an auth struct.
- * sets private data, au_marshed and au_mpos
+ * sets private data, au_marshed, au_mpos and au_gen
  */
 static void
 marshal_new_auth(AUTH *auth)
@@ -363,9 +379,28 @@ marshal_new_auth(AUTH *auth)
 		warnx("%s: Fatal marshalling problem", __func__);
 	else
 		au->au_mpos = XDR_GETPOS(xdrs);
+	au->au_gen = AU_NEXTGEN();
 	XDR_DESTROY(xdrs);
 }
 
+/*
+ * Returns the marshalled credential and verifier, which are constant
+ * between refreshes, and their generation; see clnt_dg.c and clnt_vc.c.
+ */
+bool_t
+__authunix_image(AUTH *auth, const char **image, u_int *len, u_int *gen)
+{
+	struct audata *au;
+
+	if (auth->ah_ops->ah_marshal != authunix_marshal)
+		return (FALSE);
+	au = AUTH_PRIVATE(auth);
+	*image = au->au_marshed;
+	*len = au->au_mpos;
+	*gen = au->au_gen;
+	return (TRUE);
+}
+
 static const struct auth_ops *
 authunix_ops(void)
 {
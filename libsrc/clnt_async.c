@@ -0,0 +1,299 @@
+/*
+ *  Asynchronous (pipelined) client calls.
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+/*
+ * Calls which do not wait for their replies.
+ *
+ *	for (i = 0; i < n; i++)
+ *		clnt_call_async(clnt, proc, xdr_args, &args[i],
+ *		    xdr_res, &res[i], done, cookie, timeout);
+ *	clnt_async_wait(clnt, 0, timeout);
+ *
+ * clnt_call_async() encodes and queues the call, then returns; the
+ * results are decoded into their storage and done(stat, res, cookie)
+ * called as the replies are received, within clnt_async_wait() or a
+ * later clnt_call_async().  Replies are not waited for until then, so
+ * a connection carries any number of calls per round trip; at most
+ * ASYNC_WINDOW are outstanding, and their calls total no more than the
+ * handle's send buffer, beyond which clnt_call_async() first waits for
+ * the oldest.  The byte budget keeps a peer which stops reading while
+ * its replies back up from stalling both ends on full socket buffers.
+ *
+ * Only connection-oriented handles pipeline.  Elsewhere the call is
+ * made by clnt_call(), and done() called, before clnt_call_async()
+ * returns.
+ *
+ * A handle's asynchronous calls are driven by one thread at a time,
+ * and must not be mixed with clnt_call() on the same handle while any
+ * are outstanding.  Calls outstanding when the handle is destroyed are
+ * abandoned, without done() being called; done() itself must not
+ * destroy the handle.
+ */
+
+#include "namespace.h"
+#include "reentrant.h"
+#include <sys/types.h>
+#include <sys/time.h>
+#include <rpc/rpc.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rpc_internal.h"
+
+#define	ASYNC_HASHSZ	64		/* handle buckets, power of 2 */
+#define	ASYNC_WINDOW	64		/* outstanding calls per handle */
+#define	ASYNC_CALLHDR	(10 * BYTES_PER_XDR_UNIT + 2 * MAX_AUTH_BYTES)
+					/* bound on a call's header */
+
+/*
+ * An outstanding call.
+ */
+struct async_call {
+	u_int32_t	ac_xid;
+	xdrproc_t	ac_xres;
+	caddr_t		ac_resp;
+	clnt_done_t	ac_done;
+	void		*ac_cookie;
+	u_int		ac_bytes;	/* size of the call, bounded */
+};
+
+/*
+ * Per handle state, while calls are outstanding.
+ */
+struct async_clnt {
+	struct async_clnt *an_next;	/* hash chain */
+	CLIENT		*an_clnt;
+	u_int		an_depth;	/* clnt_async_wait() nesting */
+	u_int		an_ncalls;	/* outstanding, in call order */
+	u_int		an_bytes;	/* ... and their calls' size */
+	struct async_call an_calls[ASYNC_WINDOW];
+};
+
+#ifdef _REENTRANT
+extern mutex_t async_lock;
+#endif
+static struct async_clnt *async_hash[ASYNC_HASHSZ];
+
+/* VARIABLES PROTECTED BY async_lock: async_hash */
+
+static struct async_clnt *async_find(CLIENT *, bool_t);
+static void async_release(struct async_clnt *);
+static bool_t async_lookup(void *, u_int32_t, xdrproc_t *, caddr_t *);
+
+static __inline u_int
+async_bucket(const CLIENT *cl)
+{
+	return ((u_int)((uintptr_t)cl >> 4) & (ASYNC_HASHSZ - 1));
+}
+
+/*
+ * The state for the handle, creating as required.
+ */
+static struct async_clnt *
+async_find(CLIENT *cl, bool_t create)
+{
+	struct async_clnt *an;
+	u_int b = async_bucket(cl);
+
+	mutex_lock(&async_lock);
+	for (an = async_hash[b]; an; an = an->an_next)
+		if (an->an_clnt == cl)
+			break;
+	if (an == NULL && create &&
+	    (an = mem_alloc(sizeof (*an))) != NULL) {
+		an->an_clnt = cl;
+		an->an_depth = 0;
+		an->an_ncalls = 0;
+		an->an_bytes = 0;
+		an->an_next = async_hash[b];
+		async_hash[b] = an;
+	}
+	mutex_unlock(&async_lock);
+	return (an);
+}
+
+/*
+ * Release the state once nothing is outstanding.
+ */
+static void
+async_release(struct async_clnt *an)
+{
+	struct async_clnt **anp;
+
+	if (an->an_ncalls || an->an_depth)
+		return;
+	mutex_lock(&async_lock);
+	for (anp = &async_hash[async_bucket(an->an_clnt)]; *anp != an;
+	    anp = &(*anp)->an_next)
+		continue;
+	*anp = an->an_next;
+	mutex_unlock(&async_lock);
+	mem_free(an, sizeof (*an));
+}
+
+/*
+ * Where the reply to xid is decoded; replies normally arrive in call
+ * order, so the search is short.
+ */
+static bool_t
+async_lookup(void *ctx, u_int32_t xid, xdrproc_t *xresp, caddr_t *respp)
+{
+	struct async_clnt *an = ctx;
+	u_int i;
+
+	for (i = 0; i < an->an_ncalls; i++)
+		if (an->an_calls[i].ac_xid == xid) {
+			*xresp = an->an_calls[i].ac_xres;
+			*respp = an->an_calls[i].ac_resp;
+			return (TRUE);
+		}
+	return (FALSE);
+}
+
+/*
+ * Complete the i'th outstanding call.
+ */
+static void
+async_done(struct async_clnt *an, u_int i, enum clnt_stat stat)
+{
+	struct async_call ac;
+
+	ac = an->an_calls[i];
+	(void) memmove(&an->an_calls[i], &an->an_calls[i + 1],
+	    (an->an_ncalls - i - 1) * sizeof (ac));
+	an->an_ncalls--;
+	an->an_bytes -= ac.ac_bytes;
+	(*ac.ac_done)(stat, ac.ac_resp, ac.ac_cookie);
+}
+
+LIBRPC_API enum clnt_stat
+clnt_call_async(CLIENT *cl, rpcproc_t proc, xdrproc_t xargs,
+    const char *argsp, xdrproc_t xres, caddr_t resp, clnt_done_t done,
+    void *cookie, struct timeval timeout)
+{
+	struct async_clnt *an;
+	struct async_call *ac;
+	enum clnt_stat stat;
+	u_int32_t xid;
+	u_int bytes, budget;
+
+	_DIAGASSERT(cl != NULL);
+	_DIAGASSERT(done != NULL);
+
+	if (! __clnt_vc_pipelined(cl)) {
+		stat = clnt_call(cl, proc, xargs, argsp, xres, resp, timeout);
+		(*done)(stat, resp, cookie);
+		return (RPC_SUCCESS);
+	}
+
+	/* make room in the window, and the budget unless alone */
+	bytes = (u_int)xdr_sizeof(xargs, __UNCONST(argsp)) + ASYNC_CALLHDR;
+	budget = __clnt_vc_sendsz(cl);
+	while ((an = async_find(cl, FALSE)) != NULL && an->an_ncalls > 0 &&
+	    (an->an_ncalls >= ASYNC_WINDOW || an->an_bytes + bytes > budget))
+		if ((stat = clnt_async_wait(cl, an->an_ncalls - 1, timeout)) !=
+		    RPC_SUCCESS)
+			return (stat);
+	if ((an = async_find(cl, TRUE)) == NULL)
+		return (RPC_SYSTEMERROR);
+
+	if ((stat = __clnt_vc_send(cl, proc, xargs, argsp, &xid)) !=
+	    RPC_SUCCESS) {
+		async_release(an);
+		return (stat);
+	}
+	ac = &an->an_calls[an->an_ncalls++];
+	ac->ac_xid = xid;
+	ac->ac_xres = xres;
+	ac->ac_resp = resp;
+	ac->ac_done = done;
+	ac->ac_cookie = cookie;
+	ac->ac_bytes = bytes;
+	an->an_bytes += bytes;
+	return (RPC_SUCCESS);
+}
+
+/*
+ * Receive replies until at most max calls are outstanding.  On a
+ * transport failure every outstanding call completes with it.
+ */
+LIBRPC_API enum clnt_stat
+clnt_async_wait(CLIENT *cl, u_int max, struct timeval timeout)
+{
+	struct async_clnt *an;
+	struct timeval deadline;
+	enum clnt_stat stat, cstat;
+	u_int32_t xid;
+	u_int i, n;
+
+	_DIAGASSERT(cl != NULL);
+
+	if ((an = async_find(cl, FALSE)) == NULL)
+		return (RPC_SUCCESS);
+
+	__rpc_deadline(&deadline, &timeout);
+	stat = RPC_SUCCESS;
+	an->an_depth++;
+	while (an->an_ncalls > max) {
+		stat = __clnt_vc_recv(cl, &deadline, async_lookup, an,
+		    &xid, &cstat);
+		if (stat == RPC_TIMEDOUT)
+			break;
+		if (stat != RPC_SUCCESS) {
+			/* calls made by done() are left outstanding */
+			for (n = an->an_ncalls; n > 0; n--)
+				async_done(an, 0, stat);
+			break;
+		}
+		for (i = 0; i < an->an_ncalls; i++)
+			if (an->an_calls[i].ac_xid == xid) {
+				async_done(an, i, cstat);
+				break;
+			}
+	}
+	an->an_depth--;
+	async_release(an);
+	return (stat);
+}
+
+/*
+ * The handle is being destroyed; abandon its calls.
+ */
+void
+__clnt_async_destroy(CLIENT *cl)
+{
+	struct async_clnt *an;
+
+	if ((an = async_find(cl, FALSE)) != NULL) {
+		an->an_ncalls = 0;
+		an->an_depth = 0;
+		async_release(an);
+	}
+}
+
+/*end*/
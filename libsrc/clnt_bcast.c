@@ -56,8 +56,10 @@ __RCSID("$NetBSD: clnt_bcast.c,v 1.26 2013/03/11 20:19:28 tron Exp $");
  */
 
 #include "namespace.h"
+#include "reentrant.h"
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <sys/queue.h>
 #include <net/if.h>
 #include <netinet/in.h>
@@ -81,11 +83,11 @@ __RCSID("$NetBSD: clnt_bcast.c,v 1.26 2013/03/11 20:19:28 tron Exp $");
 #include <netdb.h>
 #include <err.h>
 #include <string.h>
+#include <time.h>
 
 #include "rpc_internal.h"
 #include "svc_fdset.h"
 
-#define	MAXBCAST 20	/* Max no of broadcasting transports */
 #define	INITTIME 4000	/* Time to wait initially */
 #define	WAITTIME 8000	/* Maximum time to wait */
 
@@ -115,6 +117,7 @@ __RCSID("$NetBSD: clnt_bcast.c,v 1.26 2013/03/11 20:19:28 tron Exp $");
 #ifdef __weak_alias
 __weak_alias(rpc_broadcast_exp,_rpc_broadcast_exp)
 __weak_alias(rpc_broadcast,_rpc_broadcast)
+__weak_alias(rpc_broadcast_opts,_rpc_broadcast_opts)
 #endif
 
 struct broadif {
@@ -131,8 +134,34 @@ int __rpc_broadenable(int, int, struct broadif *);
 
 int __rpc_lowvers = 0;
 
-int
-__rpc_getbroadifs(int af, int proto, int socktype, broadlist_t *list)
+/*
+ * Interface lists are cached per transport for BCAST_IFTTL seconds, as is
+ * the default credential, so successive broadcasts need not enumerate
+ * the interfaces or build credentials again.
+ */
+#define	BCAST_IFTTL	30	/* seconds */
+#define	BCAST_IFCACHE	4	/* transports cached */
+#define	BCAST_QUEUELEN	256	/* default reply queue length */
+#define	BCAST_RCVBUF	(256 * 1024) /* default socket receive buffer */
+
+static struct bcast_ifcache {
+	int		af, proto, socktype;
+	time_t		expires;	/* 0 = unused */
+	int		count;
+	broadlist_t	list;
+} bcast_ifcache[BCAST_IFCACHE];
+
+static AUTH *bcast_auth;
+static time_t bcast_authexpires;
+
+#ifdef _REENTRANT
+extern mutex_t bcast_lock;
+#endif
+
+/* VARIABLES PROTECTED BY bcast_lock: bcast_ifcache, bcast_auth */
+
+static int
+getbroadifs(int af, int proto, int socktype, broadlist_t *list)
 {
 	int count = 0;
 	struct broadif *bip;
@@ -205,6 +234,49 @@ __rpc_getbroadifs(int af, int proto, int socktype, broadlist_t *list)
 	return count;
 }
 
+int
+__rpc_getbroadifs(int af, int proto, int socktype, broadlist_t *list)
+{
+	struct bcast_ifcache *ic, *slot = NULL;
+	struct broadif *bip, *nbip;
+	struct timeval now;
+	int count = 0;
+
+	_DIAGASSERT(list != NULL);
+
+	__rpc_coarse_clock(&now);
+	mutex_lock(&bcast_lock);
+	for (ic = bcast_ifcache; ic < bcast_ifcache + BCAST_IFCACHE; ++ic) {
+		if (ic->expires && ic->af == af && ic->proto == proto &&
+		    ic->socktype == socktype)
+			break;
+		if (slot == NULL || ic->expires < slot->expires)
+			slot = ic;		/* unused or oldest */
+	}
+	if (ic == bcast_ifcache + BCAST_IFCACHE || ic->expires <= now.tv_sec) {
+		if (ic == bcast_ifcache + BCAST_IFCACHE)
+			ic = slot;
+		__rpc_freebroadifs(&ic->list);
+		TAILQ_INIT(&ic->list);
+		ic->af = af;
+		ic->proto = proto;
+		ic->socktype = socktype;
+		ic->count = getbroadifs(af, proto, socktype, &ic->list);
+		ic->expires = now.tv_sec + BCAST_IFTTL;
+	}
+
+	/* the caller owns, and frees, a copy */
+	TAILQ_FOREACH(bip, &ic->list, link) {
+		if ((nbip = malloc(sizeof(*nbip))) == NULL)
+			break;
+		*nbip = *bip;
+		TAILQ_INSERT_TAIL(list, nbip, link);
+		count++;
+	}
+	mutex_unlock(&bcast_lock);
+	return count;
+}
+
 void
 __rpc_freebroadifs(broadlist_t *list)
 {
@@ -249,8 +321,200 @@ __rpc_broadenable(int af, int s, struct broadif *bip)
 }
 
 
-LIBRPC_API enum clnt_stat
-rpc_broadcast_exp(
+/*
+ * An array of all the suitable broadcast transports
+ */
+struct bcast_fd {
+	int fd;		/* File descriptor */
+	int af;
+	int proto;
+	struct netconfig *nconf; /* Netconfig structure */
+#if defined(_WIN32)
+	socklen_t asize;	/* Size of the addr buf */
+#else
+	u_int asize;	/* Size of the addr buf */
+#endif
+	u_int dsize;	/* Size of the data buf */
+	broadlist_t nal;
+};
+
+struct bcast_slot {
+	struct bcast_fd *fdp;
+	u_int len;
+	struct sockaddr_storage raddr; /* Remote address */
+};
+
+/*
+ * A broadcast in progress.  When callbacks run on workers, replies are
+ * copied into a bounded queue by the receiving thread; replies arriving
+ * while the queue is full are dropped and counted.
+ */
+struct bcast {
+	xdrproc_t xresults;
+	resultproc_t eachresult;
+	u_int32_t xid;		/* as sent */
+	u_int32_t xid_pmap;
+	int pmap_flag;
+	u_int bufsize;
+	u_int ressize;
+	mutex_t lock;		/* below */
+	cond_t cv;
+	char *qbuf;		/* [qlen][bufsize] */
+	struct bcast_slot *qslot; /* [qlen] */
+	u_int qlen, qhead, qcount;
+	int closing;
+	int done;
+	struct rpc_bcaststats stats;
+};
+
+static bool_t bcast_decode(struct bcast *, struct bcast_fd *, char *, u_int,
+    struct sockaddr_storage *, caddr_t);
+static void *bcast_worker(void *);
+
+/*
+ * Decode a reply and, if successful, hand it to eachresult; returns TRUE
+ * if eachresult is done.
+ */
+static bool_t
+bcast_decode(struct bcast *bc, struct bcast_fd *fdp, char *inbuf, u_int inlen,
+    struct sockaddr_storage *raddr, caddr_t resultsp)
+{
+	XDR xdr_stream, *xdrs = &xdr_stream;
+	struct rpc_msg msg;
+	struct r_rpcb_rmtcallres bres; /* Remote results */
+	char uaddress[1024];	/* A self imposed limit */
+	char *uaddrp = uaddress;
+	int pmap_reply_flag;	/* reply recvd from PORTMAP */
+#ifdef PORTMAP
+	struct rmtcallres bres_pmap; /* Remote results */
+	u_long port;		/* Remote port number */
+#endif
+	bool_t done = FALSE;
+
+	bres.addr = uaddrp;
+	bres.results.results_val = resultsp;
+	bres.xdr_res = bc->xresults;
+#ifdef PORTMAP
+	bres_pmap.port_ptr = &port;
+	bres_pmap.xdr_results = bc->xresults;
+	bres_pmap.results_ptr = resultsp;
+#endif
+
+	/*
+	 * see if reply transaction id matches sent id.
+	 * If so, decode the results. If return id is xid + 1
+	 * it was a PORTMAP reply
+	 */
+	if (memcmp(inbuf, &bc->xid, sizeof(u_int32_t)) == 0) {
+		pmap_reply_flag = 0;
+		msg.acpted_rply.ar_verf = _null_auth;
+		msg.acpted_rply.ar_results.where =
+			(caddr_t)(void *)&bres;
+		msg.acpted_rply.ar_results.proc =
+			(xdrproc_t)xdr_rpcb_rmtcallres;
+#ifdef PORTMAP
+	} else if (bc->pmap_flag &&
+	    memcmp(inbuf, &bc->xid_pmap, sizeof(u_int32_t)) == 0) {
+		pmap_reply_flag = 1;
+		msg.acpted_rply.ar_verf = _null_auth;
+		msg.acpted_rply.ar_results.where =
+			(caddr_t)(void *)&bres_pmap;
+		msg.acpted_rply.ar_results.proc =
+			(xdrproc_t)xdr_rmtcallres;
+#endif				/* PORTMAP */
+	} else
+		return FALSE;
+	xdrmem_create(xdrs, inbuf, inlen, XDR_DECODE);
+	if (xdr_replymsg(xdrs, &msg)) {
+		if ((msg.rm_reply.rp_stat == MSG_ACCEPTED) &&
+		    (msg.acpted_rply.ar_stat == SUCCESS)) {
+			struct netbuf *np;
+
+#ifdef PORTMAP
+			if (bc->pmap_flag && pmap_reply_flag) {
+				struct netbuf taddr;
+				struct sockaddr_in *bsin;
+				bsin = (struct sockaddr_in *)(void *)raddr;
+				bsin->sin_port = htons((u_short)port);
+#if defined(_WIN32)
+				taddr.len = taddr.maxlen = sizeof(struct sockaddr_in); /*IP6*/
+#else
+				taddr.len = taddr.maxlen = raddr->ss_len;
+#endif
+				taddr.buf = raddr;
+				done = (*bc->eachresult)(resultsp, &taddr, fdp->nconf);
+			} else {
+#endif
+#ifdef RPC_DEBUG
+				fprintf(stderr, "uaddr %s\n", uaddrp);
+#endif
+				np = uaddr2taddr(fdp->nconf, uaddrp);
+				done = (*bc->eachresult)(resultsp, np, fdp->nconf);
+				free(np);
+#ifdef PORTMAP
+			}
+#endif
+			mutex_lock(&bc->lock);
+			bc->stats.bs_results++;
+			mutex_unlock(&bc->lock);
+		}
+		/* otherwise, we just ignore the errors ... */
+	}
+	/* else some kind of deserialization problem ... */
+
+	xdrs->x_op = XDR_FREE;
+	msg.acpted_rply.ar_results.proc = (xdrproc_t) xdr_void;
+	(void) xdr_replymsg(xdrs, &msg);
+	(void) (*bc->xresults)(xdrs, resultsp);
+	XDR_DESTROY(xdrs);
+	return done;
+}
+
+/*
+ * Callback worker; consumes the reply queue until the broadcast is
+ * complete, or eachresult is done.
+ */
+static void *
+bcast_worker(void *arg)
+{
+	struct bcast *bc = arg;
+	struct bcast_slot slot;
+	char *inbuf, *results;
+	bool_t done;
+
+	inbuf = malloc(bc->bufsize);
+	results = calloc(1, bc->ressize);
+	mutex_lock(&bc->lock);
+	while (inbuf != NULL && results != NULL) {
+		while (bc->qcount == 0 && !bc->closing && !bc->done)
+			cond_wait(&bc->cv, &bc->lock);
+		if (bc->done || bc->qcount == 0)
+			break;
+		slot = bc->qslot[bc->qhead];
+		(void) memcpy(inbuf, bc->qbuf + bc->qhead * bc->bufsize,
+		    slot.len);
+		bc->qhead = (bc->qhead + 1) % bc->qlen;
+		bc->qcount--;
+		mutex_unlock(&bc->lock);
+
+		done = bcast_decode(bc, slot.fdp, inbuf, slot.len,
+		    &slot.raddr, results);
+		(void) memset(results, 0, bc->ressize);
+
+		mutex_lock(&bc->lock);
+		if (done) {
+			bc->done = TRUE;
+			cond_broadcast(&bc->cv);
+		}
+	}
+	mutex_unlock(&bc->lock);
+	free(results);
+	free(inbuf);
+	return NULL;
+}
+
+static enum clnt_stat
+rpc_broadcast_common(
 	const rpcprog_t	prog,		/* program number */
 	const rpcvers_t	vers,		/* version number */
 	const rpcproc_t	proc,		/* procedure number */
@@ -261,7 +525,8 @@ rpc_broadcast_exp(
 	const resultproc_t eachresult,	/* call with each result obtained */
 	const int	inittime,	/* how long to wait initially */
 	const int	waittime,	/* maximum time to wait */
-	const char *	nettype)	/* transport type */
+	const char *	nettype,	/* transport type */
+	struct rpc_bcastopts *opts)	/* NULL, or worker options */
 {
 	enum clnt_stat	stat = RPC_SUCCESS; /* Return status */
 	XDR 		xdr_stream; /* XDR stream */
@@ -271,51 +536,60 @@ rpc_broadcast_exp(
 	char		*inbuf = NULL; /* Reply buf */
 	ssize_t		inlen;
 	u_int 		maxbufsize = 0;
-	AUTH 		*sys_auth = authunix_create_default();
 	size_t		i;
-	void		*handle;
-	char		uaddress[1024];	/* A self imposed limit */
-	char		*uaddrp = uaddress;
-	int 		pmap_reply_flag; /* reply recvd from PORTMAP */
-	/* An array of all the suitable broadcast transports */
-	struct {
-		int fd;		/* File descriptor */
-		int af;
-		int proto;
-		struct netconfig *nconf; /* Netconfig structure */
-#if defined(_WIN32)
-		socklen_t asize;	/* Size of the addr buf */
-#else
-		u_int asize;	/* Size of the addr buf */
-#endif
-		u_int dsize;	/* Size of the data buf */
-		struct sockaddr_storage raddr; /* Remote address */
-		broadlist_t nal;
-	} fdlist[MAXBCAST];
-	struct pollfd pfd[MAXBCAST];
-	nfds_t fdlistno = 0;
+	void		*handle = NULL;
+	struct bcast_fd	*fdlist = NULL;
+	struct pollfd	*pfd = NULL;
+	nfds_t		fdlistno = 0, fdlistsz = 0;
 	struct r_rpcb_rmtcallargs barg;	/* Remote arguments */
-	struct r_rpcb_rmtcallres bres; /* Remote results */
 	size_t outlen;
 	struct netconfig *nconf;
 	int msec;
 	int pollretval;
 	int fds_found;
 	struct timespec ts;
+	struct timeval deadline, tv;
+	struct bcast bc;
+	struct sockaddr_storage raddr;
+#if defined(_WIN32)
+	socklen_t	asize;
+#else
+	u_int		asize;
+#endif
+	u_int		nworkers = 0, nthreads = 0;
+	int		rcvbuf = BCAST_RCVBUF;
+	struct timeval	clock;
+#ifdef _REENTRANT
+	pthread_t	*workers = NULL;
+#endif
 
 #ifdef PORTMAP
 	size_t outlen_pmap = 0;
-	u_long port;		/* Remote port number */
 	int pmap_flag = 0;	/* UDP exists ? */
 	char *outbuf_pmap = NULL;
 	struct rmtcallargs barg_pmap;	/* Remote arguments */
-	struct rmtcallres bres_pmap; /* Remote results */
 	u_int udpbufsz = 0;
 #endif				/* PORTMAP */
 
-	if (sys_auth == NULL) {
-		return (RPC_SYSTEMERROR);
+	(void) memset(&bc, 0, sizeof(bc));
+	bc.xresults = xresults;
+	bc.eachresult = eachresult;
+	mutex_init(&bc.lock, NULL);
+	cond_init(&bc.cv, 0, (void *) 0);
+	if (opts != NULL) {
+#ifdef _REENTRANT
+		nworkers = opts->bo_workers;
+#endif
+		if (opts->bo_rcvbuf > 0)
+			rcvbuf = opts->bo_rcvbuf;
+		bc.qlen = opts->bo_queuelen ? opts->bo_queuelen : BCAST_QUEUELEN;
+		bc.ressize = opts->bo_ressize;
+		if (nworkers && bc.ressize == 0) {
+			stat = RPC_SYSTEMERROR;
+			goto done_broad;
+		}
 	}
+
 	/*
 	 * initialization: create a fd, a broadcast address, and send the
 	 * request on the broadcast transport.
@@ -326,19 +600,33 @@ rpc_broadcast_exp(
 	if (nettype == NULL)
 		nettype = "datagram_n";
 	if ((handle = __rpc_setconf(nettype)) == NULL) {
-		AUTH_DESTROY(sys_auth);
-		return (RPC_UNKNOWNPROTO);
+		stat = RPC_UNKNOWNPROTO;
+		goto done_broad;
 	}
 	while ((nconf = __rpc_getconf(handle)) != NULL) {
-		int fd;
+		int fd, one = 1;
 		struct __rpc_sockinfo si;
 
 		if (nconf->nc_semantics != NC_TPI_CLTS)
 			continue;
-		if (fdlistno >= MAXBCAST)
-			break;	/* No more slots available */
 		if (!__rpc_nconf2sockinfo(nconf, &si))
 			continue;
+		if (fdlistno == fdlistsz) {
+			size_t nsz = fdlistsz ? fdlistsz * 2 : 8;
+			void *nfdlist, *npfd;
+
+			nfdlist = realloc(fdlist, nsz * sizeof(*fdlist));
+			if (nfdlist != NULL)
+				fdlist = nfdlist;
+			npfd = realloc(pfd, nsz * sizeof(*pfd));
+			if (npfd != NULL)
+				pfd = npfd;
+			if (nfdlist == NULL || npfd == NULL) {
+				stat = RPC_SYSTEMERROR;
+				goto done_broad;
+			}
+			fdlistsz = nsz;
+		}
 
 		TAILQ_INIT(&fdlist[fdlistno].nal);
 		if (__rpc_getbroadifs(si.si_af, si.si_proto, si.si_socktype, 
@@ -347,9 +635,22 @@ rpc_broadcast_exp(
 
 		fd = socket(si.si_af, si.si_socktype, si.si_proto);
 		if (fd < 0) {
+			__rpc_freebroadifs(&fdlist[fdlistno].nal);
 			stat = RPC_CANTSEND;
 			continue;
 		}
+
+		/* absorb reply bursts; drained without blocking */
+		(void) setsockopt(fd, SOL_SOCKET, SO_RCVBUF,
+		    (void *)&rcvbuf, (socklen_t)sizeof(rcvbuf));
+#if defined(_WIN32)
+		{	u_long mode = (long)one;
+			ioctlsocket((SOCKET)fd, FIONBIO, &mode);
+		}
+#else
+		ioctl(fd, FIONBIO, (char *)(void *)&one);
+#endif
+
 		fdlist[fdlistno].af = si.si_af;
 		fdlist[fdlistno].proto = si.si_proto;
 		fdlist[fdlistno].fd = fd;
@@ -365,10 +666,12 @@ rpc_broadcast_exp(
 			maxbufsize = fdlist[fdlistno].dsize;
 			
 #ifdef PORTMAP
-		if (si.si_af == AF_INET && si.si_proto == IPPROTO_UDP) {
+		if (si.si_af == AF_INET && si.si_proto == IPPROTO_UDP &&
+		    outbuf_pmap == NULL) {
 			udpbufsz = fdlist[fdlistno].dsize;
 			if ((outbuf_pmap = malloc(udpbufsz)) == NULL) {
 				close(fd);
+				__rpc_freebroadifs(&fdlist[fdlistno].nal);
 				stat = RPC_SYSTEMERROR;
 				goto done_broad;
 			}
@@ -394,6 +697,7 @@ rpc_broadcast_exp(
 		stat = RPC_SYSTEMERROR;
 		goto done_broad;
 	}
+	bc.bufsize = maxbufsize;
 
 	/* Serialize all the arguments which have to be sent */
 	msg.rm_xid = __RPC_GETXID();
@@ -407,20 +711,37 @@ rpc_broadcast_exp(
 	barg.proc = proc;
 	barg.args.args_val = argsp;
 	barg.xdr_args = xargs;
-	bres.addr = uaddrp;
-	bres.results.results_val = resultsp;
-	bres.xdr_res = xresults;
-	msg.rm_call.cb_cred = sys_auth->ah_cred;
-	msg.rm_call.cb_verf = sys_auth->ah_verf;
+
+	__rpc_coarse_clock(&clock);
+	mutex_lock(&bcast_lock);
+	if (bcast_auth == NULL || clock.tv_sec >= bcast_authexpires) {
+		AUTH *sys_auth = authunix_create_default();
+
+		if (sys_auth != NULL) {
+			if (bcast_auth != NULL)
+				AUTH_DESTROY(bcast_auth);
+			bcast_auth = sys_auth;
+			bcast_authexpires = clock.tv_sec + BCAST_IFTTL;
+		}
+	}
+	if (bcast_auth == NULL) {
+		mutex_unlock(&bcast_lock);
+		stat = RPC_SYSTEMERROR;
+		goto done_broad;
+	}
+	msg.rm_call.cb_cred = bcast_auth->ah_cred;
+	msg.rm_call.cb_verf = bcast_auth->ah_verf;
 	xdrmem_create(xdrs, outbuf, maxbufsize, XDR_ENCODE);
 	if ((!xdr_callmsg(xdrs, &msg)) ||
 	    (!xdr_rpcb_rmtcallargs(xdrs,
 	    (struct rpcb_rmtcallargs *)(void *)&barg))) {
+		mutex_unlock(&bcast_lock);
 		stat = RPC_CANTENCODEARGS;
 		goto done_broad;
 	}
 	outlen = xdr_getpos(xdrs);
 	xdr_destroy(xdrs);
+	(void) memcpy(&bc.xid, outbuf, sizeof(bc.xid));
 
 #ifdef PORTMAP
 	/* Prepare the packet for version 2 PORTMAP */
@@ -434,19 +755,43 @@ rpc_broadcast_exp(
 		barg_pmap.proc = proc;
 		barg_pmap.args_ptr = argsp;
 		barg_pmap.xdr_args = xargs;
-		bres_pmap.port_ptr = &port;
-		bres_pmap.xdr_results = xresults;
-		bres_pmap.results_ptr = resultsp;
 		xdrmem_create(xdrs, outbuf_pmap, udpbufsz, XDR_ENCODE);
 		if ((! xdr_callmsg(xdrs, &msg)) ||
 		    (! xdr_rmtcall_args(xdrs, &barg_pmap))) {
+			mutex_unlock(&bcast_lock);
 			stat = RPC_CANTENCODEARGS;
 			goto done_broad;
 		}
 		outlen_pmap = xdr_getpos(xdrs);
 		xdr_destroy(xdrs);
+		(void) memcpy(&bc.xid_pmap, outbuf_pmap, sizeof(bc.xid_pmap));
+		bc.pmap_flag = 1;
 	}
 #endif				/* PORTMAP */
+	mutex_unlock(&bcast_lock);
+
+#ifdef _REENTRANT
+	/*
+	 * Start the callback workers, if requested.
+	 */
+	if (nworkers && eachresult != NULL) {
+		bc.qbuf = malloc((size_t)bc.qlen * maxbufsize);
+		bc.qslot = malloc((size_t)bc.qlen * sizeof(*bc.qslot));
+		workers = malloc(nworkers * sizeof(*workers));
+		if (bc.qbuf == NULL || bc.qslot == NULL || workers == NULL) {
+			stat = RPC_SYSTEMERROR;
+			goto done_broad;
+		}
+		for (nthreads = 0; nthreads < nworkers; ++nthreads)
+			if (pthread_create(&workers[nthreads], NULL,
+			    bcast_worker, &bc) != 0)
+				break;
+		if (nthreads == 0) {
+			stat = RPC_SYSTEMERROR;
+			goto done_broad;
+		}
+	}
+#endif
 
 	/*
 	 * Basic loop: broadcast the packets to transports which
@@ -476,7 +821,7 @@ rpc_broadcast_exp(
 				 * Only use version 3 if lowvers is not set
 				 */
 
-				if (!__rpc_lowvers)
+				if (!__rpc_lowvers) {
 					if ((size_t)sendto(fdlist[i].fd, outbuf,
 					    outlen, 0, (struct sockaddr*)addr,
 					    (socklen_t)fdlist[i].asize) !=
@@ -486,6 +831,8 @@ rpc_broadcast_exp(
 						stat = RPC_CANTSEND;
 						continue;
 					}
+					bc.stats.bs_sent++;
+				}
 #ifdef RPC_DEBUG
 				if (!__rpc_lowvers)
 					fprintf(stderr, "Broadcast packet sent "
@@ -509,6 +856,7 @@ rpc_broadcast_exp(
 						stat = RPC_CANTSEND;
 						continue;
 					}
+					bc.stats.bs_sent++;
 				}
 #ifdef RPC_DEBUG
 				fprintf(stderr, "PMAP Broadcast packet "
@@ -528,9 +876,15 @@ rpc_broadcast_exp(
 		/*
 		 * Get all the replies from these broadcast requests
 		 */
+		tv.tv_sec = msec / 1000;
+		tv.tv_usec = (msec % 1000) * 1000;
+		__rpc_deadline(&deadline, &tv);
+
 	recv_again:
-		ts.tv_sec = msec / 1000;
-		ts.tv_nsec = (msec % 1000) * 1000000;
+		if (! __rpc_deadline_left(&deadline, &ts)) {
+			stat = RPC_TIMEDOUT;
+			continue;
+		}
 
 		switch (pollretval = pollts(pfd, fdlistno, &ts, NULL)) {
 		case 0:		/* timed out */
@@ -542,8 +896,6 @@ rpc_broadcast_exp(
 
 		for (i = fds_found = 0;
 		     i < fdlistno && fds_found < pollretval; i++) {
-			bool_t done = FALSE;
-
 			if (pfd[i].revents == 0)
 				continue;
 			else if (pfd[i].revents & POLLNVAL) {
@@ -563,97 +915,106 @@ rpc_broadcast_exp(
 			fprintf(stderr, "response for %s\n",
 				fdlist[i].nconf->nc_netid);
 #endif
-		try_again:
-			inlen = recvfrom(fdlist[i].fd, inbuf, fdlist[i].dsize,
-			    0, (struct sockaddr *)(void *)&fdlist[i].raddr,
-			    &fdlist[i].asize);
-			if (inlen < 0) {
-				if (errno == EINTR)
-					goto try_again;
-				warnx("clnt_bcast: Cannot receive reply to "
-					"broadcast");
-				stat = RPC_CANTRECV;
-				continue;
-			}
-			if (inlen < (ssize_t)sizeof(u_int32_t))
-				continue; /* Drop that and go ahead */
 			/*
-			 * see if reply transaction id matches sent id.
-			 * If so, decode the results. If return id is xid + 1
-			 * it was a PORTMAP reply
+			 * Drain everything queued on the descriptor before
+			 * polling again, so bursts do not overflow it.
 			 */
-			if (*((u_int32_t *)(void *)(inbuf)) ==
-			    *((u_int32_t *)(void *)(outbuf))) {
-				pmap_reply_flag = 0;
-				msg.acpted_rply.ar_verf = _null_auth;
-				msg.acpted_rply.ar_results.where =
-					(caddr_t)(void *)&bres;
-				msg.acpted_rply.ar_results.proc =
-					(xdrproc_t)xdr_rpcb_rmtcallres;
-#ifdef PORTMAP
-			} else if (pmap_flag &&
-				*((u_int32_t *)(void *)(inbuf)) ==
-				*((u_int32_t *)(void *)(outbuf_pmap))) {
-				pmap_reply_flag = 1;
-				msg.acpted_rply.ar_verf = _null_auth;
-				msg.acpted_rply.ar_results.where =
-					(caddr_t)(void *)&bres_pmap;
-				msg.acpted_rply.ar_results.proc =
-					(xdrproc_t)xdr_rmtcallres;
-#endif				/* PORTMAP */
-			} else
-				continue;
-			xdrmem_create(xdrs, inbuf, (u_int)inlen, XDR_DECODE);
-			if (xdr_replymsg(xdrs, &msg)) {
-				if ((msg.rm_reply.rp_stat == MSG_ACCEPTED) &&
-				    (msg.acpted_rply.ar_stat == SUCCESS)) {
-					struct netbuf *np;
-
-#ifdef PORTMAP
-					if (pmap_flag && pmap_reply_flag) {
-						struct netbuf taddr;
-						struct sockaddr_in *bsin;
-						bsin = (struct sockaddr_in *)(void *)&fdlist[i].raddr;
-						bsin->sin_port = htons((u_short)port);
+			for (;;) {
+				asize = fdlist[i].asize;
+				inlen = recvfrom(fdlist[i].fd, inbuf,
+				    fdlist[i].dsize, 0,
+				    (struct sockaddr *)(void *)&raddr, &asize);
+				if (inlen < 0) {
+					if (errno == EINTR)
+						continue;
 #if defined(_WIN32)
-                                                taddr.len = taddr.maxlen = sizeof(struct sockaddr_in); /*IP6*/
+					if (errno == WSAEWOULDBLOCK ||
+					    errno == EWOULDBLOCK)
 #else
-						taddr.len = taddr.maxlen = fdlist[i].raddr.ss_len;
-#endif
-						taddr.buf = &fdlist[i].raddr;
-						done = (*eachresult)(resultsp, &taddr, fdlist[i].nconf);
-					} else {
-#endif
-#ifdef RPC_DEBUG
-						fprintf(stderr, "uaddr %s\n",
-						    uaddrp);
+					if (errno == EWOULDBLOCK)
 #endif
-						np = uaddr2taddr(fdlist[i].nconf, uaddrp);
-						done = (*eachresult)(resultsp, np, fdlist[i].nconf);
-						free(np);
-#ifdef PORTMAP
+						break;
+					warnx("clnt_bcast: Cannot receive "
+					    "reply to broadcast");
+					stat = RPC_CANTRECV;
+					break;
+				}
+				if (inlen < (ssize_t)sizeof(u_int32_t) ||
+				    (memcmp(inbuf, &bc.xid, sizeof(bc.xid)) &&
+				    (!bc.pmap_flag || memcmp(inbuf,
+				    &bc.xid_pmap, sizeof(bc.xid_pmap))))) {
+					bc.stats.bs_stray++;
+					continue; /* Drop that and go ahead */
+				}
+				bc.stats.bs_received++;
+
+				if (nthreads == 0) {
+					/* callbacks inline */
+					if (bcast_decode(&bc, &fdlist[i], inbuf,
+					    (u_int)inlen, &raddr, resultsp)) {
+						stat = RPC_SUCCESS;
+						goto done_broad;
 					}
-#endif
+					continue;
 				}
-				/* otherwise, we just ignore the errors ... */
+
+				mutex_lock(&bc.lock);
+				if (bc.qcount == bc.qlen) {
+					bc.stats.bs_dropped++;
+				} else {
+					u_int tail = (bc.qhead + bc.qcount) %
+					    bc.qlen;
+
+					(void) memcpy(bc.qbuf + tail * maxbufsize,
+					    inbuf, (size_t)inlen);
+					bc.qslot[tail].fdp = &fdlist[i];
+					bc.qslot[tail].len = (u_int)inlen;
+					bc.qslot[tail].raddr = raddr;
+					if (++bc.qcount > bc.stats.bs_maxqueued)
+						bc.stats.bs_maxqueued = bc.qcount;
+					cond_signal(&bc.cv);
+				}
+				mutex_unlock(&bc.lock);
 			}
-			/* else some kind of deserialization problem ... */
+		}		/* The recv for loop */
 
-			xdrs->x_op = XDR_FREE;
-			msg.acpted_rply.ar_results.proc = (xdrproc_t) xdr_void;
-			(void) xdr_replymsg(xdrs, &msg);
-			(void) (*xresults)(xdrs, resultsp);
-			XDR_DESTROY(xdrs);
+		if (nthreads) {
+			int done;
+
+			mutex_lock(&bc.lock);
+			done = bc.done;
+			mutex_unlock(&bc.lock);
 			if (done) {
 				stat = RPC_SUCCESS;
 				goto done_broad;
-			} else {
-				goto recv_again;
 			}
-		}		/* The recv for loop */
+		}
+		goto recv_again;
 	}			/* The giant for loop */
 
 done_broad:
+#ifdef _REENTRANT
+	if (nthreads) {
+		/* let the workers finish the queue */
+		mutex_lock(&bc.lock);
+		bc.closing = TRUE;
+		cond_broadcast(&bc.cv);
+		mutex_unlock(&bc.lock);
+		while (nthreads)
+			(void) pthread_join(workers[--nthreads], NULL);
+		if (bc.done)
+			stat = RPC_SUCCESS;
+	}
+	if (workers)
+		free(workers);
+#endif
+	if (opts != NULL)
+		opts->bo_stats = bc.stats;
+	if (bc.qbuf)
+		free(bc.qbuf);
+	if (bc.qslot)
+		free(bc.qslot);
+	cond_destroy(&bc.cv);
 	if (inbuf)
 		(void) free(inbuf);
 	if (outbuf)
@@ -666,13 +1027,63 @@ done_broad:
 		(void) close(fdlist[i].fd);
 		__rpc_freebroadifs(&fdlist[i].nal);
 	}
-	AUTH_DESTROY(sys_auth);
-	(void) __rpc_endconf(handle);
+	if (fdlist)
+		free(fdlist);
+	if (pfd)
+		free(pfd);
+	if (handle)
+		(void) __rpc_endconf(handle);
 
 	return (stat);
 }
 
 
+LIBRPC_API enum clnt_stat
+rpc_broadcast_exp(
+	const rpcprog_t	prog,		/* program number */
+	const rpcvers_t	vers,		/* version number */
+	const rpcproc_t	proc,		/* procedure number */
+	const xdrproc_t	xargs,		/* xdr routine for args */
+	const char *	argsp,		/* pointer to args */
+	const xdrproc_t	xresults,	/* xdr routine for results */
+	caddr_t		resultsp,	/* pointer to results */
+	const resultproc_t eachresult,	/* call with each result obtained */
+	const int	inittime,	/* how long to wait initially */
+	const int	waittime,	/* maximum time to wait */
+	const char *	nettype)	/* transport type */
+{
+	return rpc_broadcast_common(prog, vers, proc, xargs, argsp,
+	    xresults, resultsp, eachresult, inittime, waittime, nettype, NULL);
+}
+
+
+/*
+ * As rpc_broadcast_exp(), with options.  Given bo_workers, eachresult is
+ * called concurrently by that many threads, each decoding into its own
+ * zeroed results of bo_ressize bytes (resultsp is unused); replies wait
+ * in a queue of bo_queuelen entries and are dropped, and counted, when it
+ * is full.  Counters are returned in bo_stats.
+ */
+LIBRPC_API enum clnt_stat
+rpc_broadcast_opts(
+	const rpcprog_t	prog,		/* program number */
+	const rpcvers_t	vers,		/* version number */
+	const rpcproc_t	proc,		/* procedure number */
+	const xdrproc_t	xargs,		/* xdr routine for args */
+	const char *	argsp,		/* pointer to args */
+	const xdrproc_t	xresults,	/* xdr routine for results */
+	caddr_t		resultsp,	/* pointer to results */
+	const resultproc_t eachresult,	/* call with each result obtained */
+	const int	inittime,	/* how long to wait initially */
+	const int	waittime,	/* maximum time to wait */
+	const char *	nettype,	/* transport type */
+	struct rpc_bcastopts *opts)	/* options and counters */
+{
+	return rpc_broadcast_common(prog, vers, proc, xargs, argsp,
+	    xresults, resultsp, eachresult, inittime, waittime, nettype, opts);
+}
+
+
 LIBRPC_API enum clnt_stat
 rpc_broadcast(
 	const rpcprog_t	prog,		/* program number */
@@ -63,6 +63,7 @@ __RCSID("$NetBSD: clnt_dg.c,v 1.29 2013/05/07 21:08:44 christos Exp $");
 #include <string.h>
 #include <signal.h>
 #include <poll.h>
+#include <time.h>
 #include <unistd.h>
 #include <err.h>
 
@@ -74,6 +75,36 @@ __weak_alias(clnt_dg_create,_clnt_dg_create)
 #endif
 
 #define	RPC_MAX_BACKOFF		30 /* seconds */
+#define	RPC_MIN_RTO		200000 /* microseconds */
+#define	RTT_MAXIDLE		64 /* unreferenced estimators retained */
+#define	RTT_HASHSZ		64 /* power of 2 */
+#define	RTT_NTIMERS		8 /* timer classes, power of 2 */
+#define	RTT_TIMER(proc)		((proc) & (RTT_NTIMERS - 1))
+
+/*
+ * Round trip estimator, shared by all handles addressing the same server
+ * endpoint; Jacobson/Karels smoothing as TCP (RFC 6298), in microseconds.
+ * Procedures are spread over RTT_NTIMERS timer classes, each with its own
+ * estimate, so that fast procedures do not pull the timeout of slow ones
+ * down.  Samples are only taken from calls answered without a
+ * retransmission (Karn's algorithm).  Protected by dg_rtt_lock.
+ */
+struct dg_timer {
+	long			t_srtt;		/* smoothed rtt, scaled by 8 */
+	long			t_rttvar;	/* rtt variance, scaled by 4 */
+	long			t_rto;		/* retransmit timeout */
+	u_long			t_samples;
+};
+
+struct dg_rtt {
+	struct dg_rtt		*rt_next;
+	struct sockaddr_storage	rt_addr;
+	int			rt_len;
+	u_int			rt_refs;
+	struct dg_timer		rt_timer[RTT_NTIMERS];
+	u_long			rt_samples;
+	u_long			rt_timeouts;
+};
 
 
 static struct clnt_ops *clnt_dg_ops(void);
@@ -123,6 +154,14 @@ static const char mem_err_clnt_dg[] = "clnt_dg_create: out of memory";
 
 /* VARIABLES PROTECTED BY clnt_fd_lock: dg_fd_locks, dg_cv */
 
+static struct dg_rtt *dg_rtt_hash[RTT_HASHSZ];
+static u_int dg_rtt_idle;
+#ifdef _REENTRANT
+extern mutex_t dg_rtt_lock;
+#endif
+
+/* VARIABLES PROTECTED BY dg_rtt_lock: dg_rtt_hash, dg_rtt_idle, dg_rtt */
+
 /*
  * Private data kept per client handle
  */
@@ -132,10 +171,16 @@ struct cu_data {
 	struct sockaddr_storage	cu_raddr;	/* remote address */
 	int			cu_rlen;
 	struct timeval		cu_wait;	/* retransmit interval */
+	bool_t			cu_fixedwait;	/* cu_wait set by the user */
+	struct dg_rtt		*cu_rtt;	/* endpoint rtt estimator */
+	rpcproc_t		cu_proc;	/* of the last call */
 	struct timeval		cu_total;	/* total time for the call */
 	struct rpc_err		cu_error;
 	XDR			cu_outxdrs;
 	u_int			cu_xdrpos;
+	AUTH			*cu_tauth;	/* auth of the template */
+	u_int			cu_tgen;	/* ... and its generation */
+	u_int			cu_tpos;	/* pos after template, or 0 */
 	u_int			cu_sendsz;	/* send size */
 	char			*cu_outbuf;
 	u_int			cu_recvsz;	/* recv size */
@@ -143,6 +188,8 @@ struct cu_data {
 	char			cu_inbuf[1];
 };
 
+static bool_t marshal_call(struct cu_data *, AUTH *, rpcproc_t, XDR *);
+
 /*
  * Connection less client creation returns with client handle parameters.
  * Default options are set, which the user can change using clnt_control().
@@ -257,6 +304,7 @@ clnt_dg_create(
 #endif
 	cu->cu_total.tv_sec = -1;
 	cu->cu_total.tv_usec = -1;
+	cu->cu_rtt = __dg_rtt_get(&cu->cu_raddr, cu->cu_rlen);
 	cu->cu_sendsz = sendsz;
 	cu->cu_recvsz = recvsz;
 	call_msg.rm_xid = __RPC_GETXID();
@@ -307,8 +355,10 @@ err1:
 err2:
 	if (cl) {
 		mem_free(cl, sizeof (CLIENT));
-		if (cu)
+		if (cu) {
+			__dg_rtt_put(cu->cu_rtt);
 			mem_free(cu, sizeof (*cu) + sendsz + recvsz);
+		}
 	}
 	return (NULL);
 }
@@ -333,6 +383,8 @@ clnt_dg_call(
 	struct timeval timeout;
 	struct timeval retransmit_time;
 	struct timeval next_sendtime, starttime, time_waited, tv;
+	struct timeval sendtime;
+	int nsends = 0;
 #ifdef _REENTRANT
 	sigset_t mask, *maskp = &mask;
 #else
@@ -362,8 +414,12 @@ clnt_dg_call(
 
 	time_waited.tv_sec = 0;
 	time_waited.tv_usec = 0;
-	retransmit_time = next_sendtime = cu->cu_wait;
-	gettimeofday(&starttime, NULL);
+	retransmit_time = cu->cu_wait;
+	if (!cu->cu_fixedwait)
+		__dg_rtt_rto(cu->cu_rtt, proc, &retransmit_time);
+	cu->cu_proc = proc;
+	next_sendtime = retransmit_time;
+	__rpc_clock(&starttime);
 
 call_again:
 	xdrs = &(cu->cu_outxdrs);
@@ -373,8 +429,7 @@ call_again:
 	 * the transaction is the first thing in the out buffer
 	 */
 	(*(u_int32_t *)(void *)(cu->cu_outbuf))++;
-	if ((! XDR_PUTINT32(xdrs, (int32_t *)&proc)) ||
-	    (! AUTH_MARSHALL(cl->cl_auth, xdrs)) ||
+	if ((! marshal_call(cu, cl->cl_auth, proc, xdrs)) ||
 	    (! (*xargs)(xdrs, __UNCONST(argsp)))) {
 		cu->cu_error.re_status = RPC_CANTENCODEARGS;
 		goto out;
@@ -389,6 +444,8 @@ send_again:
 		cu->cu_error.re_status = RPC_CANTSEND;
 		goto out;
 	}
+	__rpc_clock(&sendtime);
+	++nsends;
 
 	/*
 	 * Hack to provide rpc-based message passing
@@ -453,12 +510,13 @@ send_again:
 			goto out;
 		}
 
-		gettimeofday(&tv, NULL);
+		__rpc_clock(&tv);
 		timersub(&tv, &starttime, &time_waited);
 
 		/* Check for timeout. */
 		if (timercmp(&time_waited, &timeout, >)) {
 			cu->cu_error.re_status = RPC_TIMEDOUT;
+			__dg_rtt_timeout(cu->cu_rtt);
 			goto out;
 		}
 
@@ -474,6 +532,12 @@ send_again:
 		}
 	}
 
+	if (nsends == 1) {
+		__rpc_clock(&tv);
+		timersub(&tv, &sendtime, &tv);
+		__dg_rtt_update(cu->cu_rtt, proc, &tv);
+	}
+
 	/*
 	 * now decode and validate the response
 	 */
@@ -517,10 +581,50 @@ send_again:
 
 	}
 out:
+	/*
+	 * Stale address?  Not if merely timed out without retransmitting,
+	 * as every one-way (zero timeout) call does.
+	 */
+	if (cu->cu_error.re_status != RPC_SUCCESS &&
+	    (cu->cu_error.re_status != RPC_TIMEDOUT || nsends > 1))
+		__rpcb_cache_failed(&cu->cu_raddr, (size_t)cu->cu_rlen,
+		    cu->cu_error.re_status);
 	release_fd_lock(cu->cu_fd, mask);
 	return (cu->cu_error.re_status);
 }
 
+/*
+ * Marshal the procedure and credentials after the pre-serialized
+ * header.  Call invariant credentials (AUTH_NONE, AUTH_UNIX) are left in
+ * the buffer as a template, so later calls only patch the procedure;
+ * the template is rebuilt when the auth changes.
+ */
+static bool_t
+marshal_call(struct cu_data *cu, AUTH *auth, rpcproc_t proc, XDR *xdrs)
+{
+	const char *image;
+	u_int len, gen;
+
+	if (! __AUTH_IMAGE(auth, &image, &len, &gen)) {
+		cu->cu_tpos = 0;
+		return (XDR_PUTINT32(xdrs, (int32_t *)&proc) &&
+		    AUTH_MARSHALL(auth, xdrs));
+	}
+	if (cu->cu_tpos != 0 && cu->cu_tauth == auth && cu->cu_tgen == gen) {
+		*(u_int32_t *)(void *)(cu->cu_outbuf + cu->cu_xdrpos) =
+		    htonl((u_int32_t)proc);
+		return (XDR_SETPOS(xdrs, cu->cu_tpos));
+	}
+	cu->cu_tpos = 0;
+	if (! XDR_PUTINT32(xdrs, (int32_t *)&proc) ||
+	    ! XDR_PUTBYTES(xdrs, image, len))
+		return (FALSE);
+	cu->cu_tauth = auth;
+	cu->cu_tgen = gen;
+	cu->cu_tpos = XDR_GETPOS(xdrs);
+	return (TRUE);
+}
+
 static void
 clnt_dg_geterr(CLIENT *cl, struct rpc_err *errp)
 {
@@ -572,6 +676,7 @@ clnt_dg_control(CLIENT *cl, u_int request, char *info)
 {
 	struct cu_data *cu;
 	struct netbuf *addr;
+	struct clnt_rtt *rtt;
 #ifdef _REENTRANT
 	WIN32_DISABLE(sigset_t mask;)
 #endif
@@ -626,10 +731,16 @@ clnt_dg_control(CLIENT *cl, u_int request, char *info)
 			return (FALSE);
 		}
 		cu->cu_wait = *(struct timeval *)(void *)info;
+		cu->cu_fixedwait = TRUE;	/* disables adaptive rto */
 		break;
 	case CLGET_RETRY_TIMEOUT:
 		*(struct timeval *)(void *)info = cu->cu_wait;
 		break;
+	case CLGET_RTT:
+		rtt = (struct clnt_rtt *)(void *)info;
+		__dg_rtt_stats(cu->cu_rtt, cu->cu_proc, rtt);
+		rtt->cr_adaptive = (cu->cu_rtt != NULL && !cu->cu_fixedwait);
+		break;
 	case CLGET_FD:
 		*(int *)(void *)info = cu->cu_fd;
 		break;
@@ -647,6 +758,8 @@ clnt_dg_control(CLIENT *cl, u_int request, char *info)
 		}
 		(void) memcpy(&cu->cu_raddr, addr->buf, (size_t)addr->len);
 		cu->cu_rlen = addr->len;
+		__dg_rtt_put(cu->cu_rtt);
+		cu->cu_rtt = __dg_rtt_get(&cu->cu_raddr, cu->cu_rlen);
 		break;
 	case CLGET_XID:
 		/*
@@ -730,6 +843,7 @@ clnt_dg_destroy(CLIENT *cl)
 	if (cu->cu_closeit)
 		(void) close(cu_fd);
 	XDR_DESTROY(&(cu->cu_outxdrs));
+	__dg_rtt_put(cu->cu_rtt);
 	mem_free(cu, (sizeof (*cu) + cu->cu_sendsz + cu->cu_recvsz));
 	if (cl->cl_netid && cl->cl_netid[0])
 		mem_free(cl->cl_netid, strlen(cl->cl_netid) +1);
@@ -781,3 +895,171 @@ time_not_ok(struct timeval *t)
 	return (t->tv_sec < -1 || t->tv_sec > 100000000 ||
 		t->tv_usec < -1 || t->tv_usec > 1000000);
 }
+
+static u_int
+dg_rtt_hashaddr(const struct sockaddr_storage *addr, int len)
+{
+	const u_char *cp = (const u_char *)(const void *)addr;
+	u_int hash = 0;
+
+	while (len-- > 0)
+		hash = hash * 31 + *cp++;
+	return (hash & (RTT_HASHSZ - 1));
+}
+
+/*
+ * Reference the estimator for the endpoint, creating as required;
+ * returns NULL if memory is exhausted (fixed retransmits are used).
+ */
+struct dg_rtt *
+__dg_rtt_get(const struct sockaddr_storage *addr, int len)
+{
+	struct dg_rtt **bucket, *rt;
+
+	if (len <= 0 || (size_t)len > sizeof (rt->rt_addr))
+		return (NULL);
+	bucket = &dg_rtt_hash[dg_rtt_hashaddr(addr, len)];
+	mutex_lock(&dg_rtt_lock);
+	for (rt = *bucket; rt; rt = rt->rt_next)
+		if (rt->rt_len == len && memcmp(&rt->rt_addr, addr, (size_t)len) == 0)
+			break;
+	if (rt == NULL) {
+		if ((rt = mem_alloc(sizeof (*rt))) != NULL) {
+			(void) memset(rt, 0, sizeof (*rt));
+			(void) memcpy(&rt->rt_addr, addr, (size_t)len);
+			rt->rt_len = len;
+			rt->rt_next = *bucket;
+			*bucket = rt;
+			rt->rt_refs = 1;
+		}
+	} else if (rt->rt_refs++ == 0) {
+		--dg_rtt_idle;
+	}
+	mutex_unlock(&dg_rtt_lock);
+	return (rt);
+}
+
+/*
+ * Release an estimator.  Unreferenced estimators are retained, so that
+ * history survives handles being recreated, up to RTT_MAXIDLE.
+ */
+void
+__dg_rtt_put(struct dg_rtt *rt)
+{
+	struct dg_rtt **rtp, *idle;
+	u_int i;
+
+	if (rt == NULL)
+		return;
+	mutex_lock(&dg_rtt_lock);
+	if (--rt->rt_refs == 0 && ++dg_rtt_idle > RTT_MAXIDLE) {
+		/* discard an idle estimator, any will do */
+		for (i = 0; i < RTT_HASHSZ; ++i) {
+			for (rtp = &dg_rtt_hash[i]; (idle = *rtp) != NULL;
+			    rtp = &idle->rt_next)
+				if (idle->rt_refs == 0)
+					break;
+			if (idle != NULL) {
+				*rtp = idle->rt_next;
+				mem_free(idle, sizeof (*idle));
+				--dg_rtt_idle;
+				break;
+			}
+		}
+	}
+	mutex_unlock(&dg_rtt_lock);
+}
+
+/*
+ * Fold a round trip sample of the procedure into its timer class.
+ */
+void
+__dg_rtt_update(struct dg_rtt *rt, rpcproc_t proc,
+    const struct timeval *sample)
+{
+	struct dg_timer *t;
+	long m, delta;
+
+	if (rt == NULL)
+		return;
+	m = (long)sample->tv_sec * 1000000 + sample->tv_usec;
+	if (m < 0 || m > (long)RPC_MAX_BACKOFF * 1000000)
+		return;
+	t = &rt->rt_timer[RTT_TIMER(proc)];
+	mutex_lock(&dg_rtt_lock);
+	rt->rt_samples++;
+	if (t->t_samples++ == 0) {
+		t->t_srtt = m << 3;
+		t->t_rttvar = m << 1;		/* m/2, scaled by 4 */
+	} else {
+		delta = m - (t->t_srtt >> 3);
+		t->t_srtt += delta;		/* srtt += delta/8 */
+		if (delta < 0)
+			delta = -delta;
+		t->t_rttvar += delta - (t->t_rttvar >> 2);
+	}
+	t->t_rto = (t->t_srtt >> 3) + t->t_rttvar;
+	if (t->t_rto < RPC_MIN_RTO)
+		t->t_rto = RPC_MIN_RTO;
+	else if (t->t_rto > (long)RPC_MAX_BACKOFF * 1000000)
+		t->t_rto = (long)RPC_MAX_BACKOFF * 1000000;
+	mutex_unlock(&dg_rtt_lock);
+}
+
+/*
+ * Replace *wait, the caller's retry interval, by the estimated retransmit
+ * timeout of the procedure's timer class once that has been sampled.  The
+ * estimate may only lengthen the interval: a call is never retransmitted
+ * more often than the caller asked for.
+ */
+void
+__dg_rtt_rto(struct dg_rtt *rt, rpcproc_t proc, struct timeval *wait)
+{
+	struct dg_timer *t;
+
+	if (rt == NULL)
+		return;
+	t = &rt->rt_timer[RTT_TIMER(proc)];
+	mutex_lock(&dg_rtt_lock);
+	if (t->t_samples &&
+	    t->t_rto > (long)wait->tv_sec * 1000000 + wait->tv_usec) {
+		wait->tv_sec = t->t_rto / 1000000;
+		wait->tv_usec = t->t_rto % 1000000;
+	}
+	mutex_unlock(&dg_rtt_lock);
+}
+
+void
+__dg_rtt_timeout(struct dg_rtt *rt)
+{
+	if (rt == NULL)
+		return;
+	mutex_lock(&dg_rtt_lock);
+	rt->rt_timeouts++;
+	mutex_unlock(&dg_rtt_lock);
+}
+
+/*
+ * Report the estimate of the procedure's timer class, and the totals of
+ * the endpoint.
+ */
+void
+__dg_rtt_stats(struct dg_rtt *rt, rpcproc_t proc, struct clnt_rtt *rtt)
+{
+	struct dg_timer *t;
+
+	(void) memset(rtt, 0, sizeof (*rtt));
+	if (rt == NULL)
+		return;
+	t = &rt->rt_timer[RTT_TIMER(proc)];
+	mutex_lock(&dg_rtt_lock);
+	rtt->cr_srtt.tv_sec = (t->t_srtt >> 3) / 1000000;
+	rtt->cr_srtt.tv_usec = (t->t_srtt >> 3) % 1000000;
+	rtt->cr_rttvar.tv_sec = (t->t_rttvar >> 2) / 1000000;
+	rtt->cr_rttvar.tv_usec = (t->t_rttvar >> 2) % 1000000;
+	rtt->cr_rto.tv_sec = t->t_rto / 1000000;
+	rtt->cr_rto.tv_usec = t->t_rto % 1000000;
+	rtt->cr_samples = rt->rt_samples;
+	rtt->cr_timeouts = rt->rt_timeouts;
+	mutex_unlock(&dg_rtt_lock);
+}
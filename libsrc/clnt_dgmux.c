@@ -0,0 +1,907 @@
+/*
+ *  Multiplexed connectionless client side RPC.
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+/*
+ * Unlike clnt_dg, which serializes all calls on a socket, handles created
+ * by clnt_dg_mux_create() share one multiplexer per socket which carries
+ * any number of outstanding calls, from any number of threads and handles
+ * (and servers).  Each call is registered by xid; one waiting caller at a
+ * time reads the socket on behalf of all (leader/follower), delivering
+ * each reply to the caller registered under its xid and waking it.  When
+ * the reader's own reply arrives, or its wait expires, the socket is
+ * handed to another waiter.
+ *
+ * Retransmission follows clnt_dg, including the shared round trip
+ * estimator.  Every call, and every credential refresh, uses a fresh xid,
+ * so CLSET_XID is not supported; CLGET_XID returns the last xid issued.
+ */
+
+#include "namespace.h"
+#include "reentrant.h"
+#include <sys/poll.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <rpc/rpc.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <err.h>
+
+#include "svc_fdset.h"
+#include "rpc_internal.h"
+
+#define	RPC_MAX_BACKOFF		30 /* seconds */
+#define	MUX_HASHSZ		64 /* outstanding call buckets, power of 2 */
+#define	MUX_RECVSZ		(64 * 1024) /* largest datagram */
+#define	MUX_HDRSZ		(5 * BYTES_PER_XDR_UNIT) /* xid .. vers */
+
+static struct clnt_ops *clnt_dgmux_ops(void);
+static bool_t time_not_ok(struct timeval *);
+static enum clnt_stat clnt_dgmux_call(CLIENT *, rpcproc_t, xdrproc_t,
+    const char *, xdrproc_t, caddr_t, struct timeval);
+static void clnt_dgmux_geterr(CLIENT *, struct rpc_err *);
+static bool_t clnt_dgmux_freeres(CLIENT *, xdrproc_t, caddr_t);
+static void clnt_dgmux_abort(CLIENT *);
+static bool_t clnt_dgmux_control(CLIENT *, u_int, char *);
+static void clnt_dgmux_destroy(CLIENT *);
+
+static const char mem_err_clnt_dgmux[] = "clnt_dg_mux_create: out of memory";
+
+/*
+ * An outstanding call, living on its caller's stack.
+ */
+struct mux_call {
+	struct mux_call		*mc_next;	/* xid hash chain */
+	u_int32_t		mc_xid;
+	int			mc_replied;
+	cond_t			mc_cv;
+	char			*mc_inbuf;
+	u_int			mc_recvsz;
+	u_int			mc_recvlen;
+};
+
+/*
+ * Per socket multiplexer, shared by all handles created on the socket.
+ */
+struct dgmux {
+	struct dgmux		*mx_next;	/* all multiplexers */
+	int			mx_fd;
+	u_int			mx_refs;	/* handles */
+	bool_t			mx_closeit;	/* close on last destroy */
+	bool_t			mx_receiving;	/* a caller reads the socket */
+	mutex_t			mx_lock;
+	struct mux_call		*mx_calls[MUX_HASHSZ];
+	u_long			mx_stray;	/* replies without a caller */
+	char			*mx_rbuf;	/* MUX_RECVSZ, reader only */
+};
+
+/*
+ * Private data kept per client handle; protected by mx_lock.
+ */
+struct mu_data {
+	struct dgmux		*mu_mux;
+	struct sockaddr_storage	mu_raddr;	/* remote address */
+	int			mu_rlen;
+	struct timeval		mu_wait;	/* retransmit interval */
+	bool_t			mu_fixedwait;	/* mu_wait set by the user */
+	struct timeval		mu_total;	/* total time for the call */
+	struct dg_rtt		*mu_rtt;	/* endpoint rtt estimator */
+	rpcproc_t		mu_proc;	/* of the last call */
+	struct rpc_err		mu_error;	/* of the last call completed */
+	u_int32_t		mu_xid;		/* last xid issued */
+	u_int			mu_sendsz;
+	u_int			mu_recvsz;
+	char			mu_header[MUX_HDRSZ];
+};
+
+static struct dgmux *dgmuxes;
+
+#ifdef _REENTRANT
+extern mutex_t dgmux_lock;
+#endif
+
+/* VARIABLES PROTECTED BY dgmux_lock: dgmuxes, mx_refs, mx_next */
+
+static struct dgmux *mux_attach(int);
+static void mux_detach(struct dgmux *);
+static void mux_register(struct dgmux *, struct mux_call *);
+static void mux_unregister(struct dgmux *, struct mux_call *);
+static int mux_wait(struct dgmux *, struct mux_call *, const struct timeval *,
+    struct rpc_err *);
+static int mux_receive(struct dgmux *, struct mux_call *,
+    const struct timeval *, struct rpc_err *);
+static void mux_promote(struct dgmux *, struct mux_call *);
+static int mux_send(struct dgmux *, const char *, size_t,
+    const struct sockaddr *, socklen_t, const struct timeval *,
+    struct rpc_err *);
+
+/*
+ * Multiplexed connectionless client creation; as clnt_dg_create(), but
+ * any number of handles, and concurrent calls on each, may share fd.
+ */
+LIBRPC_API CLIENT *
+clnt_dg_mux_create(
+	const int fd,			/* open file descriptor */
+	const struct netbuf *svcaddr,	/* servers address */
+	const rpcprog_t program,	/* program number */
+	const rpcvers_t version,	/* version number */
+	u_int sendsz,			/* buffer send size */
+	u_int recvsz)			/* buffer recv size */
+{
+	CLIENT *cl = NULL;		/* client handle */
+	struct mu_data *mu = NULL;	/* private data */
+	struct rpc_msg call_msg;
+	struct __rpc_sockinfo si;
+	XDR xdrs;
+
+	if (svcaddr == NULL) {
+		rpc_createerr.cf_stat = RPC_UNKNOWNADDR;
+		return (NULL);
+	}
+	if (svcaddr->len > sizeof (mu->mu_raddr)) {
+		rpc_createerr.cf_stat = RPC_TLIERROR;
+		rpc_createerr.cf_error.re_errno = 0;
+		return (NULL);
+	}
+
+	if (!__rpc_fd2sockinfo(fd, &si)) {
+		rpc_createerr.cf_stat = RPC_TLIERROR;
+		rpc_createerr.cf_error.re_errno = 0;
+		return (NULL);
+	}
+	sendsz = __rpc_get_t_size(si.si_af, si.si_proto, (int)sendsz);
+	recvsz = __rpc_get_t_size(si.si_af, si.si_proto, (int)recvsz);
+	if ((sendsz == 0) || (recvsz == 0)) {
+		rpc_createerr.cf_stat = RPC_TLIERROR; /* XXX */
+		rpc_createerr.cf_error.re_errno = 0;
+		return (NULL);
+	}
+	sendsz = ((sendsz + 3) / 4) * 4;
+	recvsz = ((recvsz + 3) / 4) * 4;
+
+	if ((cl = mem_alloc(sizeof (CLIENT))) == NULL ||
+	    (mu = mem_alloc(sizeof (*mu))) == NULL)
+		goto err1;
+	(void) memset(mu, 0, sizeof (*mu));
+	(void) memcpy(&mu->mu_raddr, svcaddr->buf, (size_t)svcaddr->len);
+	mu->mu_rlen = svcaddr->len;
+	mu->mu_wait.tv_sec = 0;
+	mu->mu_wait.tv_usec = 100000;
+	mu->mu_total.tv_sec = -1;
+	mu->mu_total.tv_usec = -1;
+	mu->mu_sendsz = sendsz;
+	mu->mu_recvsz = recvsz;
+
+	/* call header template; the xid is inserted per call */
+	call_msg.rm_xid = 0;
+	call_msg.rm_call.cb_prog = program;
+	call_msg.rm_call.cb_vers = version;
+	xdrmem_create(&xdrs, mu->mu_header, MUX_HDRSZ, XDR_ENCODE);
+	if (! xdr_callhdr(&xdrs, &call_msg)) {
+		rpc_createerr.cf_stat = RPC_CANTENCODEARGS;  /* XXX */
+		rpc_createerr.cf_error.re_errno = 0;
+		goto err2;
+	}
+	XDR_DESTROY(&xdrs);
+
+	if ((mu->mu_mux = mux_attach(fd)) == NULL)
+		goto err1;
+	mu->mu_rtt = __dg_rtt_get(&mu->mu_raddr, mu->mu_rlen);
+
+	cl->cl_ops = clnt_dgmux_ops();
+	cl->cl_private = (caddr_t)(void *)mu;
+	cl->cl_auth = authnone_create();
+	cl->cl_tp = NULL;
+	cl->cl_netid = NULL;
+	return (cl);
+err1:
+	warnx(mem_err_clnt_dgmux);
+	rpc_createerr.cf_stat = RPC_SYSTEMERROR;
+	rpc_createerr.cf_error.re_errno = errno;
+err2:
+	if (cl)
+		mem_free(cl, sizeof (CLIENT));
+	if (mu)
+		mem_free(mu, sizeof (*mu));
+	return (NULL);
+}
+
+static enum clnt_stat
+clnt_dgmux_call(
+	CLIENT *	cl,		/* client handle */
+	rpcproc_t	proc,		/* procedure number */
+	xdrproc_t	xargs,		/* xdr routine for args */
+	const char *	argsp,		/* pointer to args */
+	xdrproc_t	xresults,	/* xdr routine for results */
+	caddr_t		resultsp,	/* pointer to results */
+	struct timeval	utimeout)	/* seconds to wait before giving up */
+{
+	struct mu_data *mu;
+	struct dgmux *mx;
+	struct mux_call call;
+	struct rpc_err error;
+	XDR xdrs;
+	char *outbuf;
+	size_t outlen;
+	struct rpc_msg reply_msg;
+	XDR reply_xdrs;
+	bool_t ok;
+	int nrefreshes = 2;		/* number of times to refresh cred */
+	struct timeval timeout;
+	struct timeval retransmit_time;
+	struct timeval next_sendtime, starttime, time_waited, tv;
+	struct timeval sendtime;
+	int nsends = 0;
+
+	_DIAGASSERT(cl != NULL);
+
+	mu = (struct mu_data *)cl->cl_private;
+	mx = mu->mu_mux;
+
+	(void) memset(&error, 0, sizeof (error));
+	(void) memset(&call, 0, sizeof (call));
+	if ((outbuf = mem_alloc(mu->mu_sendsz + mu->mu_recvsz)) == NULL) {
+		error.re_errno = errno;
+		error.re_status = RPC_SYSTEMERROR;
+		goto done;
+	}
+	call.mc_inbuf = outbuf + mu->mu_sendsz;
+	call.mc_recvsz = mu->mu_recvsz;
+	cond_init(&call.mc_cv, 0, (void *) 0);
+
+	mutex_lock(&mx->mx_lock);
+	if (mu->mu_total.tv_usec == -1) {
+		timeout = utimeout;	/* use supplied timeout */
+	} else {
+		timeout = mu->mu_total;	/* use default timeout */
+	}
+	retransmit_time = mu->mu_wait;
+	if (!mu->mu_fixedwait)
+		__dg_rtt_rto(mu->mu_rtt, proc, &retransmit_time);
+	mu->mu_proc = proc;
+	mutex_unlock(&mx->mx_lock);
+
+call_again:
+	call.mc_xid = __RPC_GETXID();
+	call.mc_replied = 0;
+	mutex_lock(&mx->mx_lock);
+	(void) memcpy(outbuf, mu->mu_header, MUX_HDRSZ);
+	mu->mu_xid = call.mc_xid;
+	mutex_unlock(&mx->mx_lock);
+	*(u_int32_t *)(void *)outbuf = htonl(call.mc_xid);
+
+	xdrmem_create(&xdrs, outbuf, mu->mu_sendsz, XDR_ENCODE);
+	XDR_SETPOS(&xdrs, MUX_HDRSZ);
+	if (! XDR_PUTINT32(&xdrs, (int32_t *)&proc))
+		ok = FALSE;
+	else {				/* cl_auth is shared with other callers */
+		mutex_lock(&mx->mx_lock);
+		ok = AUTH_MARSHALL(cl->cl_auth, &xdrs);
+		mutex_unlock(&mx->mx_lock);
+	}
+	if ((! ok) || (! (*xargs)(&xdrs, __UNCONST(argsp)))) {
+		XDR_DESTROY(&xdrs);
+		error.re_status = RPC_CANTENCODEARGS;
+		goto out;
+	}
+	outlen = (size_t)XDR_GETPOS(&xdrs);
+	XDR_DESTROY(&xdrs);
+
+	mux_register(mx, &call);
+	time_waited.tv_sec = 0;
+	time_waited.tv_usec = 0;
+	next_sendtime = retransmit_time;
+	nsends = 0;
+	__rpc_clock(&starttime);
+
+send_again:
+	timersub(&timeout, &time_waited, &tv);
+	if (tv.tv_sec < 0 || tv.tv_usec < 0)
+		tv.tv_sec = tv.tv_usec = 0;
+	if (mux_send(mx, outbuf, outlen,
+	    (struct sockaddr *)(void *)&mu->mu_raddr, (socklen_t)mu->mu_rlen,
+	    &tv, &error) != 0)
+		goto out;
+	__rpc_clock(&sendtime);
+	++nsends;
+
+	/*
+	 * Hack to provide rpc-based message passing
+	 */
+	if (timeout.tv_sec == 0 && timeout.tv_usec == 0) {
+		error.re_status = RPC_TIMEDOUT;
+		goto out;
+	}
+
+	for (;;) {
+		/* Decide how long to wait. */
+		if (timercmp(&next_sendtime, &timeout, < ))
+			timersub(&next_sendtime, &time_waited, &tv);
+		else
+			timersub(&timeout, &time_waited, &tv);
+		if (tv.tv_sec < 0 || tv.tv_usec < 0)
+			tv.tv_sec = tv.tv_usec = 0;
+
+		if (mux_wait(mx, &call, &tv, &error) != 0)
+			goto out;
+		if (call.mc_replied)
+			break;
+
+		__rpc_clock(&tv);
+		timersub(&tv, &starttime, &time_waited);
+
+		/* Check for timeout. */
+		if (timercmp(&time_waited, &timeout, >)) {
+			error.re_status = RPC_TIMEDOUT;
+			__dg_rtt_timeout(mu->mu_rtt);
+			goto out;
+		}
+
+		/* Retransmit if necessary. */
+		if (timercmp(&time_waited, &next_sendtime, >)) {
+			if (retransmit_time.tv_sec < RPC_MAX_BACKOFF)
+				timeradd(&retransmit_time, &retransmit_time,
+				    &retransmit_time);
+			timeradd(&next_sendtime, &retransmit_time,
+			    &next_sendtime);
+			goto send_again;
+		}
+	}
+	mux_unregister(mx, &call);
+
+	if (nsends == 1) {
+		__rpc_clock(&tv);
+		timersub(&tv, &sendtime, &tv);
+		__dg_rtt_update(mu->mu_rtt, proc, &tv);
+	}
+
+	/*
+	 * now decode and validate the response
+	 */
+	reply_msg.acpted_rply.ar_verf = _null_auth;
+	reply_msg.acpted_rply.ar_results.where = resultsp;
+	reply_msg.acpted_rply.ar_results.proc = xresults;
+
+	xdrmem_create(&reply_xdrs, call.mc_inbuf, call.mc_recvlen, XDR_DECODE);
+	ok = xdr_replymsg(&reply_xdrs, &reply_msg);
+	if (ok) {
+		if ((reply_msg.rm_reply.rp_stat == MSG_ACCEPTED) &&
+			(reply_msg.acpted_rply.ar_stat == SUCCESS))
+			error.re_status = RPC_SUCCESS;
+		else
+			_seterr_reply(&reply_msg, &error);
+
+		if (error.re_status == RPC_SUCCESS) {
+			mutex_lock(&mx->mx_lock);
+			ok = AUTH_VALIDATE(cl->cl_auth,
+			    &reply_msg.acpted_rply.ar_verf);
+			mutex_unlock(&mx->mx_lock);
+			if (! ok) {
+				error.re_status = RPC_AUTHERROR;
+				error.re_why = AUTH_INVALIDRESP;
+			}
+			if (reply_msg.acpted_rply.ar_verf.oa_base != NULL) {
+				reply_xdrs.x_op = XDR_FREE;
+				(void) xdr_opaque_auth(&reply_xdrs,
+					&(reply_msg.acpted_rply.ar_verf));
+			}
+		}		/* end successful completion */
+		/*
+		 * If unsuccesful AND error is an authentication error
+		 * then refresh credentials and try again, else break
+		 */
+		else if (error.re_status == RPC_AUTHERROR && nrefreshes > 0) {
+			/* maybe our credentials need to be refreshed ... */
+			mutex_lock(&mx->mx_lock);
+			ok = AUTH_REFRESH(cl->cl_auth);
+			mutex_unlock(&mx->mx_lock);
+			if (ok) {
+				nrefreshes--;
+				XDR_DESTROY(&reply_xdrs);
+				goto call_again;
+			}
+		}
+		/* end of unsuccessful completion */
+	}	/* end of valid reply message */
+	else {
+		error.re_status = RPC_CANTDECODERES;
+	}
+	XDR_DESTROY(&reply_xdrs);
+out:
+	mux_unregister(mx, &call);
+	cond_destroy(&call.mc_cv);
+	mem_free(outbuf, mu->mu_sendsz + mu->mu_recvsz);
+done:
+	/* stale address?  see clnt_dg_call() */
+	if (error.re_status != RPC_SUCCESS &&
+	    (error.re_status != RPC_TIMEDOUT || nsends > 1))
+		__rpcb_cache_failed(&mu->mu_raddr, (size_t)mu->mu_rlen,
+		    error.re_status);
+	mutex_lock(&mx->mx_lock);
+	mu->mu_error = error;
+	mutex_unlock(&mx->mx_lock);
+	return (error.re_status);
+}
+
+/*
+ * Wait up to *tv for the call to be answered, reading the socket if no
+ * other caller is.  Returns -1 on a receive error.
+ */
+static int
+mux_wait(struct dgmux *mx, struct mux_call *call, const struct timeval *tv,
+    struct rpc_err *error)
+{
+	struct timeval deadline;
+	struct timespec abstime;
+	int ret = 0;
+
+	__rpc_deadline(&deadline, tv);
+
+	mutex_lock(&mx->mx_lock);
+	while (! call->mc_replied) {
+		if (! mx->mx_receiving) {
+			/* lead */
+			mx->mx_receiving = TRUE;
+			mutex_unlock(&mx->mx_lock);
+			ret = mux_receive(mx, call, &deadline, error);
+			mutex_lock(&mx->mx_lock);
+			mx->mx_receiving = FALSE;
+			mux_promote(mx, call);
+			break;
+		}
+
+		/* follow, until replied, promoted or expired */
+		if (! __rpc_deadline_abstime(&deadline, &abstime))
+			break;
+		(void) cond_timedwait(&call->mc_cv, &mx->mx_lock, &abstime);
+	}
+	mutex_unlock(&mx->mx_lock);
+	return (ret);
+}
+
+/*
+ * Read the socket until our reply arrives or the deadline passes,
+ * delivering any other replies to their callers.
+ */
+static int
+mux_receive(struct dgmux *mx, struct mux_call *self,
+    const struct timeval *deadline, struct rpc_err *error)
+{
+	struct pollfd pfd;
+	struct timespec ts;
+	struct mux_call *mc;
+	ssize_t recvlen;
+	u_int32_t xid;
+	int n;
+
+	pfd.fd = mx->mx_fd;
+	pfd.events = POLLIN | POLLPRI | POLLRDNORM | POLLRDBAND;
+
+	while (! self->mc_replied) {
+		if (! __rpc_deadline_left(deadline, &ts))
+			break;
+
+		pfd.revents = 0;
+		n = pollts(&pfd, 1, &ts, NULL);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			error->re_errno = errno;
+			error->re_status = RPC_CANTRECV;
+			return (-1);
+		}
+		if (n == 0)
+			continue;
+
+		/*
+		 * Drain what has arrived; the caller's socket may be
+		 * blocking, so re-poll without waiting between reads.
+		 */
+		for (;; ts.tv_sec = ts.tv_nsec = 0) {
+			if (pfd.revents == 0 &&
+			    pollts(&pfd, 1, &ts, NULL) <= 0)
+				break;
+			pfd.revents = 0;
+			recvlen = recvfrom(mx->mx_fd, mx->mx_rbuf, MUX_RECVSZ,
+			    0, NULL, NULL);
+			if (recvlen < 0) {
+				if (errno == EINTR)
+					continue;
+#if defined(_WIN32)
+				if (errno == WSAEWOULDBLOCK || errno == EWOULDBLOCK)
+#else
+				if (errno == EWOULDBLOCK || errno == EAGAIN)
+#endif
+					break;
+				error->re_errno = errno;
+				error->re_status = RPC_CANTRECV;
+				return (-1);
+			}
+			if (recvlen < (ssize_t)sizeof (u_int32_t))
+				continue;
+
+			(void) memcpy(&xid, mx->mx_rbuf, sizeof (xid));
+			xid = ntohl(xid);
+			mutex_lock(&mx->mx_lock);
+			for (mc = mx->mx_calls[xid & (MUX_HASHSZ - 1)]; mc;
+			    mc = mc->mc_next)
+				if (mc->mc_xid == xid && !mc->mc_replied)
+					break;
+			if (mc != NULL) {
+				mc->mc_recvlen = (u_int)recvlen > mc->mc_recvsz ?
+				    mc->mc_recvsz : (u_int)recvlen;
+				(void) memcpy(mc->mc_inbuf, mx->mx_rbuf,
+				    mc->mc_recvlen);
+				mc->mc_replied = 1;
+				if (mc != self)
+					cond_signal(&mc->mc_cv);
+			} else {
+				mx->mx_stray++;
+			}
+			mutex_unlock(&mx->mx_lock);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Send a datagram, waiting up to *tv for buffer space should the socket
+ * have been made non-blocking by its owner.  Returns -1 on a send error.
+ */
+static int
+mux_send(struct dgmux *mx, const char *buf, size_t len,
+    const struct sockaddr *to, socklen_t tolen, const struct timeval *tv,
+    struct rpc_err *error)
+{
+	struct timeval deadline;
+	struct timespec ts;
+	struct pollfd pfd;
+
+	__rpc_deadline(&deadline, tv);
+	pfd.fd = mx->mx_fd;
+	pfd.events = POLLOUT | POLLWRNORM;
+
+	for (;;) {
+		if ((size_t)sendto(mx->mx_fd, buf, len, 0, to, tolen) == len)
+			return (0);
+		if (errno == EINTR)
+			continue;
+#if defined(_WIN32)
+		if (errno != WSAEWOULDBLOCK && errno != EWOULDBLOCK)
+#else
+		if (errno != EWOULDBLOCK && errno != EAGAIN)
+#endif
+			break;
+		if (! __rpc_deadline_left(&deadline, &ts)) {
+			error->re_status = RPC_TIMEDOUT;
+			return (-1);
+		}
+		pfd.revents = 0;
+		if (pollts(&pfd, 1, &ts, NULL) == -1 && errno != EINTR)
+			break;
+	}
+	error->re_errno = errno;
+	error->re_status = RPC_CANTSEND;
+	return (-1);
+}
+
+/*
+ * Hand the socket to another waiting caller, if any; mx_lock held.
+ */
+static void
+mux_promote(struct dgmux *mx, struct mux_call *self)
+{
+	struct mux_call *mc;
+	u_int i;
+
+	for (i = 0; i < MUX_HASHSZ; ++i)
+		for (mc = mx->mx_calls[i]; mc; mc = mc->mc_next)
+			if (mc != self && !mc->mc_replied) {
+				cond_signal(&mc->mc_cv);
+				return;
+			}
+}
+
+static void
+mux_register(struct dgmux *mx, struct mux_call *call)
+{
+	struct mux_call **bucket = &mx->mx_calls[call->mc_xid & (MUX_HASHSZ - 1)];
+
+	mutex_lock(&mx->mx_lock);
+	call->mc_next = *bucket;
+	*bucket = call;
+	mutex_unlock(&mx->mx_lock);
+}
+
+/*
+ * Remove the call, if registered.
+ */
+static void
+mux_unregister(struct dgmux *mx, struct mux_call *call)
+{
+	struct mux_call **mcp;
+
+	mutex_lock(&mx->mx_lock);
+	for (mcp = &mx->mx_calls[call->mc_xid & (MUX_HASHSZ - 1)]; *mcp;
+	    mcp = &(*mcp)->mc_next)
+		if (*mcp == call) {
+			*mcp = call->mc_next;
+			break;
+		}
+	call->mc_next = NULL;
+	mutex_unlock(&mx->mx_lock);
+}
+
+/*
+ * Reference the multiplexer for fd, creating as required.
+ */
+static struct dgmux *
+mux_attach(int fd)
+{
+	struct dgmux *mx;
+
+	mutex_lock(&dgmux_lock);
+	for (mx = dgmuxes; mx; mx = mx->mx_next)
+		if (mx->mx_fd == fd)
+			break;
+	if (mx == NULL) {
+		if ((mx = mem_alloc(sizeof (*mx))) == NULL ||
+		    (mx->mx_rbuf = mem_alloc(MUX_RECVSZ)) == NULL) {
+			if (mx)
+				mem_free(mx, sizeof (*mx));
+			mutex_unlock(&dgmux_lock);
+			return (NULL);
+		}
+		(void) memset(mx->mx_calls, 0, sizeof (mx->mx_calls));
+		mx->mx_fd = fd;
+		mx->mx_refs = 0;
+		mx->mx_closeit = FALSE;
+		mx->mx_receiving = FALSE;
+		mx->mx_stray = 0;
+		mutex_init(&mx->mx_lock, NULL);
+		mx->mx_next = dgmuxes;
+		dgmuxes = mx;
+	}
+	mx->mx_refs++;
+	mutex_unlock(&dgmux_lock);
+	return (mx);
+}
+
+static void
+mux_detach(struct dgmux *mx)
+{
+	struct dgmux **mxp;
+
+	mutex_lock(&dgmux_lock);
+	if (--mx->mx_refs == 0) {
+		for (mxp = &dgmuxes; *mxp != mx; mxp = &(*mxp)->mx_next)
+			continue;
+		*mxp = mx->mx_next;
+		if (mx->mx_closeit)
+			(void) close(mx->mx_fd);
+		mem_free(mx->mx_rbuf, MUX_RECVSZ);
+		mem_free(mx, sizeof (*mx));
+	}
+	mutex_unlock(&dgmux_lock);
+}
+
+static void
+clnt_dgmux_geterr(CLIENT *cl, struct rpc_err *errp)
+{
+	struct mu_data *mu;
+
+	_DIAGASSERT(cl != NULL);
+	_DIAGASSERT(errp != NULL);
+
+	mu = (struct mu_data *)cl->cl_private;
+	mutex_lock(&mu->mu_mux->mx_lock);
+	*errp = mu->mu_error;
+	mutex_unlock(&mu->mu_mux->mx_lock);
+}
+
+/*ARGSUSED*/
+static bool_t
+clnt_dgmux_freeres(CLIENT *cl, xdrproc_t xdr_res, caddr_t res_ptr)
+{
+	XDR xdrs;
+
+	(void) memset(&xdrs, 0, sizeof (xdrs));
+	xdrs.x_op = XDR_FREE;
+	return ((*xdr_res)(&xdrs, res_ptr));
+}
+
+/*ARGSUSED*/
+static void
+clnt_dgmux_abort(CLIENT *h)
+{
+}
+
+static bool_t
+clnt_dgmux_control(CLIENT *cl, u_int request, char *info)
+{
+	struct mu_data *mu;
+	struct dgmux *mx;
+	struct netbuf *addr;
+	bool_t ret = TRUE;
+
+	_DIAGASSERT(cl != NULL);
+	/* info is handled below */
+
+	mu = (struct mu_data *)cl->cl_private;
+	mx = mu->mu_mux;
+
+	switch (request) {
+	case CLSET_FD_CLOSE:
+		mutex_lock(&dgmux_lock);
+		mx->mx_closeit = TRUE;
+		mutex_unlock(&dgmux_lock);
+		return (TRUE);
+	case CLSET_FD_NCLOSE:
+		mutex_lock(&dgmux_lock);
+		mx->mx_closeit = FALSE;
+		mutex_unlock(&dgmux_lock);
+		return (TRUE);
+	}
+
+	/* for other requests which use info */
+	if (info == NULL)
+		return (FALSE);
+
+	mutex_lock(&mx->mx_lock);
+	switch (request) {
+	case CLSET_TIMEOUT:
+		if (time_not_ok((struct timeval *)(void *)info)) {
+			ret = FALSE;
+			break;
+		}
+		mu->mu_total = *(struct timeval *)(void *)info;
+		break;
+	case CLGET_TIMEOUT:
+		*(struct timeval *)(void *)info = mu->mu_total;
+		break;
+	case CLGET_SERVER_ADDR:		/* Give him the fd address */
+		/* Now obsolete. Only for backward compatibility */
+		(void) memcpy(info, &mu->mu_raddr, (size_t)mu->mu_rlen);
+		break;
+	case CLSET_RETRY_TIMEOUT:
+		if (time_not_ok((struct timeval *)(void *)info)) {
+			ret = FALSE;
+			break;
+		}
+		mu->mu_wait = *(struct timeval *)(void *)info;
+		mu->mu_fixedwait = TRUE;	/* disables adaptive rto */
+		break;
+	case CLGET_RETRY_TIMEOUT:
+		*(struct timeval *)(void *)info = mu->mu_wait;
+		break;
+	case CLGET_RTT:
+		__dg_rtt_stats(mu->mu_rtt, mu->mu_proc,
+		    (struct clnt_rtt *)(void *)info);
+		((struct clnt_rtt *)(void *)info)->cr_adaptive =
+		    (mu->mu_rtt != NULL && !mu->mu_fixedwait);
+		break;
+	case CLGET_FD:
+		*(int *)(void *)info = mx->mx_fd;
+		break;
+	case CLGET_SVC_ADDR:
+		addr = (struct netbuf *)(void *)info;
+		addr->buf = &mu->mu_raddr;
+		addr->len = mu->mu_rlen;
+		addr->maxlen = sizeof mu->mu_raddr;
+		break;
+	case CLGET_XID:
+		/* the xid of the PREVIOUS call */
+		*(u_int32_t *)(void *)info = mu->mu_xid;
+		break;
+	case CLGET_VERS:
+		/* the version is the fifth field of the call header */
+		*(u_int32_t *)(void *)info =
+		    ntohl(*(u_int32_t *)(void *)(mu->mu_header +
+		    4 * BYTES_PER_XDR_UNIT));
+		break;
+	case CLSET_VERS:
+		*(u_int32_t *)(void *)(mu->mu_header + 4 * BYTES_PER_XDR_UNIT)
+			= htonl(*(u_int32_t *)(void *)info);
+		break;
+	case CLGET_PROG:
+		/* the program is the fourth field of the call header */
+		*(u_int32_t *)(void *)info =
+		    ntohl(*(u_int32_t *)(void *)(mu->mu_header +
+		    3 * BYTES_PER_XDR_UNIT));
+		break;
+	case CLSET_PROG:
+		*(u_int32_t *)(void *)(mu->mu_header + 3 * BYTES_PER_XDR_UNIT)
+			= htonl(*(u_int32_t *)(void *)info);
+		break;
+	default:
+		ret = FALSE;
+		break;
+	}
+	mutex_unlock(&mx->mx_lock);
+	return (ret);
+}
+
+static void
+clnt_dgmux_destroy(CLIENT *cl)
+{
+	struct mu_data *mu;
+
+	_DIAGASSERT(cl != NULL);
+
+	mu = (struct mu_data *)cl->cl_private;
+	mux_detach(mu->mu_mux);
+	__dg_rtt_put(mu->mu_rtt);
+	mem_free(mu, sizeof (*mu));
+	if (cl->cl_netid && cl->cl_netid[0])
+		mem_free(cl->cl_netid, strlen(cl->cl_netid) +1);
+	if (cl->cl_tp && cl->cl_tp[0])
+		mem_free(cl->cl_tp, strlen(cl->cl_tp) +1);
+	mem_free(cl, sizeof (CLIENT));
+}
+
+static struct clnt_ops *
+clnt_dgmux_ops(void)
+{
+	static struct clnt_ops ops;
+#ifdef _REENTRANT
+	extern mutex_t	ops_lock;
+#endif
+
+/* VARIABLES PROTECTED BY ops_lock: ops */
+
+	mutex_lock(&ops_lock);
+	if (ops.cl_call == NULL) {
+		ops.cl_call = clnt_dgmux_call;
+		ops.cl_abort = clnt_dgmux_abort;
+		ops.cl_geterr = clnt_dgmux_geterr;
+		ops.cl_freeres = clnt_dgmux_freeres;
+		ops.cl_destroy = clnt_dgmux_destroy;
+		ops.cl_control = clnt_dgmux_control;
+	}
+	mutex_unlock(&ops_lock);
+	return (&ops);
+}
+
+/*
+ * Make sure that the time is not garbage.  -1 value is allowed.
+ */
+static bool_t
+time_not_ok(struct timeval *t)
+{
+
+	_DIAGASSERT(t != NULL);
+
+	return (t->tv_sec < -1 || t->tv_sec > 100000000 ||
+		t->tv_usec < -1 || t->tv_usec > 1000000);
+}
+
+/*end*/
@@ -250,6 +250,10 @@ clnt_tp_create(
 	if (cl == NULL) {
 		cl = clnt_tli_create(RPC_ANYFD, nconf, svcaddr,
 					prog, vers, 0, 0);
+		if (cl == NULL) {
+			/* the cached address may be stale */
+			__rpcb_cache_invalidate(prog, vers, nconf, hostname);
+		}
 	} else {
 		/* Reuse the CLIENT handle and change the appropriate fields */
 		if (CLNT_CONTROL(cl, CLSET_SVC_ADDR, (void *)svcaddr) == TRUE) {
@@ -0,0 +1,446 @@
+/*
+ *  Client handle pool.
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+/*
+ * Process wide pool of CLIENT handles, keyed by (host, prog, vers,
+ * nettype).
+ *
+ *	clnt = clnt_pool_get(host, prog, vers, nettype);
+ *	    ... clnt_call(clnt, ...) ...
+ *	clnt_pool_put(clnt, stat != RPC_SUCCESS);
+ *
+ * clnt_pool_get() leases an idle handle when one exists, otherwise one
+ * is created with clnt_create(); handles idle for longer than the check
+ * interval are first pinged with rpc_nullproc().  clnt_pool_put() returns
+ * the handle, or destroys it when the caller saw a failure.  Handles idle
+ * for longer than the idle limit are destroyed, and the number of handles
+ * per endpoint is capped; when at the cap, callers wait for a release.
+ * Limits and counters are set and read using rpc_control().
+ *
+ * A leased handle must not be destroyed by the caller, and any
+ * clnt_control() changes made persist into later leases.
+ */
+
+#include "namespace.h"
+#include "reentrant.h"
+#include <sys/types.h>
+#include <rpc/rpc.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rpc_internal.h"
+
+#define	POOL_HASHSZ	64		/* endpoint and lease buckets */
+#define	POOL_MAXCONN	8		/* default handles per endpoint */
+#define	POOL_IDLE	60		/* default idle limit, seconds */
+#define	POOL_CHECK	10		/* default check interval, seconds */
+#define	POOL_WAIT	30		/* default wait at the cap, seconds */
+
+struct pool_handle {
+	struct pool_handle *ph_next;	/* idle list or lease chain */
+	CLIENT		*ph_clnt;
+	struct pool_ep	*ph_ep;
+	time_t		ph_used;	/* when released */
+};
+
+struct pool_ep {
+	struct pool_ep	*pe_next;	/* hash chain */
+	u_int		pe_hash;
+	rpcprog_t	pe_prog;
+	rpcvers_t	pe_vers;
+	char		*pe_host;
+	char		*pe_nettype;
+	u_int		pe_handles;	/* leased, idle and being created */
+	struct pool_handle *pe_idle;	/* most recently used first */
+};
+
+static struct pool_ep *pool_eps[POOL_HASHSZ];
+static struct pool_handle *pool_leases[POOL_HASHSZ];
+static struct clnt_poolparams pool_params = {
+	POOL_MAXCONN, POOL_IDLE, POOL_CHECK, POOL_WAIT
+};
+static struct clnt_poolstats pool_stats;
+static time_t pool_swept;
+
+#ifdef _REENTRANT
+extern mutex_t pool_lock;
+static cond_t pool_cv = COND_INITIALIZER;
+#endif
+
+/* VARIABLES PROTECTED BY pool_lock: all of the above */
+
+static time_t pool_now(void);
+static u_int pool_hash(const char *, rpcprog_t, rpcvers_t, const char *);
+static struct pool_ep *pool_find(const char *, rpcprog_t, rpcvers_t,
+    const char *, int);
+static void pool_release_ep(struct pool_ep *);
+static void pool_sweep(time_t, struct pool_handle **);
+static void pool_destroy(struct pool_handle *);
+
+/*
+ * Monotonic seconds, for idle ages.
+ */
+static time_t
+pool_now(void)
+{
+	struct timeval now;
+
+	__rpc_coarse_clock(&now);
+	return (now.tv_sec);
+}
+
+static u_int
+pool_hash(const char *host, rpcprog_t prog, rpcvers_t vers,
+    const char *nettype)
+{
+	u_int hash = 2166136261U;	/* FNV-1a */
+
+	while (*host)
+		hash = (hash ^ (u_char)*host++) * 16777619U;
+	while (*nettype)
+		hash = (hash ^ (u_char)*nettype++) * 16777619U;
+	hash = (hash ^ (u_int)prog) * 16777619U;
+	hash = (hash ^ (u_int)vers) * 16777619U;
+	return (hash);
+}
+
+static struct pool_ep *
+pool_find(const char *host, rpcprog_t prog, rpcvers_t vers,
+    const char *nettype, int create)
+{
+	u_int hash = pool_hash(host, prog, vers, nettype);
+	struct pool_ep *ep, **bucket = &pool_eps[hash & (POOL_HASHSZ - 1)];
+
+	for (ep = *bucket; ep; ep = ep->pe_next)
+		if (ep->pe_hash == hash && ep->pe_prog == prog &&
+		    ep->pe_vers == vers && strcmp(ep->pe_host, host) == 0 &&
+		    strcmp(ep->pe_nettype, nettype) == 0)
+			return (ep);
+	if (! create)
+		return (NULL);
+	if ((ep = calloc(1, sizeof (*ep))) == NULL ||
+	    (ep->pe_host = strdup(host)) == NULL ||
+	    (ep->pe_nettype = strdup(nettype)) == NULL) {
+		if (ep) {
+			free(ep->pe_host);
+			free(ep);
+		}
+		return (NULL);
+	}
+	ep->pe_hash = hash;
+	ep->pe_prog = prog;
+	ep->pe_vers = vers;
+	ep->pe_next = *bucket;
+	*bucket = ep;
+	pool_stats.cp_endpoints++;
+	return (ep);
+}
+
+/*
+ * Free the endpoint once it holds no handles.
+ */
+static void
+pool_release_ep(struct pool_ep *ep)
+{
+	struct pool_ep **epp;
+
+	if (ep->pe_handles != 0)
+		return;
+	for (epp = &pool_eps[ep->pe_hash & (POOL_HASHSZ - 1)]; *epp != ep;
+	    epp = &(*epp)->pe_next)
+		continue;
+	*epp = ep->pe_next;
+	pool_stats.cp_endpoints--;
+	free(ep->pe_host);
+	free(ep->pe_nettype);
+	free(ep);
+}
+
+/*
+ * Detach handles idle for longer than the limit, returning them on
+ * *expired for destruction outside the lock; at most once a second.
+ */
+static void
+pool_sweep(time_t now, struct pool_handle **expired)
+{
+	struct pool_handle **php, *ph;
+	struct pool_ep *ep, *next;
+	u_int i;
+
+	if (now == pool_swept)
+		return;
+	pool_swept = now;
+	for (i = 0; i < POOL_HASHSZ; ++i) {
+		for (ep = pool_eps[i]; ep; ep = next) {
+			next = ep->pe_next;
+			for (php = &ep->pe_idle; (ph = *php) != NULL;) {
+				if (now - ph->ph_used < (time_t)pool_params.cp_idle) {
+					php = &ph->ph_next;
+					continue;
+				}
+				*php = ph->ph_next;
+				ph->ph_next = *expired;
+				*expired = ph;
+				ep->pe_handles--;
+				pool_stats.cp_idle--;
+				pool_stats.cp_evictions++;
+			}
+			pool_release_ep(ep);
+		}
+	}
+}
+
+static void
+pool_destroy(struct pool_handle *ph)
+{
+	struct pool_handle *next;
+
+	for (; ph; ph = next) {
+		next = ph->ph_next;
+		clnt_destroy(ph->ph_clnt);
+		free(ph);
+	}
+}
+
+/*
+ * Lease a handle for (host, prog, vers, nettype).
+ */
+LIBRPC_API CLIENT *
+clnt_pool_get(
+	const char *	hostname,		/* server name */
+	const rpcprog_t	prog,			/* program number */
+	const rpcvers_t	vers,			/* version number */
+	const char *	nettype)		/* net type */
+{
+	struct pool_handle *ph, *expired = NULL;
+	struct pool_ep *ep;
+	struct timespec abstime;
+	time_t now, deadline;
+	CLIENT *clnt;
+
+	_DIAGASSERT(hostname != NULL);
+	if (nettype == NULL)
+		nettype = "netpath";
+
+	mutex_lock(&pool_lock);
+	now = pool_now();
+#ifdef _REENTRANT
+	deadline = now + pool_params.cp_wait;
+#else
+	deadline = now;			/* nobody to wait for */
+#endif
+	pool_sweep(now, &expired);
+	pool_stats.cp_leases++;
+	for (;;) {
+		if ((ep = pool_find(hostname, prog, vers, nettype, 1)) == NULL) {
+			mutex_unlock(&pool_lock);
+			pool_destroy(expired);
+			rpc_createerr.cf_stat = RPC_SYSTEMERROR;
+			rpc_createerr.cf_error.re_errno = ENOMEM;
+			return (NULL);
+		}
+
+		if ((ph = ep->pe_idle) != NULL) {
+			/* warm handle; check it if idle a while */
+			ep->pe_idle = ph->ph_next;
+			pool_stats.cp_idle--;
+			if (now - ph->ph_used >= (time_t)pool_params.cp_check) {
+				pool_stats.cp_checks++;
+				mutex_unlock(&pool_lock);
+				clnt = (CLIENT *)rpc_nullproc(ph->ph_clnt);
+				mutex_lock(&pool_lock);
+				if (clnt == NULL) {
+					pool_stats.cp_checkfails++;
+					ep->pe_handles--;
+					cond_broadcast(&pool_cv);
+					ph->ph_next = expired;
+					expired = ph;
+					now = pool_now();
+					continue;	/* ep may have gone */
+				}
+			}
+			pool_stats.cp_reuses++;
+			break;
+		}
+
+		if (ep->pe_handles < pool_params.cp_maxconn) {
+			/* reserve a slot and create outside the lock */
+			ep->pe_handles++;
+			mutex_unlock(&pool_lock);
+			pool_destroy(expired);
+			expired = NULL;
+			clnt = clnt_create(hostname, prog, vers, nettype);
+			ph = NULL;
+			if (clnt != NULL && (ph = malloc(sizeof (*ph))) == NULL) {
+				clnt_destroy(clnt);
+				rpc_createerr.cf_stat = RPC_SYSTEMERROR;
+				rpc_createerr.cf_error.re_errno = ENOMEM;
+			}
+			mutex_lock(&pool_lock);
+			if (ph == NULL) {
+				pool_stats.cp_createfails++;
+				ep->pe_handles--;
+				pool_release_ep(ep);
+				cond_signal(&pool_cv);
+				mutex_unlock(&pool_lock);
+				return (NULL);
+			}
+			pool_stats.cp_creates++;
+			ph->ph_clnt = clnt;
+			break;
+		}
+
+		/* at the cap; wait for a release */
+		now = pool_now();
+		if (now >= deadline) {
+			pool_stats.cp_timeouts++;
+			mutex_unlock(&pool_lock);
+			pool_destroy(expired);
+			rpc_createerr.cf_stat = RPC_TIMEDOUT;
+			rpc_createerr.cf_error.re_errno = 0;
+			return (NULL);
+		}
+		pool_stats.cp_waits++;
+		(void) clock_gettime(CLOCK_REALTIME, &abstime);
+		abstime.tv_sec += deadline - now;
+		cond_timedwait(&pool_cv, &pool_lock, &abstime);
+		now = pool_now();
+	}
+
+	ph->ph_ep = ep;
+	ph->ph_next = pool_leases[((uintptr_t)ph->ph_clnt >> 4) & (POOL_HASHSZ - 1)];
+	pool_leases[((uintptr_t)ph->ph_clnt >> 4) & (POOL_HASHSZ - 1)] = ph;
+	pool_stats.cp_leased++;
+	mutex_unlock(&pool_lock);
+	pool_destroy(expired);
+	return (ph->ph_clnt);
+}
+
+/*
+ * Return a leased handle; it is destroyed if discard is set, as it
+ * should be after a transport failure.
+ */
+LIBRPC_API void
+clnt_pool_put(CLIENT *clnt, int discard)
+{
+	struct pool_handle **php, *ph, *expired = NULL;
+	struct pool_ep *ep;
+	time_t now;
+
+	if (clnt == NULL)
+		return;
+
+	mutex_lock(&pool_lock);
+	for (php = &pool_leases[((uintptr_t)clnt >> 4) & (POOL_HASHSZ - 1)];
+	    (ph = *php) != NULL; php = &ph->ph_next)
+		if (ph->ph_clnt == clnt)
+			break;
+	if (ph == NULL) {
+		/* not leased from the pool */
+		mutex_unlock(&pool_lock);
+		clnt_destroy(clnt);
+		return;
+	}
+	*php = ph->ph_next;
+	pool_stats.cp_leased--;
+	ep = ph->ph_ep;
+	now = pool_now();
+	if (discard || ep->pe_handles > pool_params.cp_maxconn) {
+		ep->pe_handles--;
+		pool_stats.cp_discards++;
+		ph->ph_next = expired;
+		expired = ph;
+		pool_release_ep(ep);
+	} else {
+		ph->ph_used = now;
+		ph->ph_next = ep->pe_idle;
+		ep->pe_idle = ph;
+		pool_stats.cp_idle++;
+	}
+	pool_sweep(now, &expired);
+	cond_broadcast(&pool_cv);
+	mutex_unlock(&pool_lock);
+	pool_destroy(expired);
+}
+
+/*
+ * rpc_control() operations: RPC_CLNT_POOL_STATS, RPC_CLNT_POOL_GETPARAMS,
+ * RPC_CLNT_POOL_SETPARAMS and RPC_CLNT_POOL_FLUSH (destroys idle handles).
+ */
+bool_t
+__clnt_pool_control(int what, void *arg)
+{
+	struct pool_handle *ph, *expired = NULL;
+	struct clnt_poolparams *params;
+	struct pool_ep *ep, *next;
+	u_int i;
+
+	mutex_lock(&pool_lock);
+	switch (what) {
+	case RPC_CLNT_POOL_STATS:
+		*(struct clnt_poolstats *)arg = pool_stats;
+		break;
+	case RPC_CLNT_POOL_GETPARAMS:
+		*(struct clnt_poolparams *)arg = pool_params;
+		break;
+	case RPC_CLNT_POOL_SETPARAMS:
+		params = (struct clnt_poolparams *)arg;
+		if (params->cp_maxconn == 0) {
+			mutex_unlock(&pool_lock);
+			return (FALSE);
+		}
+		pool_params = *params;
+		cond_broadcast(&pool_cv);
+		break;
+	case RPC_CLNT_POOL_FLUSH:
+		for (i = 0; i < POOL_HASHSZ; ++i) {
+			for (ep = pool_eps[i]; ep; ep = next) {
+				next = ep->pe_next;
+				while ((ph = ep->pe_idle) != NULL) {
+					ep->pe_idle = ph->ph_next;
+					ph->ph_next = expired;
+					expired = ph;
+					ep->pe_handles--;
+					pool_stats.cp_idle--;
+				}
+				pool_release_ep(ep);
+			}
+		}
+		break;
+	default:
+		mutex_unlock(&pool_lock);
+		return (FALSE);
+	}
+	mutex_unlock(&pool_lock);
+	pool_destroy(expired);
+	return (TRUE);
+}
+
+/*end*/
@@ -88,6 +88,7 @@ __weak_alias(clnt_vc_create,_clnt_vc_create)
 #endif
 
 #define MCALL_MSG_SIZE 24
+#define MCALL_TMPL_SIZE (MCALL_MSG_SIZE + BYTES_PER_XDR_UNIT + MAX_AUTH_BYTES)
 
 static enum clnt_stat clnt_vc_call(CLIENT *, rpcproc_t, xdrproc_t,
     const char *, xdrproc_t, caddr_t, struct timeval);
@@ -106,16 +107,23 @@ struct ct_data {
 	bool_t		ct_closeit;
 	struct timeval	ct_wait;
 	bool_t          ct_waitset;       /* wait set by clnt_control? */
+	struct timeval	ct_deadline;		/* reply due, see read_vc() */
 	struct netbuf	ct_addr; 
 	struct rpc_err	ct_error;
 	union {
-		char	ct_mcallc[MCALL_MSG_SIZE];	/* marshalled callmsg */
+		char	ct_mcallc[MCALL_TMPL_SIZE];	/* marshalled callmsg */
 		u_int32_t ct_mcalli;
 	} ct_u;
 	u_int		ct_mpos;			/* pos after marshal */
+	AUTH		*ct_tauth;			/* auth of the template */
+	u_int		ct_tgen;			/* ... and its generation */
+	u_int		ct_tpos;			/* pos after template, or 0 */
+	u_int		ct_sendsz;			/* xdrrec send buffer */
 	XDR		ct_xdrs;
 };
 
+static bool_t marshal_call(struct ct_data *, AUTH *, rpcproc_t, XDR *);
+
 /*
  *      This machinery implements per-fd locks for MT-safety.  It is not
  *      sufficient to do per-CLIENT handle locks for MT-safety because a
@@ -318,6 +326,8 @@ clnt_vc_create(
 		goto fooy;
 	}
 	ct->ct_mpos = XDR_GETPOS(&(ct->ct_xdrs));
+	ct->ct_tauth = NULL;
+	ct->ct_tpos = 0;
 	XDR_DESTROY(&(ct->ct_xdrs));
 
 	/*
@@ -329,6 +339,7 @@ clnt_vc_create(
 	h->cl_auth = authnone_create();
 	sendsz = __rpc_get_t_size(si.si_af, si.si_proto, (int)sendsz);
 	recvsz = __rpc_get_t_size(si.si_af, si.si_proto, (int)recvsz);
+	ct->ct_sendsz = sendsz;
 	xdrrec_create(&(ct->ct_xdrs), sendsz, recvsz,
 	    h->cl_private, read_vc, write_vc);
 	return (h);
@@ -400,9 +411,7 @@ call_again:
 	xdrs->x_op = XDR_ENCODE;
 	ct->ct_error.re_status = RPC_SUCCESS;
 	x_id = ntohl(--(*msg_x_id));
-	if ((! XDR_PUTBYTES(xdrs, ct->ct_u.ct_mcallc, ct->ct_mpos)) ||
-	    (! XDR_PUTINT32(xdrs, (int32_t *)&proc)) ||
-	    (! AUTH_MARSHALL(h->cl_auth, xdrs)) ||
+	if ((! marshal_call(ct, h->cl_auth, proc, xdrs)) ||
 	    (! (*xdr_args)(xdrs, __UNCONST(args_ptr)))) {
 		if (ct->ct_error.re_status == RPC_SUCCESS)
 			ct->ct_error.re_status = RPC_CANTENCODEARGS;
@@ -426,6 +435,10 @@ call_again:
 		return(ct->ct_error.re_status = RPC_TIMEDOUT);
 	}
 
+	/*
+	 * The whole reply is due within ct_wait, however it is fragmented.
+	 */
+	__rpc_deadline(&ct->ct_deadline, &ct->ct_wait);
 
 	/*
 	 * Keep receiving until we get a valid transaction id
@@ -479,6 +492,219 @@ call_again:
 	return (ct->ct_error.re_status);
 }
 
+/*
+ * Marshal the call header, procedure and credentials.  Where the
+ * credentials are call invariant (AUTH_NONE, AUTH_UNIX) they are kept
+ * after the pre-serialized header, so the call costs a procedure patch
+ * and a single copy; the template is rebuilt when the auth changes.
+ */
+static bool_t
+marshal_call(struct ct_data *ct, AUTH *auth, rpcproc_t proc, XDR *xdrs)
+{
+	const char *image;
+	u_int len, gen;
+
+	if (! __AUTH_IMAGE(auth, &image, &len, &gen) ||
+	    ct->ct_mpos + BYTES_PER_XDR_UNIT + len > MCALL_TMPL_SIZE) {
+		ct->ct_tpos = 0;
+		return (XDR_PUTBYTES(xdrs, ct->ct_u.ct_mcallc, ct->ct_mpos) &&
+		    XDR_PUTINT32(xdrs, (int32_t *)&proc) &&
+		    AUTH_MARSHALL(auth, xdrs));
+	}
+	if (ct->ct_tpos == 0 || ct->ct_tauth != auth || ct->ct_tgen != gen) {
+		(void) memcpy(ct->ct_u.ct_mcallc + ct->ct_mpos +
+		    BYTES_PER_XDR_UNIT, image, (size_t)len);
+		ct->ct_tauth = auth;
+		ct->ct_tgen = gen;
+		ct->ct_tpos = ct->ct_mpos + BYTES_PER_XDR_UNIT + len;
+	}
+	*(u_int32_t *)(void *)(ct->ct_u.ct_mcallc + ct->ct_mpos) =
+	    htonl((u_int32_t)proc);
+	return (XDR_PUTBYTES(xdrs, ct->ct_u.ct_mcallc, ct->ct_tpos));
+}
+
+/*
+ * Pipelined calls, see clnt_async.c.
+ */
+bool_t
+__clnt_vc_pipelined(CLIENT *h)
+{
+
+	_DIAGASSERT(h != NULL);
+
+	return (h->cl_ops->cl_call == clnt_vc_call);
+}
+
+/*
+ * Size of the send buffer of a pipelined handle.
+ */
+u_int
+__clnt_vc_sendsz(CLIENT *h)
+{
+
+	_DIAGASSERT(h != NULL);
+
+	return (((struct ct_data *) h->cl_private)->ct_sendsz);
+}
+
+/*
+ * Queue a call without waiting for its reply, returning its xid; the
+ * call is written out once the buffer fills, or by __clnt_vc_recv().
+ */
+enum clnt_stat
+__clnt_vc_send(
+	CLIENT *h,
+	rpcproc_t proc,
+	xdrproc_t xdr_args,
+	const char *args_ptr,
+	u_int32_t *xidp
+)
+{
+	struct ct_data *ct;
+	XDR *xdrs;
+	u_int32_t *msg_x_id;
+#ifdef _REENTRANT
+	WIN32_DISABLE(sigset_t mask;)
+	WIN32_DISABLE(sigset_t newmask;)
+#endif
+
+	_DIAGASSERT(h != NULL);
+	_DIAGASSERT(xidp != NULL);
+
+	ct = (struct ct_data *) h->cl_private;
+
+#ifdef _REENTRANT
+	WIN32_DISABLE(__clnt_sigfillset(&newmask);)
+	thr_sigsetmask(SIG_SETMASK, &newmask, &mask);
+	mutex_lock(&clnt_fd_lock);
+	while (vc_fd_locks[ct->ct_fd])
+		cond_wait(&vc_cv[ct->ct_fd], &clnt_fd_lock);
+	vc_fd_locks[ct->ct_fd] = __rpc_lock_value;
+	mutex_unlock(&clnt_fd_lock);
+#endif
+
+	xdrs = &(ct->ct_xdrs);
+	msg_x_id = &ct->ct_u.ct_mcalli;
+
+	xdrs->x_op = XDR_ENCODE;
+	ct->ct_error.re_status = RPC_SUCCESS;
+	*xidp = ntohl(--(*msg_x_id));
+	if ((! marshal_call(ct, h->cl_auth, proc, xdrs)) ||
+	    (! (*xdr_args)(xdrs, __UNCONST(args_ptr)))) {
+		if (ct->ct_error.re_status == RPC_SUCCESS)
+			ct->ct_error.re_status = RPC_CANTENCODEARGS;
+		(void)xdrrec_endofrecord(xdrs, TRUE);
+		release_fd_lock(ct->ct_fd, mask);
+		return (ct->ct_error.re_status);
+	}
+	if (! xdrrec_endofrecord(xdrs, FALSE)) {
+		release_fd_lock(ct->ct_fd, mask);
+		return (ct->ct_error.re_status = RPC_CANTSEND);
+	}
+	release_fd_lock(ct->ct_fd, mask);
+	return (RPC_SUCCESS);
+}
+
+/*
+ * Write out queued calls, then receive the next reply due by deadline.
+ * Replies lookup() does not know are skipped; otherwise the results are
+ * decoded where it directs, and the call's xid and status returned.
+ * The return is the transport status.
+ */
+enum clnt_stat
+__clnt_vc_recv(
+	CLIENT *h,
+	const struct timeval *deadline,
+	bool_t (*lookup)(void *, u_int32_t, xdrproc_t *, caddr_t *),
+	void *ctx,
+	u_int32_t *xidp,
+	enum clnt_stat *statp
+)
+{
+	struct ct_data *ct;
+	XDR *xdrs;
+	struct rpc_msg reply_msg;
+	struct rpc_err error;
+	enum clnt_stat stat;
+	xdrproc_t xdr_results;
+	caddr_t results_ptr;
+#ifdef _REENTRANT
+	WIN32_DISABLE(sigset_t mask;)
+	WIN32_DISABLE(sigset_t newmask;)
+#endif
+
+	_DIAGASSERT(h != NULL);
+	_DIAGASSERT(deadline != NULL);
+
+	ct = (struct ct_data *) h->cl_private;
+
+#ifdef _REENTRANT
+	WIN32_DISABLE(__clnt_sigfillset(&newmask);)
+	thr_sigsetmask(SIG_SETMASK, &newmask, &mask);
+	mutex_lock(&clnt_fd_lock);
+	while (vc_fd_locks[ct->ct_fd])
+		cond_wait(&vc_cv[ct->ct_fd], &clnt_fd_lock);
+	vc_fd_locks[ct->ct_fd] = __rpc_lock_value;
+	mutex_unlock(&clnt_fd_lock);
+#endif
+
+	xdrs = &(ct->ct_xdrs);
+	ct->ct_error.re_status = RPC_SUCCESS;
+	if (! __xdrrec_flush(xdrs)) {
+		release_fd_lock(ct->ct_fd, mask);
+		return (ct->ct_error.re_status = RPC_CANTSEND);
+	}
+
+	ct->ct_deadline = *deadline;
+	xdrs->x_op = XDR_DECODE;
+	for (;;) {
+		reply_msg.acpted_rply.ar_verf = _null_auth;
+		reply_msg.acpted_rply.ar_results.where = NULL;
+		reply_msg.acpted_rply.ar_results.proc = (xdrproc_t)xdr_void;
+		if (! xdrrec_skiprecord(xdrs)) {
+			release_fd_lock(ct->ct_fd, mask);
+			return (ct->ct_error.re_status);
+		}
+		if (! xdr_replymsg(xdrs, &reply_msg)) {
+			if (ct->ct_error.re_status == RPC_SUCCESS)
+				continue;
+			release_fd_lock(ct->ct_fd, mask);
+			return (ct->ct_error.re_status);
+		}
+		if ((*lookup)(ctx, reply_msg.rm_xid, &xdr_results,
+		    &results_ptr))
+			break;
+	}
+
+	/*
+	 * process header; credentials are not refreshed, as the call is
+	 * no longer to hand
+	 */
+	_seterr_reply(&reply_msg, &error);
+	if (error.re_status == RPC_SUCCESS) {
+		if (! AUTH_VALIDATE(h->cl_auth,
+		    &reply_msg.acpted_rply.ar_verf)) {
+			error.re_status = RPC_AUTHERROR;
+			error.re_why = AUTH_INVALIDRESP;
+		} else if (! (*xdr_results)(xdrs, results_ptr)) {
+			error.re_status = RPC_CANTDECODERES;
+		}
+		/* free verifier ... */
+		if (reply_msg.acpted_rply.ar_verf.oa_base != NULL) {
+			xdrs->x_op = XDR_FREE;
+			(void)xdr_opaque_auth(xdrs,
+			    &(reply_msg.acpted_rply.ar_verf));
+		}
+	}
+	stat = ct->ct_error.re_status;	/* transport */
+	if (stat == RPC_SUCCESS)
+		ct->ct_error = error;	/* this reply's, for clnt_geterr() */
+	*xidp = reply_msg.rm_xid;
+	*statp = error.re_status;
+	release_fd_lock(ct->ct_fd, mask);
+	return (stat);
+}
+
 static void
 clnt_vc_geterr(
 	CLIENT *h,
@@ -672,6 +898,8 @@ clnt_vc_destroy(CLIENT *cl)
 
 	ct = (struct ct_data *) cl->cl_private;
 
+	__clnt_async_destroy(cl);
+
 	WIN32_DISABLE(__clnt_sigfillset(&newmask);)
 	thr_sigsetmask(SIG_SETMASK, &newmask, &mask);
 	mutex_lock(&clnt_fd_lock);
@@ -710,10 +938,13 @@ read_vc(char *ctp, char *buf, int len)
 	if (len == 0)
 		return (0);
 
-	TIMEVAL_TO_TIMESPEC(&ct->ct_wait, &ts);
 	fd.fd = ct->ct_fd;
 	fd.events = POLLIN;
 	for (;;) {
+		if (! __rpc_deadline_left(&ct->ct_deadline, &ts)) {
+			ct->ct_error.re_status = RPC_TIMEDOUT;
+			return (-1);
+		}
 		switch (pollts(&fd, 1, &ts, NULL)) {
 		case 0:
 			ct->ct_error.re_status = RPC_TIMEDOUT;
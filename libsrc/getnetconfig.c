@@ -46,6 +46,8 @@ __RCSID("$NetBSD: getnetconfig.c,v 1.25 2017/06/30 10:03:34 christos Exp $");
 
 #include "namespace.h"
 #include "reentrant.h"
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <stdio.h>
 #include <assert.h>
 #include <errno.h>
@@ -53,6 +55,7 @@ __RCSID("$NetBSD: getnetconfig.c,v 1.25 2017/06/30 10:03:34 christos Exp $");
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <rpc/rpc.h>
 #include "rpc_internal.h"
@@ -112,34 +115,46 @@ static const char * const _nc_errors[] = {
 	"Netconfig database has invalid format"
 };
 
-struct netconfig_info {
-	int		eof;	/* all entries has been read */
-	int		ref;	/* # of times setnetconfig() has been called */
-	struct netconfig_list	*head;	/* head of the list */
-	struct netconfig_list	*tail;	/* last of the list */
-};
-
-struct netconfig_list {
-	char			*linep;	/* hold line read from netconfig */
-	struct netconfig	*ncp;
-	struct netconfig_list	*next;
+/*
+ * The database is parsed once into an immutable, reference counted table;
+ * sessions, and entries returned by getnetconfigent(), each hold a
+ * reference.  At most every NC_RECHECK seconds the modification time of
+ * NETCONFIG is compared and, when changed, a new table is loaded.  Tables
+ * retired by a reload remain valid until their last reference is dropped.
+ */
+struct netconfig_db {
+	struct netconfig_db *next;	/* live tables */
+	int		refs;		/* sessions, entries and current */
+	time_t		mtime;		/* NETCONFIG modification time */
+	time_t		checked;	/* last mtime comparison */
+	u_int		count;		/* entries */
+	u_int		hashsz;		/* netid hash slots, power of 2 */
+	u_int		*hash;		/* entry index + 1, 0 = empty */
+	char		**lines;	/* parsed text, one per entry */
+	struct netconfig *entries;
 };
 
 struct netconfig_vars {
 	    int   valid;	/* token that indicates valid netconfig_vars */
-	    int   flag;		/* first time flag */
-	    struct netconfig_list *nc_configs;
-	   			 /* pointer to the current netconfig entry */
+	    struct netconfig_db *db;
+	   			 /* table referenced by this session */
+	    u_int index;	/* next entry */
 };
 
 #define NC_VALID	0xfeed
 #define NC_STORAGE	0xf00d
 #define NC_INVALID	0
 
+#define NC_RECHECK	2	/* seconds between mtime checks */
+
 
 static int *__nc_error(void);
 static int parse_ncp(char *, struct netconfig *);
-static struct netconfig *dup_ncp(struct netconfig *);
+static u_int nc_hash(const char *);
+static struct netconfig_db *nc_load(time_t);
+static void nc_free(struct netconfig_db *);
+static struct netconfig_db *nc_acquire(void);
+static void nc_release(struct netconfig_db *);
 
 #if defined(_WIN32)
 static const char *netconfig[] = {
@@ -206,13 +221,18 @@ ncclose(NCFILE *stream)
 	}
 }
 
-static NCFILE *nc_file;		/* for netconfig db */
-
 #else
-static FILE *nc_file;		/* for netconfig db */
+#define NCFILE		FILE
+#define ncopen(p, m)	fopen(p, "re")
+#define ncgets(s, n, f)	fgets(s, n, f)
+#define ncclose(f)	fclose(f)
 #endif
 
-static struct netconfig_info	ni = { 0, 0, NULL, NULL};
+#ifdef _REENTRANT
+extern mutex_t nc_db_lock;
+#endif
+static struct netconfig_db *nc_current;	/* most recent table */
+static struct netconfig_db *nc_dbs;	/* all live tables */
 
 #define MAXNETCONFIGLINE    1000
 
@@ -259,6 +279,167 @@ __nc_error(void)
 }
 
 #define nc_error        (*(__nc_error()))
+
+static u_int
+nc_hash(const char *netid)
+{
+	u_int hash = 2166136261U;	/* FNV-1a */
+
+	while (*netid)
+		hash = (hash ^ (unsigned char)*netid++) * 16777619U;
+	return hash;
+}
+
+/*
+ * Read and parse the netconfig database into a new table; parsing stops
+ * at the first malformed entry, as getnetconfig() always has.
+ */
+static struct netconfig_db *
+nc_load(time_t mtime)
+{
+	struct netconfig_db *db;
+	char linep[MAXNETCONFIGLINE];
+	u_int size = 0, i, slot;
+	NCFILE *file;
+
+	if ((file = ncopen(NETCONFIG, "r")) == NULL) {
+		nc_error = NC_NONETCONFIG;
+		return NULL;
+	}
+	if ((db = calloc(1, sizeof(*db))) == NULL) {
+		ncclose(file);
+		nc_error = NC_NOMEM;
+		return NULL;
+	}
+	db->mtime = mtime;
+
+	while (ncgets(linep, sizeof(linep), file) != NULL) {
+		struct netconfig *ncp;
+
+		if (*linep == '#')
+			continue;
+		if (db->count == size) {
+			u_int nsize = size ? size * 2 : 8;
+			void *lines, *entries;
+
+			lines = realloc(db->lines, nsize * sizeof(*db->lines));
+			if (lines != NULL)
+				db->lines = lines;
+			entries = realloc(db->entries, nsize * sizeof(*db->entries));
+			if (entries != NULL)
+				db->entries = entries;
+			if (lines == NULL || entries == NULL)
+				goto nomem;
+			size = nsize;
+		}
+		if ((db->lines[db->count] = strdup(linep)) == NULL)
+			goto nomem;
+		ncp = db->entries + db->count;
+		ncp->nc_lookups = NULL;
+		if (parse_ncp(db->lines[db->count], ncp) == -1) {
+			free(db->lines[db->count]);
+			break;
+		}
+		db->count++;
+	}
+	ncclose(file);
+
+	for (db->hashsz = 8; db->hashsz < db->count * 2; db->hashsz <<= 1)
+		continue;
+	if ((db->hash = calloc(db->hashsz, sizeof(*db->hash))) == NULL) {
+		nc_free(db);
+		nc_error = NC_NOMEM;
+		return NULL;
+	}
+	for (i = 0; i < db->count; ++i) {
+		slot = nc_hash(db->entries[i].nc_netid);
+		while (db->hash[slot & (db->hashsz - 1)] != 0)
+			++slot;
+		db->hash[slot & (db->hashsz - 1)] = i + 1;
+	}
+	return db;
+
+nomem:
+	ncclose(file);
+	nc_free(db);
+	nc_error = NC_NOMEM;
+	return NULL;
+}
+
+static void
+nc_free(struct netconfig_db *db)
+{
+	u_int i;
+
+	for (i = 0; i < db->count; ++i) {
+		if (db->entries[i].nc_lookups != NULL)
+			free(db->entries[i].nc_lookups);
+		free(db->lines[i]);
+	}
+	free(db->hash);
+	free(db->lines);
+	free(db->entries);
+	free(db);
+}
+
+/*
+ * Reference the current table, (re)loading when NETCONFIG has changed.
+ * If a reload fails the previous table is retained.
+ */
+static struct netconfig_db *
+nc_acquire(void)
+{
+	const time_t now = time(NULL);
+	struct netconfig_db *db;
+	struct stat sb;
+	time_t mtime;
+
+	mutex_lock(&nc_db_lock);
+	if ((db = nc_current) == NULL || (now - db->checked) >= NC_RECHECK) {
+		mtime = (stat(NETCONFIG, &sb) == 0 ? sb.st_mtime : 0);
+		if (db == NULL || db->mtime != mtime) {
+			struct netconfig_db *ndb;
+
+			if ((ndb = nc_load(mtime)) != NULL) {
+				if (db != NULL && --db->refs == 0) {
+					/* not referenced; cannot be nc_dbs head */
+					struct netconfig_db **dbp;
+
+					for (dbp = &nc_dbs; *dbp != db; dbp = &(*dbp)->next)
+						continue;
+					*dbp = db->next;
+					nc_free(db);
+				}
+				ndb->refs = 1;		/* current */
+				ndb->next = nc_dbs;
+				nc_dbs = ndb;
+				nc_current = db = ndb;
+			}
+		}
+		if (db != NULL)
+			db->checked = now;
+	}
+	if (db != NULL)
+		db->refs++;
+	mutex_unlock(&nc_db_lock);
+	return db;
+}
+
+static void
+nc_release(struct netconfig_db *db)
+{
+	struct netconfig_db **dbp;
+
+	mutex_lock(&nc_db_lock);
+	if (--db->refs == 0) {
+		for (dbp = &nc_dbs; *dbp != db; dbp = &(*dbp)->next)
+			continue;
+		*dbp = db->next;
+		nc_free(db);
+	}
+	mutex_unlock(&nc_db_lock);
+}
+
 /*
  * A call to setnetconfig() establishes a /etc/netconfig "session".  A session
  * "handle" is returned on a successful call.  At the start of a session (after
@@ -288,22 +469,14 @@ setnetconfig(void)
 	}
 
 	/*
-	 * For multiple calls, i.e. nc_file is not NULL, we just return the
-	 * handle without reopening the netconfig db.
+	 * Each session references the shared table; the database is only
+	 * read when first needed or after it has been modified.
 	 */
-	ni.ref++;
-#if defined(_WIN32)
-	if ((nc_file != NULL) || (nc_file = ncopen(NETCONFIG, "r")) != NULL) {
-#else
-	if ((nc_file != NULL) || (nc_file = fopen(NETCONFIG, "re")) != NULL) {
-#endif
+	if ((nc_vars->db = nc_acquire()) != NULL) {
 		nc_vars->valid = NC_VALID;
-		nc_vars->flag = 0;
-		nc_vars->nc_configs = ni.head;
+		nc_vars->index = 0;
 		return nc_vars;
 	}
-	ni.ref--;
-	nc_error = NC_NONETCONFIG;
 	free(nc_vars);
 	return NULL;
 }
@@ -321,115 +494,17 @@ LIBRPC_API struct netconfig *
 getnetconfig(void *handlep)
 {
 	struct netconfig_vars *ncp = handlep;
-	char *stringp;		/* tmp string pointer */
-	struct netconfig_list	*list;
-	struct netconfig *np;
 
 	/*
 	 * Verify that handle is valid
 	 */
-	if (ncp == NULL || nc_file == NULL) {
+	if (ncp == NULL || ncp->valid != NC_VALID) {
 		nc_error = NC_NOTINIT;
 		return NULL;
 	}
-
-	switch (ncp->valid) {
-	case NC_VALID:
-		/*
-		 * If entry has already been read into the list,
-		 * we return the entry in the linked list.
-		 * If this is the first time call, check if there are any
-		 * entries in linked list.  If no entries, we need to read the
-		 * netconfig db.
-		 * If we have been here and the next entry is there, we just
-		 * return it.
-		 */
-		if (ncp->flag == 0) {	/* first time */
-			ncp->flag = 1;
-			ncp->nc_configs = ni.head;
-			if (ncp->nc_configs != NULL) /* entry already exist */
-				return ncp->nc_configs->ncp;
-		}
-		else if (ncp->nc_configs != NULL &&
-		    ncp->nc_configs->next != NULL) {
-			ncp->nc_configs = ncp->nc_configs->next;
-			return ncp->nc_configs->ncp;
-		}
-
-		/*
-		 * If we cannot find the entry in the list and is end of file,
-		 * we give up.
-		 */
-		if (ni.eof == 1)
-			return NULL;
-		break;
-	default:
-		nc_error = NC_NOTINIT;
-		return NULL;
-	}
-
-	stringp = malloc(MAXNETCONFIGLINE);
-	if (stringp == NULL)
-		return NULL;
-
-#ifdef MEM_CHK
-	if (malloc_verify() == 0) {
-		fprintf(stderr, "memory heap corrupted in getnetconfig\n");
-		exit(1);
-	}
-#endif
-
-	/*
-	 * Read a line from netconfig file.
-	 */
-	do {
-#if defined(_WIN32)
-		if (ncgets(stringp, MAXNETCONFIGLINE, nc_file) == NULL) {
-#else
-		if (ncgets(stringp, MAXNETCONFIGLINE, nc_file) == NULL) {
-#endif
-			free(stringp);
-			ni.eof = 1;
-			return NULL;
-		}
-	} while (*stringp == '#');
-
-	list = malloc(sizeof(*list));
-	if (list == NULL) {
-		free(stringp);
-		return NULL;
-	}
-	np = malloc(sizeof(*np));
-	if (np == NULL) {
-		free(stringp);
-		free(list);
+	if (ncp->index >= ncp->db->count)
 		return NULL;
-	}
-	list->ncp = np;
-	list->next = NULL;
-	list->ncp->nc_lookups = NULL;
-	list->linep = stringp;
-	if (parse_ncp(stringp, list->ncp) == -1) {
-		free(stringp);
-		free(np);
-		free(list);
-		return NULL;
-	} else {
-		/*
-		 * If this is the first entry that's been read, it is the
-		 * head of the list.  If not, put the entry at the end of
-		 * the list.  Reposition the current pointer of the handle to
-		 * the last entry in the list.
-		 */
-		if (ni.head == NULL)		/* first entry */
-			ni.head = ni.tail = list;
-		else {
-			ni.tail->next = list;
-			ni.tail = ni.tail->next;
-		}
-		ncp->nc_configs = ni.tail;
-		return ni.tail->ncp;
-	}
+	return &ncp->db->entries[ncp->index++];
 }
 
 /*
@@ -444,8 +519,6 @@ endnetconfig(void *handlep)
 {
 	struct netconfig_vars *nc_handlep = handlep;
 
-	struct netconfig_list *q, *p;
-
 	/*
 	 * Verify that handle is valid
 	 */
@@ -455,42 +528,9 @@ endnetconfig(void *handlep)
 		return -1;
 	}
 
-	/*
-	 * Return 0 if anyone still needs it.
-	 */
 	nc_handlep->valid = NC_INVALID;
-	nc_handlep->flag = 0;
-	nc_handlep->nc_configs = NULL;
-	if (--ni.ref > 0) {
-		free(nc_handlep);
-		return 0;
-	}
-
-	/*
-	 * Noone needs these entries anymore, then frees them.
-	 * Make sure all info in netconfig_info structure has been
-	 * reinitialized.
-	 */
-	q = p = ni.head;
-	ni.eof = ni.ref = 0;
-	ni.head = NULL;
-	ni.tail = NULL;
-	while (q) {
-		p = q->next;
-		if (q->ncp->nc_lookups != NULL) free(q->ncp->nc_lookups);
-		free(q->ncp);
-		free(q->linep);
-		free(q);
-		q = p;
-	}
+	nc_release(nc_handlep->db);
 	free(nc_handlep);
-
-#if defined(_WIN32)
-	ncclose(nc_file);
-#else
-	fclose(nc_file);
-#endif
-	nc_file = NULL;
 	return 0;
 }
 
@@ -500,99 +540,30 @@ endnetconfig(void *handlep)
  * not name an entry in the netconfig database).  It returns NULL and sets
  * errno in case of failure (for example, if the netconfig database cannot be
  * opened).
+ *
+ * The entry returned is shared and must be treated as read-only; it
+ * remains valid until released by freenetconfigent().
  */
 
 LIBRPC_API struct netconfig *
 getnetconfigent(const char *netid)
 {
-#if defined(_WIN32)
-	NCFILE *file;			/* NETCONFIG db's file pointer */
-#else
-	FILE *file;			/* NETCONFIG db's file pointer */
-#endif
-	char *linep;			/* holds current netconfig line */
-	char *stringp;			/* temporary string pointer */
-	struct netconfig *ncp = NULL;   /* returned value */
-	struct netconfig_list *list;	/* pointer to cache list */
+	struct netconfig_db *db;
+	u_int slot, idx;
 
 	if (netid == NULL || strlen(netid) == 0)
 		return NULL;
 
-	/*
-	 * Look up table if the entries have already been read and parsed in
-	 * getnetconfig(), then copy this entry into a buffer and return it.
-	 * If we cannot find the entry in the current list and there are more
-	 * entries in the netconfig db that has not been read, we then read the
-	 * db and try find the match netid.
-	 * If all the netconfig db has been read and placed into the list and
-	 * there is no match for the netid, return NULL.
-	 */
-	if (ni.head != NULL) {
-		for (list = ni.head; list; list = list->next) {
-			if (strcmp(list->ncp->nc_netid, netid) == 0)
-				return dup_ncp(list->ncp);
-		}
-		if (ni.eof == 1)	/* that's all the entries */
-			return NULL;
-	}
-
-#if defined(_WIN32)
-	if ((file = ncopen(NETCONFIG, "r")) == NULL)
-	    return NULL;
-#else
-	if ((file = fopen(NETCONFIG, "re")) == NULL)
-	    return NULL;
-#endif
-
-	if ((linep = malloc(MAXNETCONFIGLINE)) == NULL) {
-#if defined(_WIN32)
-		ncclose(file);
-#else
-		fclose(file);
-#endif
+	if ((db = nc_acquire()) == NULL)
 		return NULL;
-	}
-	do {
-		size_t len;
-		char *tmpp;	/* tmp string pointer */
-
-		do {
-#if defined(_WIN32)
-			if ((stringp = ncgets(linep, MAXNETCONFIGLINE, file)) == NULL)
-				break;
-#else
-			if ((stringp = fgets(linep, MAXNETCONFIGLINE, file)) == NULL)
-				break;
-#endif
-		} while (*stringp == '#');
-		if (stringp == NULL)	/* eof */
+	for (slot = nc_hash(netid);; ++slot) {
+		if ((idx = db->hash[slot & (db->hashsz - 1)]) == 0)
 			break;
-		if ((tmpp = strpbrk(stringp, "\t ")) == NULL) {
-					/* can't parse file */
-			nc_error = NC_BADFILE;
-			break;
-		}
-		if (strlen(netid) == (len = (size_t)(tmpp - stringp)) &&
-		    strncmp(stringp, netid, len) == 0) {
-		    /* a match */
-			if ((ncp = malloc(sizeof(*ncp))) == NULL)
-				break;
-			ncp->nc_lookups = NULL;
-			if (parse_ncp(linep, ncp) == -1) {
-				free(ncp);
-				ncp = NULL;
-			}
-			break;
-		}
-	} while (stringp != NULL);
-	if (ncp == NULL)
-		free(linep);
-#if defined(_WIN32)
-	ncclose(file);
-#else
-	fclose(file);
-#endif
-	return ncp;
+		if (strcmp(db->entries[idx - 1].nc_netid, netid) == 0)
+			return &db->entries[idx - 1];
+	}
+	nc_release(db);
+	return NULL;
 }
 
 /*
@@ -603,13 +574,28 @@ getnetconfigent(const char *netid)
 LIBRPC_API void
 freenetconfigent(struct netconfig *netconfigp)
 {
-	if (netconfigp != NULL) {
-				/* holds all netconfigp's strings */
-		free(netconfigp->nc_netid);
-		if (netconfigp->nc_lookups != NULL)
-			free(netconfigp->nc_lookups);
-		free(netconfigp);
+	struct netconfig_db *db;
+
+	if (netconfigp == NULL)
+		return;
+
+	mutex_lock(&nc_db_lock);
+	for (db = nc_dbs; db; db = db->next) {
+		if (netconfigp >= db->entries &&
+		    netconfigp < db->entries + db->count)
+			break;
 	}
+	mutex_unlock(&nc_db_lock);
+	if (db != NULL) {
+		nc_release(db);
+		return;
+	}
+
+				/* holds all netconfigp's strings */
+	free(netconfigp->nc_netid);
+	if (netconfigp->nc_lookups != NULL)
+		free(netconfigp->nc_lookups);
+	free(netconfigp);
 }
 
 /*
@@ -745,51 +731,3 @@ nc_perror(const char *s)
 
 	fprintf(stderr, "%s: %s", s, nc_sperror());
 }
-
-/*
- * Duplicates the matched netconfig buffer.
- */
-static struct netconfig *
-dup_ncp(struct netconfig *ncp)
-{
-	struct netconfig	*p;
-	char	*tmp;
-	u_int	i;
-
-	_DIAGASSERT(ncp != NULL);
-
-	if ((tmp = malloc(MAXNETCONFIGLINE)) == NULL)
-		return NULL;
-	if ((p = malloc(sizeof(*p))) == NULL) {
-		free(tmp);
-		return NULL;
-	}
-	/*
-	 * First we dup all the data from matched netconfig buffer.  Then we
-	 * adjust some of the member pointer to a pre-allocated buffer where
-	 * contains part of the data.
-	 * To follow the convention used in parse_ncp(), we store all the
-	 * necessary information in the pre-allocated buffer and let each
-	 * of the netconfig char pointer member point to the right address
-	 * in the buffer.
-	 */
-	*p = *ncp;
-	p->nc_netid = strcpy(tmp, ncp->nc_netid);
-	tmp = strchr(tmp, '\0') + 1;
-	p->nc_protofmly = strcpy(tmp, ncp->nc_protofmly);
-	tmp = strchr(tmp, '\0') + 1;
-	p->nc_proto = strcpy(tmp, ncp->nc_proto);
-	tmp = strchr(tmp, '\0') + 1;
-	p->nc_device = strcpy(tmp, ncp->nc_device);
-	p->nc_lookups = calloc((size_t)(p->nc_nlookups + 1), sizeof(char *));
-	if (p->nc_lookups == NULL) {
-		free(p->nc_netid);
-		free(p);
-		return NULL;
-	}
-	for (i = 0; i < p->nc_nlookups; i++) {
-		tmp = strchr(tmp, '\0') + 1;
-		p->nc_lookups[i] = strcpy(tmp, ncp->nc_lookups[i]);
-	}
-	return p;
-}
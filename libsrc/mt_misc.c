@@ -61,10 +61,25 @@ rwlock_t rpcbaddr_cache_lock = RWLOCK_INITIALIZER;
 mutex_t	authdes_lock = MUTEX_INITIALIZER;
 /* auth_none.c serialization */
 mutex_t	authnone_lock = MUTEX_INITIALIZER;
+/* broadcast interface and credential caches (clnt_bcast.c) */
+mutex_t	bcast_lock = MUTEX_INITIALIZER;
 /* protects the Auths list (svc_auth.c) */
 mutex_t	authsvc_lock = MUTEX_INITIALIZER;
+/* protect the AUTH_SHORT cache stripes (svc_auth_unix.c, SHORT_STRIPES) */
+mutex_t	svcauth_short_lock[8] = {
+	MUTEX_INITIALIZER, MUTEX_INITIALIZER, MUTEX_INITIALIZER, MUTEX_INITIALIZER,
+	MUTEX_INITIALIZER, MUTEX_INITIALIZER, MUTEX_INITIALIZER, MUTEX_INITIALIZER
+};
 /* protects client-side fd lock array */
 mutex_t	clnt_fd_lock = MUTEX_INITIALIZER;
+/* protects the datagram round trip estimators (clnt_dg.c) */
+mutex_t	dg_rtt_lock = MUTEX_INITIALIZER;
+/* protects the datagram multiplexer list (clnt_dgmux.c) */
+mutex_t	dgmux_lock = MUTEX_INITIALIZER;
+/* protects the asynchronous call state list (clnt_async.c) */
+mutex_t	async_lock = MUTEX_INITIALIZER;
+/* protects the client handle pool (clnt_pool.c) */
+mutex_t	pool_lock = MUTEX_INITIALIZER;
 /* clnt_raw.c serialization */
 mutex_t	clntraw_lock = MUTEX_INITIALIZER;
 /* domainname and domain_fd (getdname.c) and default_domain (rpcdname.c) */
@@ -75,16 +90,22 @@ mutex_t	dupreq_lock = MUTEX_INITIALIZER;
 mutex_t	keyserv_lock = MUTEX_INITIALIZER;
 /* serializes rpc_trace() (rpc_trace.c) */
 mutex_t	libnsl_trace_lock = MUTEX_INITIALIZER;
+/* the netconfig database (getnetconfig.c) */
+mutex_t	nc_db_lock = MUTEX_INITIALIZER;
 /* loopnconf (rpcb_clnt.c) */
 mutex_t	loopnconf_lock = MUTEX_INITIALIZER;
 /* serializes ops initializations */
 mutex_t	ops_lock = MUTEX_INITIALIZER;
 /* protects ``port'' static in bindresvport() */
 mutex_t	portnum_lock = MUTEX_INITIALIZER;
+/* protects the procedure statistics registry (svc_stats.c) */
+mutex_t	procstats_lock = MUTEX_INITIALIZER;
 /* protects proglst list (svc_simple.c) */
 mutex_t	proglst_lock = MUTEX_INITIALIZER;
 /* serializes clnt_com_create() (rpc_soc.c) */
 mutex_t	rpcsoc_lock = MUTEX_INITIALIZER;
+/* the automatic MT mode worker pool (svc_run.c) */
+mutex_t	svc_mt_lock = MUTEX_INITIALIZER;
 /* svc_raw.c serialization */
 mutex_t	svcraw_lock = MUTEX_INITIALIZER;
 /* xprtlist (svc_generic.c) */
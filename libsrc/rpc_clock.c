@@ -0,0 +1,139 @@
+/*
+ *  Monotonic clock and deadline support.
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+/*
+ * Transport timeouts are expressed as deadlines against the monotonic
+ * clock, so they are immune to wall clock steps:
+ *
+ *	__rpc_deadline(&deadline, &timeout);
+ *	while (__rpc_deadline_left(&deadline, &ts))
+ *		... pollts(fds, nfds, &ts, NULL) ...
+ *
+ * __rpc_coarse_clock() is a cheaper clock of tick resolution, for
+ * activity stamps and idle sweeps.
+ */
+
+#include "namespace.h"
+#include "reentrant.h"
+#include <sys/types.h>
+#include <sys/time.h>
+#include <rpc/rpc.h>
+#include <time.h>
+
+#include "rpc_internal.h"
+
+#if defined(__WATCOMC__)
+#undef timercmp
+#define timercmp(tvp, uvp, cmp) \
+        ((tvp)->tv_sec cmp (uvp)->tv_sec || \
+         (tvp)->tv_sec == (uvp)->tv_sec && (tvp)->tv_usec cmp (uvp)->tv_usec)
+#endif
+
+/*
+ * Monotonic time.
+ */
+void
+__rpc_clock(struct timeval *tv)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	TIMESPEC_TO_TIMEVAL(tv, &ts);
+}
+
+/*
+ * Monotonic time of tick (10-20ms) resolution, without a system call
+ * where the platform allows.
+ */
+void
+__rpc_coarse_clock(struct timeval *tv)
+{
+#if defined(_WIN32)
+	const ULONGLONG ms = GetTickCount64();
+
+	tv->tv_sec = (long)(ms / 1000);
+	tv->tv_usec = (long)(ms % 1000) * 1000;
+#elif defined(CLOCK_MONOTONIC_COARSE)
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	TIMESPEC_TO_TIMEVAL(tv, &ts);
+#else
+	__rpc_clock(tv);
+#endif
+}
+
+/*
+ * Deadline timeout from now.
+ */
+void
+__rpc_deadline(struct timeval *deadline, const struct timeval *timeout)
+{
+	struct timeval now;
+
+	__rpc_clock(&now);
+	timeradd(&now, timeout, deadline);
+}
+
+/*
+ * Time left before the deadline, as used by pollts(); FALSE once it
+ * has passed.
+ */
+bool_t
+__rpc_deadline_left(const struct timeval *deadline, struct timespec *left)
+{
+	struct timeval now, tv;
+
+	__rpc_clock(&now);
+	if (! timercmp(&now, deadline, <))
+		return (FALSE);
+	timersub(deadline, &now, &tv);
+	TIMEVAL_TO_TIMESPEC(&tv, left);
+	return (TRUE);
+}
+
+/*
+ * The deadline as an absolute CLOCK_REALTIME time, as used by
+ * cond_timedwait(); FALSE once it has passed.
+ */
+bool_t
+__rpc_deadline_abstime(const struct timeval *deadline, struct timespec *abstime)
+{
+	struct timespec left;
+
+	if (! __rpc_deadline_left(deadline, &left))
+		return (FALSE);
+	(void) clock_gettime(CLOCK_REALTIME, abstime);
+	abstime->tv_sec += left.tv_sec;
+	abstime->tv_nsec += left.tv_nsec;
+	if (abstime->tv_nsec >= 1000000000) {
+		abstime->tv_nsec -= 1000000000;
+		abstime->tv_sec++;
+	}
+	return (TRUE);
+}
+
+/*end*/
@@ -35,6 +35,7 @@
 
 bool_t __xdrrec_getrec(XDR *, enum xprt_stat *, bool_t);
 bool_t __xdrrec_setnonblock(XDR *, int);
+bool_t __xdrrec_flush(XDR *);
 void __xprt_unregister_unlocked(SVCXPRT *);
 LIBRPC_API bool_t __svc_clean_idle(fd_set *, int, bool_t);
 
@@ -54,9 +55,47 @@ int __rpc_sockisbound(int);
 
 struct netbuf *__rpcb_findaddr(rpcprog_t, rpcvers_t, const struct netconfig *, const char *, CLIENT **);
 bool_t __rpc_control(int, void *);
+void __rpcb_cache_invalidate(rpcprog_t, rpcvers_t, const struct netconfig *, const char *);
+void __rpcb_cache_failed(const void *, size_t, enum clnt_stat);
+bool_t __rpcb_cache_control(int, void *);
+bool_t __svc_auth_stats(struct svc_authstats *);
+bool_t __clnt_pool_control(int, void *);
+bool_t __svc_mt_control(int, void *);
+bool_t __svc_mt_busy(int);
+bool_t __svc_proccount_control(int, void *);
+
+bool_t __clnt_vc_pipelined(CLIENT *);
+u_int __clnt_vc_sendsz(CLIENT *);
+enum clnt_stat __clnt_vc_send(CLIENT *, rpcproc_t, xdrproc_t, const char *,
+    u_int32_t *);
+enum clnt_stat __clnt_vc_recv(CLIENT *, const struct timeval *,
+    bool_t (*)(void *, u_int32_t, xdrproc_t *, caddr_t *), void *,
+    u_int32_t *, enum clnt_stat *);
+void __clnt_async_destroy(CLIENT *);
 
 char *_get_next_token(char *, int);
 
+void __rpc_clock(struct timeval *);
+void __rpc_coarse_clock(struct timeval *);
+void __rpc_deadline(struct timeval *, const struct timeval *);
+bool_t __rpc_deadline_left(const struct timeval *, struct timespec *);
+bool_t __rpc_deadline_abstime(const struct timeval *, struct timespec *);
+
+struct dg_rtt;
+struct clnt_rtt;
+struct dg_rtt *__dg_rtt_get(const struct sockaddr_storage *, int);
+void __dg_rtt_put(struct dg_rtt *);
+void __dg_rtt_update(struct dg_rtt *, rpcproc_t, const struct timeval *);
+void __dg_rtt_rto(struct dg_rtt *, rpcproc_t, struct timeval *);
+void __dg_rtt_timeout(struct dg_rtt *);
+void __dg_rtt_stats(struct dg_rtt *, rpcproc_t, struct clnt_rtt *);
+
+bool_t __authnone_image(AUTH *, const char **, u_int *, u_int *);
+bool_t __authunix_image(AUTH *, const char **, u_int *, u_int *);
+#define __AUTH_IMAGE(auth, image, len, gen) \
+	(__authnone_image(auth, image, len, gen) || \
+	 __authunix_image(auth, image, len, gen))
+
 u_int32_t __rpc_getxid(void);
 #define __RPC_GETXID()	(__rpc_getxid())
 
@@ -73,6 +73,7 @@ __RCSID("$NetBSD: rpcb_clnt.c,v 1.31 2015/03/26 11:31:57 justin Exp $");
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "svc_fdset.h"
@@ -91,18 +92,36 @@ static const struct timeval rmttimeout = { 3, 0 };
 
 static const char nullstring[] = "\000";
 
-#define	CACHESIZE 6
+#define	CACHESIZE	256		/* maximum cached addresses */
+#define	CACHEHASH	64		/* hash chains, power of 2 */
+#define	CACHE_TTL	120		/* seconds, resolved addresses */
+#define	CACHE_NEGTTL	10		/* seconds, unregistered programs */
 
+#define	RPCB_LOCATION	((rpcvers_t)0)	/* ac_vers of rpcbind entries */
+
+/*
+ * Cached addresses keyed by (host, netid, prog, vers); the address of
+ * the remote rpcbind itself is held under (RPCBPROG, RPCB_LOCATION).
+ * A negative entry (ac_taddr == NULL) records a program which is not
+ * registered.  Each entry is a single allocation, the key strings and
+ * address following the header.
+ */
 struct address_cache {
+	struct address_cache *ac_next;	/* hash chain */
+	u_int32_t ac_hash;
+	time_t ac_expires;
+	rpcprog_t ac_prog;
+	rpcvers_t ac_vers;
 	char *ac_host;
 	char *ac_netid;
 	char *ac_uaddr;
 	struct netbuf *ac_taddr;
-	struct address_cache *ac_next;
+	struct netbuf ac_taddrbuf;
 };
 
-static struct address_cache *front;
+static struct address_cache *cache[CACHEHASH];
 static int cachesize;
+static struct rpcb_cachestats cachestats;
 
 #define	CLCR_GET_RPCB_TIMEOUT	1
 #define	CLCR_SET_RPCB_TIMEOUT	2
@@ -110,9 +129,13 @@ static int cachesize;
 
 extern int __rpc_lowvers;
 
-static struct address_cache *check_cache(const char *, const char *);
+static u_int32_t hash_cache(const char *, const char *, rpcprog_t, rpcvers_t);
+static struct address_cache *find_cache(const char *, const char *, rpcprog_t, rpcvers_t);
+static struct address_cache *check_cache(const char *, const char *, rpcprog_t, rpcvers_t);
+static void unlink_cache(struct address_cache *);
 static void delete_cache(struct netbuf *);
-static void add_cache(const char *, const char *, struct netbuf *, char *);
+static void add_cache(const char *, const char *, rpcprog_t, rpcvers_t, struct netbuf *, char *);
+static struct netbuf *dup_netbuf(const struct netbuf *);
 static CLIENT *getclnthandle(const char *, const struct netconfig *, char **);
 static CLIENT *local_rpcb(void);
 static struct netbuf *got_entry(rpcb_entry_list_ptr, const struct netconfig *);
@@ -163,13 +186,51 @@ __rpc_control(int request, void *info)
 extern rwlock_t	rpcbaddr_cache_lock;
 #endif
 
+/* counters are updated atomically, so lookups under the read lock race */
+#if defined(_WIN32)
+#define	CACHE_STAT(__field)	(void)InterlockedIncrement((volatile LONG *)&cachestats.__field)
+#else
+#define	CACHE_STAT(__field)	(void)__atomic_add_fetch(&cachestats.__field, 1, __ATOMIC_RELAXED)
+#endif
+
 /*
  * The routines check_cache(), add_cache(), delete_cache() manage the
- * cache of rpcbind addresses for (host, netid).
+ * cache of rpcbind and service addresses for (host, netid, prog, vers).
  */
 
+static u_int32_t
+hash_cache(const char *host, const char *netid, rpcprog_t prog, rpcvers_t vers)
+{
+	u_int32_t hash = 2166136261U;	/* FNV-1a */
+
+	while (*host)
+		hash = (hash ^ (unsigned char)*host++) * 16777619U;
+	while (*netid)
+		hash = (hash ^ (unsigned char)*netid++) * 16777619U;
+	hash = (hash ^ (u_int32_t)prog) * 16777619U;
+	hash = (hash ^ (u_int32_t)vers) * 16777619U;
+	return hash;
+}
+
+static struct address_cache *
+find_cache(const char *host, const char *netid, rpcprog_t prog, rpcvers_t vers)
+{
+	const u_int32_t hash = hash_cache(host, netid, prog, vers);
+	struct address_cache *cptr;
+
+	/* LOCK HELD ON ENTRY: rpcbaddr_cache_lock */
+	for (cptr = cache[hash & (CACHEHASH - 1)]; cptr != NULL;
+	    cptr = cptr->ac_next) {
+		if (cptr->ac_hash == hash && cptr->ac_prog == prog &&
+		    cptr->ac_vers == vers && !strcmp(cptr->ac_host, host) &&
+		    !strcmp(cptr->ac_netid, netid))
+			return (cptr);
+	}
+	return NULL;
+}
+
 static struct address_cache *
-check_cache(const char *host, const char *netid)
+check_cache(const char *host, const char *netid, rpcprog_t prog, rpcvers_t vers)
 {
 	struct address_cache *cptr;
 
@@ -178,86 +239,106 @@ check_cache(const char *host, const char *netid)
 
 	/* READ LOCK HELD ON ENTRY: rpcbaddr_cache_lock */
 
-	for (cptr = front; cptr != NULL; cptr = cptr->ac_next) {
-		if (!strcmp(cptr->ac_host, host) &&
-		    !strcmp(cptr->ac_netid, netid)) {
+	CACHE_STAT(rc_lookups);
+	cptr = find_cache(host, netid, prog, vers);
+	if (cptr == NULL || cptr->ac_expires <= time(NULL))
+		return NULL;			/* stale; replaced on add */
 #ifdef ND_DEBUG
-			fprintf(stderr, "Found cache entry for %s: %s\n",
-				host, netid);
+	fprintf(stderr, "Found cache entry for %s: %s\n", host, netid);
 #endif
-			return (cptr);
+	if (cptr->ac_taddr)
+		CACHE_STAT(rc_hits);
+	else
+		CACHE_STAT(rc_neghits);
+	return (cptr);
+}
+
+static void
+unlink_cache(struct address_cache *ad_cache)
+{
+	struct address_cache **cpp;
+
+	/* WRITE LOCK HELD ON ENTRY: rpcbaddr_cache_lock */
+	for (cpp = &cache[ad_cache->ac_hash & (CACHEHASH - 1)]; *cpp;
+	    cpp = &(*cpp)->ac_next) {
+		if (*cpp == ad_cache) {
+			*cpp = ad_cache->ac_next;
+			free(ad_cache);
+			cachesize--;
+			break;
 		}
 	}
-	return NULL;
 }
 
+/*
+ * Remove all entries which resolved to the given address.
+ */
 static void
 delete_cache(struct netbuf *addr)
 {
-	struct address_cache *cptr, *prevptr = NULL;
+	struct address_cache **cpp, *cptr;
+	int i;
 
 	_DIAGASSERT(addr != NULL);
 
 	/* WRITE LOCK HELD ON ENTRY: rpcbaddr_cache_lock */
-	for (cptr = front; cptr != NULL; cptr = cptr->ac_next) {
-		if (!memcmp(cptr->ac_taddr->buf, addr->buf, addr->len)) {
-			free(cptr->ac_host);
-			free(cptr->ac_netid);
-			free(cptr->ac_taddr->buf);
-			free(cptr->ac_taddr);
-			if (cptr->ac_uaddr)
-				free(cptr->ac_uaddr);
-			if (prevptr)
-				prevptr->ac_next = cptr->ac_next;
-			else
-				front = cptr->ac_next;
-			free(cptr);
-			cachesize--;
-			break;
+	for (i = 0; i < CACHEHASH; ++i) {
+		for (cpp = &cache[i]; (cptr = *cpp) != NULL;) {
+			if (cptr->ac_taddr && cptr->ac_taddr->len == addr->len &&
+			    !memcmp(cptr->ac_taddr->buf, addr->buf, addr->len)) {
+				*cpp = cptr->ac_next;
+				free(cptr);
+				cachesize--;
+				CACHE_STAT(rc_invalidations);
+				continue;
+			}
+			cpp = &cptr->ac_next;
 		}
-		prevptr = cptr;
 	}
 }
 
+/*
+ * Add or replace an entry; a NULL taddr creates a negative entry.  When
+ * full, an expired entry, otherwise the entry closest to expiry, is
+ * evicted.
+ */
 static void
-add_cache(const char *host, const char *netid, struct netbuf *taddr,
-	char *uaddr)
+add_cache(const char *host, const char *netid, rpcprog_t prog, rpcvers_t vers,
+	struct netbuf *taddr, char *uaddr)
 {
-	struct address_cache  *ad_cache, *cptr, *prevptr;
+	const size_t hostlen = strlen(host) + 1, netidlen = strlen(netid) + 1,
+	    uaddrlen = uaddr ? strlen(uaddr) + 1 : 0,
+	    taddrlen = taddr ? taddr->len : 0;
+	struct address_cache  *ad_cache, *cptr, *victim;
+	char *cp;
+	int i;
 
 	_DIAGASSERT(host != NULL);
 	_DIAGASSERT(netid != NULL);
 	/* uaddr may be NULL */
-	/* taddr may be NULL ??? */
+	/* taddr may be NULL, negative entry */
 
-	ad_cache = malloc(sizeof(*ad_cache));
+	ad_cache = malloc(sizeof(*ad_cache) + hostlen + netidlen + uaddrlen +
+	    taddrlen);
 	if (!ad_cache) {
 		return;
 	}
-	ad_cache->ac_host = strdup(host);
-	ad_cache->ac_netid = strdup(netid);
-	ad_cache->ac_uaddr = uaddr ? strdup(uaddr) : NULL;
-	ad_cache->ac_taddr = malloc(sizeof(*ad_cache->ac_taddr));
-	if (!ad_cache->ac_host || !ad_cache->ac_netid || !ad_cache->ac_taddr ||
-		(uaddr && !ad_cache->ac_uaddr)) {
-		goto out;
-	}
-	ad_cache->ac_taddr->len = ad_cache->ac_taddr->maxlen = taddr->len;
-	ad_cache->ac_taddr->buf = malloc(taddr->len);
-	if (ad_cache->ac_taddr->buf == NULL) {
-out:
-		if (ad_cache->ac_host)
-			free(ad_cache->ac_host);
-		if (ad_cache->ac_netid)
-			free(ad_cache->ac_netid);
-		if (ad_cache->ac_uaddr)
-			free(ad_cache->ac_uaddr);
-		if (ad_cache->ac_taddr)
-			free(ad_cache->ac_taddr);
-		free(ad_cache);
-		return;
+	cp = (char *)(ad_cache + 1);
+	ad_cache->ac_hash = hash_cache(host, netid, prog, vers);
+	ad_cache->ac_expires = time(NULL) + (taddr ? CACHE_TTL : CACHE_NEGTTL);
+	ad_cache->ac_prog = prog;
+	ad_cache->ac_vers = vers;
+	ad_cache->ac_host = memcpy(cp, host, hostlen), cp += hostlen;
+	ad_cache->ac_netid = memcpy(cp, netid, netidlen), cp += netidlen;
+	ad_cache->ac_uaddr = uaddr ? memcpy(cp, uaddr, uaddrlen) : NULL;
+	cp += uaddrlen;
+	if (taddr) {
+		ad_cache->ac_taddr = &ad_cache->ac_taddrbuf;
+		ad_cache->ac_taddr->len = ad_cache->ac_taddr->maxlen = taddr->len;
+		ad_cache->ac_taddr->buf = memcpy(cp, taddr->buf, taddr->len);
+	} else {
+		ad_cache->ac_taddr = NULL;
 	}
-	memcpy(ad_cache->ac_taddr->buf, taddr->buf, taddr->len);
 #ifdef ND_DEBUG
 	fprintf(stderr, "Added to cache: %s : %s\n", host, netid);
 #endif
@@ -265,43 +346,137 @@ out:
 /* VARIABLES PROTECTED BY rpcbaddr_cache_lock:  cptr */
 
 	rwlock_wrlock(&rpcbaddr_cache_lock);
-	if (cachesize < CACHESIZE) {
-		ad_cache->ac_next = front;
-		front = ad_cache;
-		cachesize++;
-	} else {
-		/* Free the last entry */
-		cptr = front;
-		prevptr = NULL;
-		while (cptr->ac_next) {
-			prevptr = cptr;
-			cptr = cptr->ac_next;
+	if ((cptr = find_cache(host, netid, prog, vers)) != NULL)
+		unlink_cache(cptr);		/* replace */
+	if (cachesize >= CACHESIZE) {
+		const time_t now = time(NULL);
+
+		victim = NULL;
+		for (i = 0; i < CACHEHASH; ++i) {
+			for (cptr = cache[i]; cptr; cptr = cptr->ac_next)
+				if (victim == NULL ||
+				    cptr->ac_expires < victim->ac_expires)
+					victim = cptr;
+			if (victim && victim->ac_expires <= now)
+				break;		/* expired, take it */
 		}
-
 #ifdef ND_DEBUG
 		fprintf(stderr, "Deleted from cache: %s : %s\n",
-			cptr->ac_host, cptr->ac_netid);
+			victim->ac_host, victim->ac_netid);
 #endif
-		free(cptr->ac_host);
-		free(cptr->ac_netid);
-		free(cptr->ac_taddr->buf);
-		free(cptr->ac_taddr);
-		if (cptr->ac_uaddr)
-			free(cptr->ac_uaddr);
-
-		if (prevptr) {
-			prevptr->ac_next = NULL;
-			ad_cache->ac_next = front;
-			front = ad_cache;
-		} else {
-			front = ad_cache;
-			ad_cache->ac_next = NULL;
-		}
-		free(cptr);
+		unlink_cache(victim);
+		CACHE_STAT(rc_evictions);
+	}
+	ad_cache->ac_next = cache[ad_cache->ac_hash & (CACHEHASH - 1)];
+	cache[ad_cache->ac_hash & (CACHEHASH - 1)] = ad_cache;
+	cachesize++;
+	CACHE_STAT(rc_inserts);
+	rwlock_unlock(&rpcbaddr_cache_lock);
+}
+
+static struct netbuf *
+dup_netbuf(const struct netbuf *taddr)
+{
+	struct netbuf *nb;
+
+	if ((nb = malloc(sizeof(*nb))) == NULL)
+		return NULL;
+	if ((nb->buf = malloc(taddr->len)) == NULL) {
+		free(nb);
+		return NULL;
 	}
+	memcpy(nb->buf, taddr->buf, taddr->len);
+	nb->len = nb->maxlen = taddr->len;
+	return nb;
+}
+
+/*
+ * Discard the cached address of (prog, vers) on host; called by the
+ * client creation paths when the cached address fails to connect.
+ */
+void
+__rpcb_cache_invalidate(rpcprog_t program, rpcvers_t version,
+	const struct netconfig *nconf, const char *host)
+{
+	struct address_cache *ad_cache;
+
+	_DIAGASSERT(host != NULL);
+
+	if (nconf == NULL)
+		return;
+	rwlock_wrlock(&rpcbaddr_cache_lock);
+	ad_cache = find_cache(host, nconf->nc_netid, program, version);
+	if (ad_cache != NULL) {
+		unlink_cache(ad_cache);
+		CACHE_STAT(rc_invalidations);
+	}
+	rwlock_unlock(&rpcbaddr_cache_lock);
+}
+
+/*
+ * A call to addr failed in a way suggesting the service is no longer
+ * there, say restarted on another port; discard the entries resolving
+ * to it.  Connection-oriented clients notice at connect time, see
+ * clnt_tp_create(), datagram clients only through their calls; they
+ * report RPC_TIMEDOUT only once retransmissions have run out, never
+ * for one-way calls.
+ */
+void
+__rpcb_cache_failed(const void *addr, size_t len, enum clnt_stat stat)
+{
+	struct netbuf nb;
+
+	switch (stat) {
+	case RPC_PROGUNAVAIL:
+	case RPC_PROGVERSMISMATCH:
+	case RPC_TIMEDOUT:
+		break;
+	default:
+		return;
+	}
+	if (cachesize == 0)		/* unlocked, a hint */
+		return;
+	nb.buf = __UNCONST(addr);
+	nb.len = nb.maxlen = (u_int)len;
+	rwlock_wrlock(&rpcbaddr_cache_lock);
+	delete_cache(&nb);
 	rwlock_unlock(&rpcbaddr_cache_lock);
 }
 
+/*
+ * Retrieve the cache statistics, optionally flushing the cache.
+ */
+bool_t
+__rpcb_cache_control(int request, void *info)
+{
+	struct address_cache *cptr;
+	int i;
+
+	switch (request) {
+	case RPC_CLNT_RPCBCACHE_STATS:
+		_DIAGASSERT(info != NULL);
+		rwlock_rdlock(&rpcbaddr_cache_lock);
+		*(struct rpcb_cachestats *)info = cachestats;	/* advisory */
+		((struct rpcb_cachestats *)info)->rc_entries = cachesize;
+		rwlock_unlock(&rpcbaddr_cache_lock);
+		return TRUE;
+	case RPC_CLNT_RPCBCACHE_FLUSH:
+		rwlock_wrlock(&rpcbaddr_cache_lock);
+		for (i = 0; i < CACHEHASH; ++i) {
+			while ((cptr = cache[i]) != NULL) {
+				cache[i] = cptr->ac_next;
+				free(cptr);
+			}
+		}
+		cachesize = 0;
+		rwlock_unlock(&rpcbaddr_cache_lock);
+		return TRUE;
+	default:
+		break;
+	}
+	return FALSE;
+}
+
 /*
  * This routine will return a client handle that is connected to the
  * rpcbind. Returns NULL on error and free's everything.
@@ -328,7 +503,7 @@ getclnthandle(const char *host, const struct netconfig *nconf, char **targaddr)
 	addr_to_delete.len = 0;
 	addr_to_delete.buf = NULL;
 	rwlock_rdlock(&rpcbaddr_cache_lock);
-	ad_cache = check_cache(host, nconf->nc_netid);
+	ad_cache = check_cache(host, nconf->nc_netid, RPCBPROG, RPCB_LOCATION);
 	if (ad_cache != NULL) {
 		addr = ad_cache->ac_taddr;
 		client = clnt_tli_create(RPC_ANYFD, nconf, addr,
@@ -414,7 +589,8 @@ getclnthandle(const char *host, const struct netconfig *nconf, char **targaddr)
 
 		if (client) {
 			tmpaddr = targaddr ? taddr2uaddr(nconf, &taddr) : NULL;
-			add_cache(host, nconf->nc_netid, &taddr, tmpaddr);
+			add_cache(host, nconf->nc_netid, RPCBPROG, RPCB_LOCATION,
+			    &taddr, tmpaddr);
 			if (targaddr)
 				*targaddr = tmpaddr;
 			break;
@@ -725,6 +901,8 @@ __rpcb_findaddr(rpcprog_t program, rpcvers_t version,
 	struct netbuf *address = NULL;
 	rpcvers_t start_vers = RPCBVERS4;
 	struct netbuf servaddr;
+	struct address_cache *ad_cache;
+	bool_t notregistered = FALSE;
 
 	/* nconf is handled below */
 	_DIAGASSERT(host != NULL);
@@ -736,6 +914,21 @@ __rpcb_findaddr(rpcprog_t program, rpcvers_t version,
 		return (NULL);
 	}
 
+	/* Answer from the address cache, if possible */
+	rwlock_rdlock(&rpcbaddr_cache_lock);
+	ad_cache = check_cache(host, nconf->nc_netid, program, version);
+	if (ad_cache != NULL) {
+		if (ad_cache->ac_taddr == NULL)
+			rpc_createerr.cf_stat = RPC_PROGNOTREGISTERED;
+		else if ((address = dup_netbuf(ad_cache->ac_taddr)) == NULL)
+			rpc_createerr.cf_stat = RPC_SYSTEMERROR;
+		rwlock_unlock(&rpcbaddr_cache_lock);
+		if (clpp)
+			*clpp = NULL;
+		return (address);
+	}
+	rwlock_unlock(&rpcbaddr_cache_lock);
+
 	parms.r_addr = NULL;
 
 #ifdef PORTMAP
@@ -787,6 +980,7 @@ __rpcb_findaddr(rpcprog_t program, rpcvers_t version,
 		} else if (port == 0) {
 			address = NULL;
 			rpc_createerr.cf_stat = RPC_PROGNOTREGISTERED;
+			notregistered = TRUE;
 			goto error;
 		}
 		port = htons(port);
@@ -950,6 +1144,7 @@ regular_rpcbind:
 			if ((ua == NULL) || (ua[0] == 0)) {
 				/* address unknown */
 				rpc_createerr.cf_stat = RPC_PROGNOTREGISTERED;
+				notregistered = TRUE;
 				goto error;
 			}
 			address = uaddr2taddr(nconf, ua);
@@ -1003,6 +1198,10 @@ done:
 	} else if (client) {
 		CLNT_DESTROY(client);
 	}
+	if (address != NULL)
+		add_cache(host, nconf->nc_netid, program, version, address, NULL);
+	else if (notregistered)
+		add_cache(host, nconf->nc_netid, program, version, NULL, NULL);
 	return (address);
 }
 
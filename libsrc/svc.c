@@ -830,6 +830,24 @@ rpc_control(int what, void *arg)
 	case RPC_SVC_CONNMAXREC_GET:
 		*(int *)arg = __svc_maxrec;
 		return TRUE;
+	case RPC_CLNT_RPCBCACHE_STATS:
+	case RPC_CLNT_RPCBCACHE_FLUSH:
+		return __rpcb_cache_control(what, arg);
+	case RPC_SVC_AUTHSTATS_GET:
+		return __svc_auth_stats((struct svc_authstats *)arg);
+	case RPC_CLNT_POOL_STATS:
+	case RPC_CLNT_POOL_GETPARAMS:
+	case RPC_CLNT_POOL_SETPARAMS:
+	case RPC_CLNT_POOL_FLUSH:
+		return __clnt_pool_control(what, arg);
+	case RPC_SVC_MTMODE_SET:
+	case RPC_SVC_MTMODE_GET:
+	case RPC_SVC_THRMAX_SET:
+	case RPC_SVC_THRMAX_GET:
+		return __svc_mt_control(what, arg);
+	case RPC_SVC_PROCSTATS_GET:
+	case RPC_SVC_PROCSTATS_RESET:
+		return __svc_proccount_control(what, arg);
 	default:
 		break;
 	}
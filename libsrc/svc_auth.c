@@ -57,6 +57,8 @@ __RCSID("$NetBSD: svc_auth.c,v 1.17 2013/03/11 20:19:29 tron Exp $");
 #include <assert.h>
 #include <stdlib.h>
 
+#include "rpc_internal.h"
+
 #ifdef __weak_alias
 __weak_alias(svc_auth_reg,_svc_auth_reg)
 #endif
@@ -76,13 +78,74 @@ __weak_alias(svc_auth_reg,_svc_auth_reg)
  *
  */
 
-/* declarations to allow servers to specify new authentication flavors */
+/*
+ * Declarations to allow servers to specify new authentication flavors.
+ *
+ * Registered flavors are published as an immutable table, sorted by
+ * flavor, which _authenticate() reads without locking; svc_auth_reg()
+ * replaces the table under authsvc_lock (copy-on-write).  As there is no
+ * provision to delete a registration, entries and retired tables are
+ * never freed, so a reader holding an old table remains safe.
+ */
 struct authsvc {
 	int	flavor;
 	enum	auth_stat (*handler)(struct svc_req *, struct rpc_msg *);
-	struct	authsvc	  *next;
+	volatile long ok;		/* AUTH_OK */
+	volatile long failed;		/* anything else */
+};
+
+struct authsvc_tab {
+	u_int	count;
+	struct	authsvc *ents[1];	/* [count], by flavor */
 };
-static struct authsvc *Auths = NULL;
+
+static struct authsvc_tab * volatile Auths = NULL;
+
+/* counters for builtin flavors AUTH_NULL .. AUTH_SHORT */
+static struct authsvc Builtins[AUTH_SHORT + 1];
+
+#if defined(_WIN32)
+#define	AUTHS_LOAD()		(Auths)	/* volatile read, acquire */
+#define	AUTHS_PUBLISH(tab)	(void)InterlockedExchangePointer((PVOID volatile *)&Auths, (tab))
+#define	AUTHS_COUNT(c)		(void)InterlockedIncrement(&(c))
+#else
+#define	AUTHS_LOAD()		__atomic_load_n(&Auths, __ATOMIC_ACQUIRE)
+#define	AUTHS_PUBLISH(tab)	__atomic_store_n(&Auths, (tab), __ATOMIC_RELEASE)
+#define	AUTHS_COUNT(c)		(void)__atomic_add_fetch(&(c), 1, __ATOMIC_RELAXED)
+#endif
+
+static struct authsvc *authsvc_find(const struct authsvc_tab *, int);
+static enum auth_stat authsvc_count(struct authsvc *, enum auth_stat);
+
+static struct authsvc *
+authsvc_find(const struct authsvc_tab *tab, int flavor)
+{
+	u_int lo = 0, hi, mid;
+
+	if (tab == NULL)
+		return (NULL);
+	hi = tab->count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (tab->ents[mid]->flavor == flavor)
+			return (tab->ents[mid]);
+		if (tab->ents[mid]->flavor < flavor)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (NULL);
+}
+
+static enum auth_stat
+authsvc_count(struct authsvc *asp, enum auth_stat stat)
+{
+	if (stat == AUTH_OK)
+		AUTHS_COUNT(asp->ok);
+	else
+		AUTHS_COUNT(asp->failed);
+	return (stat);
+}
 
 /*
  * The call rpc message, msg has been obtained from the wire.  The msg contains
@@ -108,15 +171,10 @@ _authenticate(struct svc_req *rqst, struct rpc_msg *msg)
 	int cred_flavor;
 	struct authsvc *asp;
 	enum auth_stat dummy;
-#ifdef _REENTRANT
-	extern mutex_t authsvc_lock;
-#endif
 
 	_DIAGASSERT(rqst != NULL);
 	_DIAGASSERT(msg != NULL);
 
-/* VARIABLES PROTECTED BY authsvc_lock: asp, Auths */
-
 	rqst->rq_cred = msg->rm_call.cb_cred;
 	rqst->rq_xprt->xp_verf.oa_flavor = _null_auth.oa_flavor;
 	rqst->rq_xprt->xp_verf.oa_length = 0;
@@ -124,13 +182,13 @@ _authenticate(struct svc_req *rqst, struct rpc_msg *msg)
 	switch (cred_flavor) {
 	case AUTH_NULL:
 		dummy = _svcauth_null(rqst, msg);
-		return (dummy);
+		return (authsvc_count(&Builtins[AUTH_NULL], dummy));
 	case AUTH_SYS:
 		dummy = _svcauth_unix(rqst, msg);
-		return (dummy);
+		return (authsvc_count(&Builtins[AUTH_SYS], dummy));
 	case AUTH_SHORT:
 		dummy = _svcauth_short(rqst, msg);
-		return (dummy);
+		return (authsvc_count(&Builtins[AUTH_SHORT], dummy));
 #if 0
 	case AUTH_DES:
 		dummy = __svcauth_des(rqst, msg);
@@ -141,17 +199,8 @@ _authenticate(struct svc_req *rqst, struct rpc_msg *msg)
 	}
 
 	/* flavor doesn't match any of the builtin types, so try new ones */
-	mutex_lock(&authsvc_lock);
-	for (asp = Auths; asp; asp = asp->next) {
-		if (asp->flavor == cred_flavor) {
-			enum auth_stat as;
-
-			as = (*asp->handler)(rqst, msg);
-			mutex_unlock(&authsvc_lock);
-			return (as);
-		}
-	}
-	mutex_unlock(&authsvc_lock);
+	if ((asp = authsvc_find(AUTHS_LOAD(), cred_flavor)) != NULL)
+		return (authsvc_count(asp, (*asp->handler)(rqst, msg)));
 
 	return (AUTH_REJECTEDCRED);
 }
@@ -182,7 +231,9 @@ svc_auth_reg(
 	int cred_flavor,
 	enum auth_stat (*handler)(struct svc_req *, struct rpc_msg *))
 {
+	struct authsvc_tab *otab, *ntab;
 	struct authsvc *asp;
+	u_int i, j;
 #ifdef _REENTRANT
 	extern mutex_t authsvc_lock;
 #endif
@@ -199,26 +250,57 @@ svc_auth_reg(
 
 	    default:
 		mutex_lock(&authsvc_lock);
-		for (asp = Auths; asp; asp = asp->next) {
-			if (asp->flavor == cred_flavor) {
-				/* already registered */
-				mutex_unlock(&authsvc_lock);
-				return (1);
-			}
+		otab = AUTHS_LOAD();
+		if (authsvc_find(otab, cred_flavor) != NULL) {
+			/* already registered */
+			mutex_unlock(&authsvc_lock);
+			return (1);
 		}
 
 		/* this is a new one, so go ahead and register it */
 		asp = mem_alloc(sizeof (*asp));
-		if (asp == NULL) {
+		ntab = mem_alloc(sizeof (*ntab) +
+		    (otab ? otab->count : 0) * sizeof (ntab->ents[0]));
+		if (asp == NULL || ntab == NULL) {
 			mutex_unlock(&authsvc_lock);
+			if (asp != NULL)
+				mem_free(asp, sizeof (*asp));
+			if (ntab != NULL)
+				mem_free(ntab, 0);
 			return (-1);
 		}
 		asp->flavor = cred_flavor;
 		asp->handler = handler;
-		asp->next = Auths;
-		Auths = asp;
+		asp->ok = asp->failed = 0;
+		for (i = j = 0; otab && i < otab->count; ++i) {
+			if (asp->flavor < otab->ents[i]->flavor && i == j)
+				ntab->ents[j++] = asp;
+			ntab->ents[j++] = otab->ents[i];
+		}
+		if (i == j)
+			ntab->ents[j++] = asp;
+		ntab->count = j;
+		AUTHS_PUBLISH(ntab);		/* otab is retained, see above */
 		mutex_unlock(&authsvc_lock);
 		break;
 	}
 	return (0);
 }
+
+/*
+ *  Authentication counters for the flavor named by stats->as_flavor,
+ *  see RPC_SVC_AUTHSTATS_GET.
+ */
+bool_t
+__svc_auth_stats(struct svc_authstats *stats)
+{
+	struct authsvc *asp;
+
+	if (stats->as_flavor >= AUTH_NULL && stats->as_flavor <= AUTH_SHORT)
+		asp = &Builtins[stats->as_flavor];
+	else if ((asp = authsvc_find(AUTHS_LOAD(), stats->as_flavor)) == NULL)
+		return (FALSE);
+	stats->as_ok = (u_long)asp->ok;
+	stats->as_failed = (u_long)asp->failed;
+	return (TRUE);
+}
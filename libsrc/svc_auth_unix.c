@@ -47,19 +47,94 @@ __RCSID("$NetBSD: svc_auth_unix.c,v 1.21 2013/03/11 20:19:29 tron Exp $");
  * There are two svc auth implementations here: AUTH_UNIX and AUTH_SHORT.
  * _svcauth_unix does full blown unix style uid,gid+gids auth,
  * _svcauth_short uses a shorthand auth to index into a cache of longhand auths.
- * Note: the shorthand has been gutted for efficiency.
  *
  * Copyright (C) 1984, Sun Microsystems, Inc.
  */
 
 #include "namespace.h"
 
+#include "reentrant.h"
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <randomid.h>
 
 #include <rpc/rpc.h>
 
+/*
+ * Shorthand cache.
+ *
+ * Each successful longhand authentication is remembered, keyed by the raw
+ * credential, and the client is issued an AUTH_SHORT verifier naming the
+ * slot (index and tag); later calls presenting that shorthand are resolved
+ * by indexing the slot and comparing the tag.  The cache is bounded, the
+ * least recently used slot being reused, which invalidates its shorthand
+ * by bumping the tag.  A stale shorthand is rejected with AUTH_REJECTEDCRED,
+ * upon which the client falls back to its longhand credential.
+ *
+ * Tags start from random values, and each shorthand also carries a nonce
+ * drawn when the process first issues one, so a shorthand kept by a
+ * client across a server restart cannot name another client's slot.
+ *
+ * The cache is split into SHORT_STRIPES independent stripes, each with
+ * its own lock, slots, hash chains and LRU list, so that concurrent
+ * requests rarely contend.  A longhand is held by the stripe selected by
+ * its hash; a shorthand index names the stripe and the slot within it.
+ */
+#define	SHORT_STRIPES	8		/* see svcauth_short_lock[] */
+#define	SHORT_STRIPESZ	32		/* slots per stripe */
+#define	SHORT_HASHSZ	32		/* hash buckets per stripe, power of 2 */
+#define	SHORT_STRIPE(h)	((h) >> 29)	/* top bits, SHORT_STRIPES == 8 */
+
+struct area {
+	struct authunix_parms area_aup;
+	char area_machname[MAX_MACHINE_NAME+1];
+	int area_gids[NGRPS];
+};
+
+struct short_ent {
+	struct short_ent *hnext;	/* longhand hash chain */
+	struct short_ent *prev, *next;	/* LRU, most recent first */
+	u_int32_t	tag;		/* 0 = unused */
+	u_int32_t	hash;
+	u_int		credlen;
+	char		cred[MAX_AUTH_BYTES];
+	struct area	area;		/* cooked credential */
+};
+
+struct short_cred {			/* AUTH_SHORT body */
+	u_int32_t	index;
+	u_int32_t	tag;
+	u_int32_t	nonce;		/* short_nonce of the issuer */
+};
+
+struct short_stripe {
+	struct short_ent *ents;		/* [SHORT_STRIPESZ] */
+	struct short_ent *hash[SHORT_HASHSZ];
+	struct short_ent *lru;		/* head; tail is lru->prev */
+	u_int32_t	tag;
+};
+
+static struct short_stripe short_stripes[SHORT_STRIPES];
+static u_int32_t short_nonce;
+
+#ifdef _REENTRANT
+static once_t short_once = ONCE_INITIALIZER;
+#else
+static int short_ready;
+#endif
+
+#ifdef _REENTRANT
+extern mutex_t svcauth_short_lock[SHORT_STRIPES];
+#endif
+
+static void short_setup(void);
+static u_int32_t short_hashcred(const char *, u_int);
+static void short_touch(struct short_stripe *, struct short_ent *);
+static void short_insert(struct svc_req *, const struct area *, const char *, u_int);
+static void short_copy(struct area *, const struct area *);
+
 /*
  * Unix longhand authenticator
  */
@@ -70,11 +145,7 @@ _svcauth_unix(struct svc_req *rqst, struct rpc_msg *msg)
 	XDR xdrs;
 	struct authunix_parms *aup;
 	int32_t *buf;
-	struct area {
-		struct authunix_parms area_aup;
-		char area_machname[MAX_MACHINE_NAME+1];
-		int area_gids[NGRPS];
-	} *area;
+	struct area *area;
 	u_int auth_len;
 	size_t str_len, gid_len, i;
 
@@ -129,20 +200,206 @@ _svcauth_unix(struct svc_req *rqst, struct rpc_msg *msg)
 	}
 	rqst->rq_xprt->xp_verf.oa_flavor = AUTH_NULL;
 	rqst->rq_xprt->xp_verf.oa_length = 0;
+	short_insert(rqst, area, msg->rm_call.cb_cred.oa_base, auth_len);
 	stat = AUTH_OK;
 done:
 	XDR_DESTROY(&xdrs);
 	return (stat);
 }
 
+static u_int32_t
+short_hashcred(const char *cred, u_int len)
+{
+	u_int32_t hash = 2166136261U;	/* FNV-1a */
+
+	while (len--)
+		hash = (hash ^ (u_char)*cred++) * 16777619U;
+	return (hash);
+}
+
+/*
+ * Move the entry to the head of its stripe's LRU list.
+ */
+static void
+short_touch(struct short_stripe *st, struct short_ent *ent)
+{
+	if (st->lru == ent)
+		return;
+	if (ent->next != NULL) {		/* unlink */
+		ent->prev->next = ent->next;
+		ent->next->prev = ent->prev;
+	}
+	if (st->lru == NULL) {
+		ent->prev = ent->next = ent;
+	} else {
+		ent->next = st->lru;
+		ent->prev = st->lru->prev;
+		st->lru->prev->next = ent;
+		st->lru->prev = ent;
+	}
+	st->lru = ent;
+}
+
+static void
+short_copy(struct area *dst, const struct area *src)
+{
+	dst->area_aup = src->area_aup;
+	dst->area_aup.aup_machname = dst->area_machname;
+	dst->area_aup.aup_gids = dst->area_gids;
+	(void)memcpy(dst->area_machname, src->area_machname,
+	    sizeof(dst->area_machname));
+	(void)memcpy(dst->area_gids, src->area_gids,
+	    src->area_aup.aup_len * sizeof(int));
+}
+
+/*
+ * Draw the shorthand nonce and the stripes' first tags.
+ */
+static void
+short_setup(void)
+{
+	randomid_t ctx;
+	int i;
+
+	ctx = randomid_new(32, RANDOMID_TIMEO_DEFAULT);
+	if (!ctx)
+		abort();
+	short_nonce = randomid(ctx);
+	for (i = 0; i < SHORT_STRIPES; ++i)
+		short_stripes[i].tag = randomid(ctx);
+	randomid_delete(ctx);
+}
+
+/*
+ * Remember a verified longhand credential and return the matching
+ * shorthand to the client as an AUTH_SHORT response verifier.
+ */
+static void
+short_insert(struct svc_req *rqst, const struct area *area, const char *cred,
+    u_int credlen)
+{
+	struct opaque_auth *verf = &rqst->rq_xprt->xp_verf;
+	struct opaque_auth shcred;
+	struct short_cred body;
+	struct short_stripe *st;
+	struct short_ent *ent, **entp;
+	u_int32_t hash, stripe;
+	XDR xdrs;
+
+	if (verf->oa_base == NULL || credlen > MAX_AUTH_BYTES)
+		return;
+
+#ifdef _REENTRANT
+	thr_once(&short_once, short_setup);
+#else
+	if (!short_ready) {
+		short_setup();
+		short_ready = 1;
+	}
+#endif
+	hash = short_hashcred(cred, credlen);
+	stripe = SHORT_STRIPE(hash);
+	st = short_stripes + stripe;
+	mutex_lock(&svcauth_short_lock[stripe]);
+	if (st->ents == NULL) {
+		if ((st->ents = calloc(SHORT_STRIPESZ, sizeof(*st->ents))) == NULL) {
+			mutex_unlock(&svcauth_short_lock[stripe]);
+			return;
+		}
+	}
+
+	for (ent = st->hash[hash & (SHORT_HASHSZ - 1)]; ent; ent = ent->hnext)
+		if (ent->hash == hash && ent->credlen == credlen &&
+		    memcmp(ent->cred, cred, credlen) == 0)
+			break;
+
+	if (ent == NULL) {
+		/*
+		 * Take an unused slot, otherwise reuse the least recently
+		 * used; the new tag retires any shorthand issued for it.
+		 */
+		for (ent = st->ents; ent < st->ents + SHORT_STRIPESZ; ++ent)
+			if (ent->tag == 0)
+				break;
+		if (ent == st->ents + SHORT_STRIPESZ) {
+			ent = st->lru->prev;
+			for (entp = &st->hash[ent->hash & (SHORT_HASHSZ - 1)];
+			    *entp != ent; entp = &(*entp)->hnext)
+				continue;
+			*entp = ent->hnext;
+		}
+		if (++st->tag == 0)
+			st->tag = 1;
+		ent->tag = st->tag;
+		ent->hash = hash;
+		ent->credlen = credlen;
+		(void)memcpy(ent->cred, cred, credlen);
+		short_copy(&ent->area, area);
+		ent->hnext = st->hash[hash & (SHORT_HASHSZ - 1)];
+		st->hash[hash & (SHORT_HASHSZ - 1)] = ent;
+	}
+	short_touch(st, ent);
+	body.index = stripe * SHORT_STRIPESZ + (u_int32_t)(ent - st->ents);
+	body.tag = ent->tag;
+	body.nonce = short_nonce;
+	mutex_unlock(&svcauth_short_lock[stripe]);
+
+	/* the verifier body is itself an opaque_auth, see authunix_validate() */
+	shcred.oa_flavor = AUTH_SHORT;
+	shcred.oa_base = (caddr_t)(void *)&body;
+	shcred.oa_length = sizeof(body);
+	xdrmem_create(&xdrs, verf->oa_base, MAX_AUTH_BYTES, XDR_ENCODE);
+	if (xdr_opaque_auth(&xdrs, &shcred)) {
+		verf->oa_flavor = AUTH_SHORT;
+		verf->oa_length = XDR_GETPOS(&xdrs);
+	}
+	XDR_DESTROY(&xdrs);
+}
+
 
 /*
  * Shorthand unix authenticator
  * Looks up longhand in a cache.
  */
-/*ARGSUSED*/
 enum auth_stat 
 _svcauth_short(struct svc_req *rqst, struct rpc_msg *msg)
 {
-	return (AUTH_REJECTEDCRED);
+	struct opaque_auth *cred = &msg->rm_call.cb_cred;
+	struct short_cred body;
+	struct short_stripe *st;
+	struct short_ent *ent;
+	u_int32_t stripe;
+
+	_DIAGASSERT(rqst != NULL);
+	_DIAGASSERT(msg != NULL);
+
+	if (cred->oa_length != sizeof(body))
+		return (AUTH_REJECTEDCRED);
+	(void)memcpy(&body, cred->oa_base, sizeof(body));
+
+	if (body.index >= SHORT_STRIPES * SHORT_STRIPESZ || body.tag == 0)
+		return (AUTH_REJECTEDCRED);
+	stripe = body.index / SHORT_STRIPESZ;
+	st = short_stripes + stripe;
+	mutex_lock(&svcauth_short_lock[stripe]);
+	ent = st->ents ? st->ents + body.index % SHORT_STRIPESZ : NULL;
+	if (ent == NULL || ent->tag != body.tag || body.nonce != short_nonce) {
+		mutex_unlock(&svcauth_short_lock[stripe]);
+		return (AUTH_REJECTEDCRED);
+	}
+	short_touch(st, ent);
+	short_copy((struct area *)rqst->rq_clntcred, &ent->area);
+
+	/*
+	 * Present the call as AUTH_SYS, restoring the longhand into the
+	 * request's credential buffer (MAX_AUTH_BYTES, see svc_getreq_common),
+	 * so services need not distinguish shorthand callers.
+	 */
+	(void)memcpy(cred->oa_base, ent->cred, ent->credlen);
+	cred->oa_length = ent->credlen;
+	mutex_unlock(&svcauth_short_lock[stripe]);
+
+	cred->oa_flavor = AUTH_SYS;
+	rqst->rq_cred = *cred;
+	return (AUTH_OK);
 }
@@ -47,6 +47,10 @@ __RCSID("$NetBSD: svc_run.c,v 1.28 2017/01/10 17:45:27 christos Exp $");
  */
 #include "namespace.h"
 #include "reentrant.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
 #include <err.h>
 #include <errno.h>
 #include <stdio.h>
@@ -210,9 +214,334 @@ out:
 	free(pfd);
 }
 
+/*
+ * Automatic MT mode, see RPC_SVC_MTMODE_SET.
+ *
+ * One thread waits for input and hands each ready transport to a pool
+ * of workers, which receive, decode, dispatch and reply through
+ * svc_getreq_common().  A transport is not waited on again until its
+ * worker is done with it, so the requests on a connection are still
+ * served and replied to in order; concurrency is across transports.
+ * A datagram service is a single transport, hence is served one
+ * request at a time.
+ *
+ * Workers wake the waiting thread through a loopback datagram socket
+ * when a transport is returned.  Idle connections are cleaned when the
+ * wait times out, as by svc_run_select(), sparing those claimed; see
+ * __svc_mt_busy().
+ */
+#define	SVC_THRMAX_DEFAULT	16
+
+static int svc_mtmode = RPC_SVC_MT_NONE;
+static int svc_thrmax = SVC_THRMAX_DEFAULT;
+
+#ifdef _REENTRANT
+extern mutex_t svc_mt_lock;
+static cond_t svc_mt_cv = COND_INITIALIZER;
+
+/*
+ * Transports waiting for, or being served by, a worker.
+ */
+static struct mt_claim {
+	int	mc_fd;
+	int	mc_busy;		/* worker assigned */
+} *mt_claims;
+static u_int mt_nclaims, mt_maxclaims;
+static int mt_workers;			/* workers started */
+static int mt_wakefd = -1;
+
+/* VARIABLES PROTECTED BY svc_mt_lock: all of the above */
+
+static int
+mt_wakeup_create(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = (socklen_t)sizeof (sin);
+	int fd, one = 1;
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+		return (-1);
+	(void) memset(&sin, 0, sizeof (sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)(void *)&sin, len) == -1 ||
+	    getsockname(fd, (struct sockaddr *)(void *)&sin, &len) == -1 ||
+	    connect(fd, (struct sockaddr *)(void *)&sin, len) == -1) {
+		(void) close(fd);
+		return (-1);
+	}
+#if defined(_WIN32)
+	{	u_long mode = (long)one;
+		ioctlsocket((SOCKET)fd, FIONBIO, &mode);
+	}
+#else
+	ioctl(fd, FIONBIO, (char *)(void *)&one);
+#endif
+	return (fd);
+}
+
+static void *
+mt_worker(void *arg)
+{
+	u_int i;
+	int fd;
+
+	mutex_lock(&svc_mt_lock);
+	for (;;) {
+		for (i = 0; i < mt_nclaims; i++)
+			if (! mt_claims[i].mc_busy)
+				break;
+		if (i == mt_nclaims) {
+			cond_wait(&svc_mt_cv, &svc_mt_lock);
+			continue;
+		}
+		mt_claims[i].mc_busy = TRUE;
+		fd = mt_claims[i].mc_fd;
+		mutex_unlock(&svc_mt_lock);
+
+		svc_getreq_common(fd);
+
+		mutex_lock(&svc_mt_lock);
+		for (i = 0; i < mt_nclaims; i++)
+			if (mt_claims[i].mc_fd == fd) {
+				mt_claims[i] = mt_claims[--mt_nclaims];
+				break;
+			}
+		(void) write(mt_wakefd, "", 1);
+	}
+	/* NOTREACHED */
+	return (arg);
+}
+
+/*
+ * Start the wakeup socket and workers, once.
+ */
+static bool_t
+mt_start(void)
+{
+	thr_t tid;
+
+	mutex_lock(&svc_mt_lock);
+	if (mt_wakefd == -1 && (mt_wakefd = mt_wakeup_create()) == -1) {
+		mutex_unlock(&svc_mt_lock);
+		return (FALSE);
+	}
+	while (mt_workers < svc_thrmax) {
+		if (thr_create(&tid, NULL, mt_worker, NULL) != 0)
+			break;
+		(void) thr_detach(tid);
+		mt_workers++;
+	}
+	mutex_unlock(&svc_mt_lock);
+	return (mt_workers > 0);
+}
+
+/*
+ * Queue the ready transport for a worker.
+ */
+static bool_t
+mt_claim(int fd)
+{
+	struct mt_claim *claims;
+
+	if (fd == mt_wakefd)
+		return (TRUE);
+	if (mt_nclaims == mt_maxclaims) {
+		claims = realloc(mt_claims,
+		    (mt_maxclaims + 32) * sizeof (*mt_claims));
+		if (claims == NULL)
+			return (FALSE);
+		mt_claims = claims;
+		mt_maxclaims += 32;
+	}
+	mt_claims[mt_nclaims].mc_fd = fd;
+	mt_claims[mt_nclaims].mc_busy = FALSE;
+	mt_nclaims++;
+	return (TRUE);
+}
+
+static void
+svc_run_mt(void)
+{
+	fd_set *readfds;
+	struct timeval timeout;
+	char buf[64];
+	u_int i;
+	int maxfd, fd;
+#if !defined(_WIN32)
+	int fdsize, size;
+#endif
+#ifndef RUMP_RPC
+	int probs = 0;
+#endif
+	extern rwlock_t svc_fd_lock;
+
+	if (! mt_start()) {
+		warn("%s: can't start workers", __func__);
+		svc_run_select();
+		return;
+	}
+
+	readfds = NULL;
+#if !defined(_WIN32)
+	fdsize = 0;
+#endif
+
+	for (;;) {
+		rwlock_rdlock(&svc_fd_lock);
+
+#if defined(_WIN32)
+		maxfd = 0;
+		if (readfds == NULL &&
+		    (readfds = calloc(1, sizeof (fd_set))) == NULL) {
+			rwlock_unlock(&svc_fd_lock);
+			warn("%s: can't copy fdset", __func__);
+			goto out;
+		}
+		memcpy(readfds, svc_fdset_get(), sizeof (fd_set));
+#else
+		maxfd = *svc_fdset_getmax();
+		if (maxfd < mt_wakefd)
+			maxfd = mt_wakefd;
+		size = svc_fdset_getsize(0);
+		if (fdsize != size || readfds == NULL) {
+			free(readfds);
+			fdsize = size;
+			readfds = calloc(1, __NFD_BYTES(maxfd + 1 > size ?
+			    maxfd + 1 : size));
+			if (readfds == NULL) {
+				rwlock_unlock(&svc_fd_lock);
+				warn("%s: can't copy fdset", __func__);
+				goto out;
+			}
+		}
+		memcpy(readfds, svc_fdset_get(), __NFD_BYTES(size));
+#endif //_WIN32
+
+		rwlock_unlock(&svc_fd_lock);
+
+		/* transports with a worker are not waited on */
+		mutex_lock(&svc_mt_lock);
+		for (i = 0; i < mt_nclaims; i++)
+			FD_CLR(mt_claims[i].mc_fd, readfds);
+		mutex_unlock(&svc_mt_lock);
+		FD_SET(mt_wakefd, readfds);
+
+		timeout.tv_sec = 30;
+		timeout.tv_usec = 0;
+		switch (select(maxfd + 1, readfds, NULL, NULL, &timeout)) {
+		case -1:
+#ifndef RUMP_RPC
+			if ((errno == EINTR || errno == EBADF) && probs < 100) {
+				probs++;
+				continue;
+			}
+#endif
+			if (errno == EINTR) {
+				continue;
+			}
+			warn("%s: select failed", __func__);
+			goto out;
+		case 0:
+			__svc_clean_idle(NULL, 30, FALSE);
+			continue;
+		default:
+			if (FD_ISSET(mt_wakefd, readfds))
+				while (read(mt_wakefd, buf, sizeof (buf)) > 0)
+					continue;
+			mutex_lock(&svc_mt_lock);
+#if defined(_WIN32)
+			for (i = 0; i < readfds->fd_count; ++i) {
+				fd = (int)readfds->fd_array[i];
+#else
+			for (fd = 0; fd <= maxfd; ++fd) {
+				if (! FD_ISSET(fd, readfds))
+					continue;
+#endif
+				if (! mt_claim(fd)) {
+					warn("%s: out of memory", __func__);
+					break;
+				}
+			}
+			cond_broadcast(&svc_mt_cv);
+			mutex_unlock(&svc_mt_lock);
+#ifndef RUMP_RPC
+			probs = 0;
+#endif
+		}
+	}
+out:
+	free(readfds);
+}
+#endif /* _REENTRANT */
+
+/*
+ * Whether the transport is queued for, or held by, a worker, hence not
+ * to be destroyed as idle; taken within svc_fd_lock.
+ */
+bool_t
+__svc_mt_busy(int fd)
+{
+#ifdef _REENTRANT
+	bool_t busy = FALSE;
+	u_int i;
+
+	mutex_lock(&svc_mt_lock);
+	for (i = 0; i < mt_nclaims && !busy; i++)
+		busy = (mt_claims[i].mc_fd == fd);
+	mutex_unlock(&svc_mt_lock);
+	return (busy);
+#else
+	return (FALSE);
+#endif
+}
+
+bool_t
+__svc_mt_control(int what, void *arg)
+{
+	int val;
+
+	switch (what) {
+	case RPC_SVC_MTMODE_SET:
+		val = *(int *)arg;
+		if (val == RPC_SVC_MT_NONE) {
+			svc_mtmode = val;
+			return (TRUE);
+		}
+#ifdef _REENTRANT
+		if (val == RPC_SVC_MT_AUTO) {
+			svc_mtmode = val;
+			return (TRUE);
+		}
+#endif
+		return (FALSE);
+	case RPC_SVC_MTMODE_GET:
+		*(int *)arg = svc_mtmode;
+		return (TRUE);
+	case RPC_SVC_THRMAX_SET:
+		val = *(int *)arg;
+		if (val <= 0)
+			return (FALSE);
+		svc_thrmax = val;
+		return (TRUE);
+	case RPC_SVC_THRMAX_GET:
+		*(int *)arg = svc_thrmax;
+		return (TRUE);
+	default:
+		break;
+	}
+	return (FALSE);
+}
+
 LIBRPC_API void
 svc_run(void)
 {
+#ifdef _REENTRANT
+	if (svc_mtmode == RPC_SVC_MT_AUTO) {
+		svc_run_mt();
+		return;
+	}
+#endif
 	(__svc_flags & SVC_FDSET_POLL) ? svc_run_poll() : svc_run_select();
 }
 
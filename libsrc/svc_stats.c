@@ -0,0 +1,185 @@
+/*
+ *  Per-procedure service statistics.
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+/*
+ * The dispatchers generated by rpcgen -T own an array of counters per
+ * program version, indexed by procedure, and register it on their
+ * first request:
+ *
+ *	svc_proccount_reg(prog, vers, counts, nproc);
+ *	...
+ *	svc_proccount_start(&start);
+ *	<decode, call, reply>
+ *	svc_proccount_done(&counts[proc], &start, failed);
+ *
+ * Counters are updated atomically, so workers (see RPC_SVC_MT_AUTO)
+ * need no lock; the registry is read only by rpc_control(), see
+ * RPC_SVC_PROCSTATS_GET and RPC_SVC_PROCSTATS_RESET.
+ */
+
+#include "namespace.h"
+#include "reentrant.h"
+#include <sys/types.h>
+#include <sys/time.h>
+#include <rpc/rpc.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rpc_internal.h"
+
+#if defined(_WIN32)
+#define	PC_COUNT(c)		(void)InterlockedIncrement((volatile LONG *)&(c))
+#define	PC_ADD64(c, v)		(void)InterlockedExchangeAdd64((volatile LONG64 *)&(c), (LONG64)(v))
+#define	PC_LOAD(c)		(c)
+#else
+#define	PC_COUNT(c)		(void)__atomic_add_fetch(&(c), 1, __ATOMIC_RELAXED)
+#define	PC_ADD64(c, v)		(void)__atomic_add_fetch(&(c), (v), __ATOMIC_RELAXED)
+#define	PC_LOAD(c)		__atomic_load_n(&(c), __ATOMIC_RELAXED)
+#endif
+
+/*
+ * A registered program version.
+ */
+struct procstats {
+	struct procstats *next;
+	rpcprog_t	prog;
+	rpcvers_t	vers;
+	struct svc_proccount *counts;	/* [nproc], by procedure */
+	u_int		nproc;
+};
+
+#ifdef _REENTRANT
+extern mutex_t procstats_lock;
+#endif
+static struct procstats *procstats_head;
+
+/* VARIABLES PROTECTED BY procstats_lock: procstats_head */
+
+/*
+ * Register the counters of a program version; repeated registrations
+ * replace the earlier.
+ */
+LIBRPC_API bool_t
+svc_proccount_reg(rpcprog_t prog, rpcvers_t vers,
+    struct svc_proccount *counts, u_int nproc)
+{
+	struct procstats *ps;
+
+	_DIAGASSERT(counts != NULL);
+
+	mutex_lock(&procstats_lock);
+	for (ps = procstats_head; ps; ps = ps->next)
+		if (ps->prog == prog && ps->vers == vers)
+			break;
+	if (ps == NULL) {
+		if ((ps = mem_alloc(sizeof (*ps))) == NULL) {
+			mutex_unlock(&procstats_lock);
+			return (FALSE);
+		}
+		ps->prog = prog;
+		ps->vers = vers;
+		ps->next = procstats_head;
+		procstats_head = ps;
+	}
+	ps->counts = counts;
+	ps->nproc = nproc;
+	mutex_unlock(&procstats_lock);
+	return (TRUE);
+}
+
+/*
+ * Start timing a request.
+ */
+LIBRPC_API void
+svc_proccount_start(struct timeval *start)
+{
+	__rpc_clock(start);
+}
+
+/*
+ * Account a request, timed from start.
+ */
+LIBRPC_API void
+svc_proccount_done(struct svc_proccount *pc, const struct timeval *start,
+    bool_t failed)
+{
+	struct timeval now;
+	int64_t usecs;
+
+	__rpc_clock(&now);
+	usecs = (int64_t)(now.tv_sec - start->tv_sec) * 1000000 +
+	    (now.tv_usec - start->tv_usec);
+	PC_COUNT(pc->pc_calls);
+	if (failed)
+		PC_COUNT(pc->pc_errors);
+	if (usecs > 0)
+		PC_ADD64(pc->pc_usecs, (uint64_t)usecs);
+}
+
+/*
+ * rpc_control() operations: RPC_SVC_PROCSTATS_GET, RPC_SVC_PROCSTATS_RESET.
+ */
+bool_t
+__svc_proccount_control(int what, void *arg)
+{
+	struct svc_procstats *stats = arg;
+	struct svc_proccount *pc;
+	struct procstats *ps;
+	bool_t ret = FALSE;
+
+	mutex_lock(&procstats_lock);
+	switch (what) {
+	case RPC_SVC_PROCSTATS_GET:
+		for (ps = procstats_head; ps; ps = ps->next)
+			if (ps->prog == stats->ps_prog &&
+			    ps->vers == stats->ps_vers)
+				break;
+		if (ps == NULL || stats->ps_proc >= ps->nproc)
+			break;
+		pc = &ps->counts[stats->ps_proc];
+		stats->ps_calls = PC_LOAD(pc->pc_calls);
+		stats->ps_errors = PC_LOAD(pc->pc_errors);
+		stats->ps_usecs = PC_LOAD(pc->pc_usecs);
+		ret = TRUE;
+		break;
+
+	case RPC_SVC_PROCSTATS_RESET:
+		/* racing updates may survive; counters are advisory */
+		for (ps = procstats_head; ps; ps = ps->next)
+			if (stats == NULL || (ps->prog == stats->ps_prog &&
+			    ps->vers == stats->ps_vers)) {
+				(void) memset(ps->counts, 0,
+				    ps->nproc * sizeof (*ps->counts));
+				ret = TRUE;
+			}
+		break;
+	}
+	mutex_unlock(&procstats_lock);
+	return (ret);
+}
+
+/*end*/
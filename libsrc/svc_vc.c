@@ -115,7 +115,7 @@ struct cf_conn {  /* kept in xprt->xp_p1 for actual connection */
 	u_int recvsize;
 	int maxrec;
 	bool_t nonblock;
-	struct timeval last_recv_time;
+	struct timeval last_recv_time;	/* __rpc_coarse_clock() */
 };
 
 /*
@@ -386,7 +386,7 @@ again:
 	} else
 		cd->nonblock = FALSE;
 
-	(void)gettimeofday(&cd->last_recv_time, NULL);
+	__rpc_coarse_clock(&cd->last_recv_time);
 
 	return FALSE; /* there is never an rpc msg to be processed */
 out:
@@ -549,7 +549,7 @@ read_vc(caddr_t xprtp, caddr_t buf, int len)
 				goto fatal_err;
 		}
 		if (len != 0)
-			gettimeofday(&cfp->last_recv_time, NULL);
+			__rpc_coarse_clock(&cfp->last_recv_time);
 		return len;
 	}
 
@@ -571,7 +571,7 @@ read_vc(caddr_t xprtp, caddr_t buf, int len)
 	} while ((pollfd.revents & POLLIN) == 0);
 
 	if ((len = (int)read(sock, buf, (size_t)len)) > 0) {
-		gettimeofday(&cfp->last_recv_time, NULL);
+		__rpc_coarse_clock(&cfp->last_recv_time);
 		return len;
 	}
 
@@ -600,7 +600,7 @@ write_vc(caddr_t xprtp, caddr_t buf, int len)
 	cd = (struct cf_conn *)xprt->xp_p1;
 
 	if (cd->nonblock)
-		gettimeofday(&tv0, NULL);
+		__rpc_coarse_clock(&tv0);
 
 	for (cnt = len; cnt > 0; cnt -= i, buf += i) {
 		if ((i = (int)write(xprt->xp_fd, buf, (size_t)cnt)) < 0) {
@@ -616,7 +616,7 @@ write_vc(caddr_t xprtp, caddr_t buf, int len)
 				 *
 				 * XXX 2 is an arbitrary amount.
 				 */
-				gettimeofday(&tv1, NULL);
+				__rpc_coarse_clock(&tv1);
 				if (tv1.tv_sec - tv0.tv_sec >= 2) {
 					cd->strm_stat = XPRT_DIED;
 					return -1;
@@ -783,7 +783,7 @@ __svc_clean_idle(fd_set *fds __unused, int timeout, bool_t cleanblock)
 	struct timeval tv, tdiff, tmax;
 	struct cf_conn *cd;
 
-	gettimeofday(&tv, NULL);
+	__rpc_coarse_clock(&tv);
 	tmax.tv_sec = tmax.tv_usec = 0;
 	least_active = NULL;
 	rwlock_wrlock(&svc_fd_lock);
@@ -807,6 +807,8 @@ __svc_clean_idle(fd_set *fds __unused, int timeout, bool_t cleanblock)
 		cd = (struct cf_conn *)xprt->xp_p1;
 		if (!cleanblock && !cd->nonblock)
 			continue;
+		if (__svc_mt_busy(i))		/* a worker's, see svc_run() */
+			continue;
 
 #if defined(__WATCOMC__)
 #undef timercmp
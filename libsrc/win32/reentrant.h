@@ -75,6 +75,10 @@
 
 #define thr_once(o, f)		pthread_once(o, f)
 
+#define thr_t			pthread_t
+#define thr_create(tp, ta, f, a) pthread_create(tp, ta, f, a)
+#define thr_detach(t)		pthread_detach(t)
+
 #else   /*_REENTRANT*/
 
 #define thread_key_t int
@@ -627,6 +627,31 @@ __xdrrec_setnonblock(XDR *xdrs, int maxrec)
 	return TRUE;
 }
 
+/*
+ * Write out the records completed by xdrrec_endofrecord(xdrs, FALSE),
+ * leaving the record in progress, normally just its reserved header.
+ */
+bool_t
+__xdrrec_flush(XDR *xdrs)
+{
+	RECSTREAM *rstrm = (RECSTREAM *)(xdrs->x_private);
+	uint32_t len, tail;
+
+	len = (uint32_t)((u_long)(rstrm->frag_header) -
+	    (u_long)(rstrm->out_base));
+	if (len == 0)
+		return (TRUE);
+	if ((*(rstrm->writeit))(rstrm->tcp_handle, rstrm->out_base, (int)len)
+		!= (int)len)
+		return (FALSE);
+	tail = (uint32_t)((u_long)(rstrm->out_finger) -
+	    (u_long)(rstrm->frag_header));
+	memmove(rstrm->out_base, rstrm->frag_header, (size_t)tail);
+	rstrm->frag_header = (uint32_t *)(void *)rstrm->out_base;
+	rstrm->out_finger = (char *)rstrm->out_base + tail;
+	return (TRUE);
+}
+
 
 /*
  * Internal useful routines
@@ -0,0 +1,60 @@
+/*
+ *  rpcbench protocol.
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+/*
+ * Fixed benchmark protocol; changing it invalidates earlier results.
+ */
+
+const BENCH_MAXBULK = 1048576;		/* largest bulk transfer */
+const BENCH_TAGLEN = 32;
+
+/*
+ * Small structure, typical of control operations.
+ */
+struct bench_small {
+	int		bs_id;
+	unsigned int	bs_flags;
+	int		bs_values[4];
+	string		bs_tag<BENCH_TAGLEN>;
+};
+
+typedef opaque bench_bulk<BENCH_MAXBULK>;
+
+program RPCBENCH_PROG {
+	version RPCBENCH_VERS {
+		void
+		BENCHPROC_NULL(void) = 0;
+
+		bench_small
+		BENCHPROC_ECHO(bench_small) = 1;
+
+		unsigned int			/* bulk upload, returns length */
+		BENCHPROC_SINK(bench_bulk) = 2;
+
+		bench_bulk			/* bulk download */
+		BENCHPROC_SOURCE(unsigned int) = 3;
+	} = 1;
+} = 0x40424e43;
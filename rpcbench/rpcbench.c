@@ -0,0 +1,600 @@
+/*
+ *  rpcbench - ONC RPC stack benchmarks.
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+/*
+ * Usage: rpcbench [-n calls] [-s bulksize] [-c connections] [-T threads]
+ *	    [-H host] [-o file] [suite ...]
+ *
+ * Suites, by default all in this order:
+ *
+ *	raw	clnt_raw/svc_raw, no transport.
+ *	udp	clnt_dg against an in-process svc_dg on loopback.
+ *	tcp	clnt_vc against an in-process svc_vc on loopback.
+ *	conn	connection scale; connect -c clients, then round robin.
+ *	rpcbind	rpcb_getaddr() against the host's rpcbind, with and
+ *		without the address cache; skipped if not running.
+ *	xid	__rpc_getxid() across -T threads.
+ *
+ * Each test writes one CSV record:
+ *
+ *	suite,test,calls,bytes,seconds,calls_per_sec,usec_per_call,mbytes_per_sec
+ */
+
+#include "namespace.h"
+
+#if defined(_WIN32)
+#include <sys/utypes.h>
+#endif
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <rpc/rpc.h>
+#include <rpc/rpcb_clnt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <errno.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include "libcompat.h"
+#include "getopt.h"
+#include <sthread.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "rpc_internal.h"
+#include "bench.h"
+
+#define	BENCH_RAWBULK	4096		/* clnt_raw buffer is UDPMSGSIZE */
+#define	BENCH_UDPBULK	32768
+#define	BENCH_UDPBUFSZ	65000
+
+struct suite {
+	const char	*name;
+	void		(*run)(void);
+};
+
+static void suite_raw(void);
+static void suite_udp(void);
+static void suite_tcp(void);
+static void suite_conn(void);
+static void suite_rpcbind(void);
+static void suite_xid(void);
+
+static const struct suite suites[] = {
+	{ "raw",	suite_raw },
+	{ "udp",	suite_udp },
+	{ "tcp",	suite_tcp },
+	{ "conn",	suite_conn },
+	{ "rpcbind",	suite_rpcbind },
+	{ "xid",	suite_xid },
+	{ NULL,		NULL }
+};
+
+static u_long ncalls = 10000;		/* -n */
+static u_int bulksize = 65536;		/* -s */
+static u_int nconns = 64;		/* -c */
+static u_int nthreads = 4;		/* -T */
+static const char *rpchost = "localhost"; /* -H */
+static FILE *out;			/* -o */
+
+static struct sockaddr_in udpaddr, tcpaddr;
+static int server_started;
+
+static void usage(void) /*__dead*/;
+static double now(void);
+static void report(const char *, const char *, u_long, double, double);
+static void server_start(void);
+static void *server_thread(void *);
+static CLIENT *client_udp(u_int);
+static CLIENT *client_tcp(void);
+static void run_calls(const char *, const char *, CLIENT *, u_int);
+
+void rpcbench_prog_1(struct svc_req *, SVCXPRT *);	/* bench_svc.c */
+int rpcbench_prog_1_freeresult(SVCXPRT *, xdrproc_t, caddr_t);
+
+int
+main(int argc, char **argv)
+{
+	const struct suite *s;
+	int c, i;
+
+	out = stdout;
+	while ((c = getopt(argc, argv, "c:H:n:o:s:T:")) != -1) {
+		switch (c) {
+		case 'c':
+			nconns = (u_int)strtoul(optarg, NULL, 0);
+			break;
+		case 'H':
+			rpchost = optarg;
+			break;
+		case 'n':
+			ncalls = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			if ((out = fopen(optarg, "w")) == NULL)
+				err(1, "%s", optarg);
+			break;
+		case 's':
+			bulksize = (u_int)strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			nthreads = (u_int)strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (ncalls == 0 || nconns == 0 || nthreads == 0 ||
+	    bulksize == 0 || bulksize > BENCH_MAXBULK)
+		usage();
+
+	(void) fprintf(out, "suite,test,calls,bytes,seconds,"
+	    "calls_per_sec,usec_per_call,mbytes_per_sec\n");
+	for (s = suites; s->name; ++s) {
+		if (argc) {
+			for (i = 0; i < argc; ++i)
+				if (strcmp(argv[i], s->name) == 0)
+					break;
+			if (i == argc)
+				continue;
+		}
+		(*s->run)();
+		(void) fflush(out);
+	}
+	if (out != stdout)
+		(void) fclose(out);
+	return (0);
+}
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "usage: rpcbench [-n calls] [-s bulksize] "
+	    "[-c connections] [-T threads] [-H host] [-o file] [suite ...]\n");
+	(void) fprintf(stderr, "suites: raw udp tcp conn rpcbind xid\n");
+	exit(1);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double)ts.tv_sec + (double)ts.tv_nsec / 1e9);
+}
+
+static void
+report(const char *suite, const char *test, u_long calls, double bytes,
+    double secs)
+{
+	if (secs <= 0)
+		secs = 1e-9;
+	(void) fprintf(out, "%s,%s,%lu,%.0f,%.6f,%.1f,%.3f,%.3f\n",
+	    suite, test, calls, bytes, secs, (double)calls / secs,
+	    secs * 1e6 / (double)calls, bytes / secs / (1024.0 * 1024.0));
+}
+
+/*
+ * Server procedures.
+ */
+bool_t
+benchproc_null_1_svc(void *argp, char *result, struct svc_req *rqstp)
+{
+	return (TRUE);
+}
+
+bool_t
+benchproc_echo_1_svc(bench_small *argp, bench_small *result,
+    struct svc_req *rqstp)
+{
+	*result = *argp;
+	result->bs_tag = strdup(argp->bs_tag);
+	return (result->bs_tag != NULL);
+}
+
+bool_t
+benchproc_sink_1_svc(bench_bulk *argp, u_int *result, struct svc_req *rqstp)
+{
+	*result = argp->bench_bulk_len;
+	return (TRUE);
+}
+
+bool_t
+benchproc_source_1_svc(u_int *argp, bench_bulk *result, struct svc_req *rqstp)
+{
+	static char *buf;
+	static u_int buflen;
+
+	if (*argp > BENCH_MAXBULK)
+		return (FALSE);
+	if (*argp > buflen) {		/* the server is single threaded */
+		free(buf);
+		if ((buf = calloc(1, *argp)) == NULL) {
+			buflen = 0;
+			return (FALSE);
+		}
+		buflen = *argp;
+	}
+	result->bench_bulk_len = *argp;
+	result->bench_bulk_val = buf;
+	return (TRUE);
+}
+
+int
+rpcbench_prog_1_freeresult(SVCXPRT *transp, xdrproc_t xdr_result,
+    caddr_t result)
+{
+	if (xdr_result == (xdrproc_t)xdr_bench_small)
+		(void) xdr_free(xdr_result, result);
+	return (1);			/* source results are static */
+}
+
+/*
+ * In-process loopback servers, serviced by svc_run() in a thread.
+ */
+static void
+server_start(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len;
+	SVCXPRT *xprt;
+	pthread_t tid;
+	int fd;
+
+	if (server_started)
+		return;
+	server_started = 1;
+
+	(void) memset(&sin, 0, sizeof (sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0 ||
+	    bind(fd, (struct sockaddr *)&sin, sizeof (sin)) < 0)
+		err(1, "udp socket");
+	len = sizeof (udpaddr);
+	(void) getsockname(fd, (struct sockaddr *)&udpaddr, &len);
+	if ((xprt = svc_dg_create(fd, BENCH_UDPBUFSZ, BENCH_UDPBUFSZ)) == NULL ||
+	    ! svc_reg(xprt, RPCBENCH_PROG, RPCBENCH_VERS, rpcbench_prog_1, NULL))
+		errx(1, "cannot create udp service");
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0 ||
+	    bind(fd, (struct sockaddr *)&sin, sizeof (sin)) < 0 ||
+	    listen(fd, SOMAXCONN) < 0)
+		err(1, "tcp socket");
+	len = sizeof (tcpaddr);
+	(void) getsockname(fd, (struct sockaddr *)&tcpaddr, &len);
+	if ((xprt = svc_vc_create(fd, 0, 0)) == NULL ||
+	    ! svc_reg(xprt, RPCBENCH_PROG, RPCBENCH_VERS, rpcbench_prog_1, NULL))
+		errx(1, "cannot create tcp service");
+
+	if (pthread_create(&tid, NULL, server_thread, NULL) != 0)
+		errx(1, "cannot start server thread");
+}
+
+static void *
+server_thread(void *arg)
+{
+	svc_run();
+	return (NULL);
+}
+
+static CLIENT *
+client_udp(u_int bufsz)
+{
+	struct netbuf nb;
+	CLIENT *clnt;
+	int fd;
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
+		err(1, "udp socket");
+	nb.buf = &udpaddr;
+	nb.len = nb.maxlen = sizeof (udpaddr);
+	if ((clnt = clnt_dg_create(fd, &nb, RPCBENCH_PROG, RPCBENCH_VERS,
+	    bufsz, bufsz)) == NULL)
+		errx(1, "%s", clnt_spcreateerror("udp"));
+	(void) clnt_control(clnt, CLSET_FD_CLOSE, NULL);
+	return (clnt);
+}
+
+static CLIENT *
+client_tcp(void)
+{
+	struct netbuf nb;
+	CLIENT *clnt;
+	int fd;
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0 ||
+	    connect(fd, (struct sockaddr *)&tcpaddr, sizeof (tcpaddr)) < 0)
+		err(1, "tcp connect");
+	nb.buf = &tcpaddr;
+	nb.len = nb.maxlen = sizeof (tcpaddr);
+	if ((clnt = clnt_vc_create(fd, &nb, RPCBENCH_PROG, RPCBENCH_VERS,
+	    0, 0)) == NULL)
+		errx(1, "%s", clnt_spcreateerror("tcp"));
+	(void) clnt_control(clnt, CLSET_FD_CLOSE, NULL);
+	return (clnt);
+}
+
+/*
+ * The common call mix: null latency, small structure round trips and
+ * bulk transfers in each direction.
+ */
+static void
+run_calls(const char *suite, const char *auth, CLIENT *clnt, u_int bulk)
+{
+	bench_small small, sres;
+	bench_bulk barg, bres;
+	char test[32], tag[BENCH_TAGLEN + 1];
+	u_int len, slen;
+	u_long i, nbulk;
+	double t0;
+
+	(void) snprintf(test, sizeof (test), "null%s", auth);
+	t0 = now();
+	for (i = 0; i < ncalls; ++i)
+		if (benchproc_null_1(NULL, NULL, clnt) != RPC_SUCCESS)
+			errx(1, "%s: %s", suite, clnt_sperror(clnt, "null"));
+	report(suite, test, ncalls, 0, now() - t0);
+
+	(void) memset(&small, 0, sizeof (small));
+	(void) memset(tag, 'x', BENCH_TAGLEN);
+	tag[BENCH_TAGLEN] = '\0';
+	small.bs_tag = tag;
+	(void) snprintf(test, sizeof (test), "echo%s", auth);
+	t0 = now();
+	for (i = 0; i < ncalls; ++i) {
+		small.bs_id = (int)i;
+		(void) memset(&sres, 0, sizeof (sres));
+		if (benchproc_echo_1(&small, &sres, clnt) != RPC_SUCCESS)
+			errx(1, "%s: %s", suite, clnt_sperror(clnt, "echo"));
+		(void) clnt_freeres(clnt, (xdrproc_t)xdr_bench_small,
+		    (caddr_t)&sres);
+	}
+	report(suite, test, ncalls, (double)ncalls * 2 * sizeof (small),
+	    now() - t0);
+
+	if (*auth)
+		return;			/* bulk is auth independent */
+
+	/* fewer bulk calls, bounded at 256MB each way */
+	nbulk = ncalls / 10 + 1;
+	if ((double)nbulk * bulk > 256.0 * 1024 * 1024)
+		nbulk = (u_long)(256.0 * 1024 * 1024 / bulk) + 1;
+	if ((barg.bench_bulk_val = calloc(1, bulk)) == NULL)
+		err(1, "bulk");
+	barg.bench_bulk_len = bulk;
+	t0 = now();
+	for (i = 0; i < nbulk; ++i)
+		if (benchproc_sink_1(&barg, &slen, clnt) != RPC_SUCCESS ||
+		    slen != bulk)
+			errx(1, "%s: %s", suite, clnt_sperror(clnt, "sink"));
+	report(suite, "sink", nbulk, (double)nbulk * bulk, now() - t0);
+	free(barg.bench_bulk_val);
+
+	len = bulk;
+	t0 = now();
+	for (i = 0; i < nbulk; ++i) {
+		(void) memset(&bres, 0, sizeof (bres));
+		if (benchproc_source_1(&len, &bres, clnt) != RPC_SUCCESS ||
+		    bres.bench_bulk_len != bulk)
+			errx(1, "%s: %s", suite, clnt_sperror(clnt, "source"));
+		(void) clnt_freeres(clnt, (xdrproc_t)xdr_bench_bulk,
+		    (caddr_t)&bres);
+	}
+	report(suite, "source", nbulk, (double)nbulk * bulk, now() - t0);
+}
+
+static void
+suite_raw(void)
+{
+	SVCXPRT *xprt;
+	CLIENT *clnt;
+
+	if ((xprt = svc_raw_create()) == NULL ||
+	    ! svc_reg(xprt, RPCBENCH_PROG, RPCBENCH_VERS, rpcbench_prog_1, NULL))
+		errx(1, "cannot create raw service");
+	if ((clnt = clnt_raw_create(RPCBENCH_PROG, RPCBENCH_VERS)) == NULL)
+		errx(1, "%s", clnt_spcreateerror("raw"));
+	run_calls("raw", "", clnt,
+	    bulksize < BENCH_RAWBULK ? bulksize : BENCH_RAWBULK);
+	clnt_destroy(clnt);
+}
+
+static void
+suite_udp(void)
+{
+	struct timeval zero = { 0, 0 };
+	CLIENT *clnt;
+	u_long i;
+	double t0;
+
+	server_start();
+	clnt = client_udp(BENCH_UDPBUFSZ);
+	run_calls("udp", "", clnt,
+	    bulksize < BENCH_UDPBULK ? bulksize : BENCH_UDPBULK);
+	auth_destroy(clnt->cl_auth);
+	clnt->cl_auth = authunix_create_default();
+	run_calls("udp", "-sys", clnt, 0);
+	clnt_destroy(clnt);
+
+	/*
+	 * Zero timeout calls return once sent; encode and send cost only.
+	 */
+	clnt = client_udp(0);
+	t0 = now();
+	for (i = 0; i < ncalls; ++i)
+		(void) clnt_call(clnt, BENCHPROC_NULL, (xdrproc_t)xdr_void,
+		    NULL, (xdrproc_t)xdr_void, NULL, zero);
+	report("udp", "oneway", ncalls, 0, now() - t0);
+	clnt_destroy(clnt);
+}
+
+static void
+suite_tcp(void)
+{
+	CLIENT *clnt;
+
+	server_start();
+	clnt = client_tcp();
+	run_calls("tcp", "", clnt, bulksize);
+	auth_destroy(clnt->cl_auth);
+	clnt->cl_auth = authunix_create_default();
+	run_calls("tcp", "-sys", clnt, 0);
+	clnt_destroy(clnt);
+}
+
+static void
+suite_conn(void)
+{
+	CLIENT **clnts;
+	u_long i;
+	u_int c;
+	double t0;
+
+	server_start();
+	if ((clnts = calloc(nconns, sizeof (*clnts))) == NULL)
+		err(1, "conn");
+	t0 = now();
+	for (c = 0; c < nconns; ++c) {
+		clnts[c] = client_tcp();
+		if (benchproc_null_1(NULL, NULL, clnts[c]) != RPC_SUCCESS)
+			errx(1, "conn: %s", clnt_sperror(clnts[c], "null"));
+	}
+	report("conn", "connect", nconns, 0, now() - t0);
+
+	t0 = now();
+	for (i = 0; i < ncalls; ++i) {
+		c = (u_int)(i % nconns);
+		if (benchproc_null_1(NULL, NULL, clnts[c]) != RPC_SUCCESS)
+			errx(1, "conn: %s", clnt_sperror(clnts[c], "null"));
+	}
+	report("conn", "null-rr", ncalls, 0, now() - t0);
+
+	t0 = now();
+	for (c = 0; c < nconns; ++c)
+		clnt_destroy(clnts[c]);
+	report("conn", "close", nconns, 0, now() - t0);
+	free(clnts);
+}
+
+static void
+suite_rpcbind(void)
+{
+	struct sockaddr_storage ss;
+	struct netconfig *nconf;
+	struct netbuf nb;
+	const char *test;
+	u_long i;
+	int pass;
+	double t0;
+
+	if ((nconf = getnetconfigent("udp")) == NULL) {
+		warnx("rpcbind: no udp transport, skipped");
+		return;
+	}
+	nb.buf = &ss;
+	nb.maxlen = sizeof (ss);
+	if (! rpcb_getaddr(RPCBPROG, RPCBVERS, nconf, &nb, rpchost)) {
+		warnx("rpcbind: %s, skipped", clnt_spcreateerror(rpchost));
+		freenetconfigent(nconf);
+		return;
+	}
+
+	for (pass = 0; pass < 2; ++pass) {
+		test = pass ? "getaddr-nocache" : "getaddr";
+		t0 = now();
+		for (i = 0; i < ncalls; ++i) {
+			if (pass)
+				(void) rpc_control(RPC_CLNT_RPCBCACHE_FLUSH, NULL);
+			if (! rpcb_getaddr(RPCBPROG, RPCBVERS, nconf, &nb, rpchost))
+				errx(1, "rpcbind: %s", clnt_spcreateerror(rpchost));
+		}
+		report("rpcbind", test, ncalls, 0, now() - t0);
+	}
+	freenetconfigent(nconf);
+}
+
+struct xid_arg {
+	u_long		count;
+	u_int32_t	sum;		/* defeats the optimizer */
+};
+
+static void *
+xid_thread(void *arg)
+{
+	struct xid_arg *xa = arg;
+	u_int32_t sum = 0;
+	u_long i;
+
+	for (i = 0; i < xa->count; ++i)
+		sum += __rpc_getxid();
+	xa->sum = sum;
+	return (NULL);
+}
+
+static void
+suite_xid(void)
+{
+	struct xid_arg *args;
+	pthread_t *tids;
+	u_long count = ncalls * 100;
+	char test[32];
+	u_int t, n;
+	double t0;
+
+	if ((args = calloc(nthreads, sizeof (*args))) == NULL ||
+	    (tids = calloc(nthreads, sizeof (*tids))) == NULL)
+		err(1, "xid");
+	for (n = 1;; n = (n * 2 < nthreads ? n * 2 : nthreads)) {
+		t0 = now();
+		for (t = 0; t < n; ++t) {
+			args[t].count = count;
+			if (pthread_create(&tids[t], NULL, xid_thread,
+			    &args[t]) != 0)
+				errx(1, "xid: cannot start thread");
+		}
+		for (t = 0; t < n; ++t)
+			(void) pthread_join(tids[t], NULL);
+		(void) snprintf(test, sizeof (test), "getxid-%u", n);
+		report("xid", test, count * n, 0, now() - t0);
+		if (n == nthreads)
+			break;
+	}
+	free(tids);
+	free(args);
+}
+
+/*end*/
@@ -0,0 +1,148 @@
+#!/usr/bin/perl -w
+# -*- mode: perl; -*-
+# $Id: rpcgenbench.pl,v 1.1 2022/06/18 09:12:40 cvsuser Exp $
+# rpcgen compile-time benchmark
+#
+# Copyright (c) 2022, Adam Young.
+# All rights reserved.
+#
+# This file is part of oncrpc4-win32.
+#
+# The applications are free software: you can redistribute it
+# and/or modify it under the terms of the oncrpc4-win32 License.
+#
+# Redistributions of source code must retain the above copyright
+# notice, and must be distributed with the license document above.
+#
+# Redistributions in binary form must reproduce the above copyright
+# notice, and must include the license document above in
+# the documentation and/or other materials provided with the
+# distribution.
+#
+# This project is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the Licence for details.
+# ==end==
+#
+# Generates the header, XDR routines and client and server stubs of
+# each input, as a build would:
+#
+#   single      one rpcgen invocation per output.
+#   multiple    one invocation, parsing each input once (-c -h -l -m).
+#   parallel    ... by --jobs processes (-j).
+#   update      ... again, with nothing changed (-u).
+#
+# usage: rpcgenbench.pl [--rpcgen path] [--jobs n] [--reps n]
+#               [--flags "..."] [--dir scratch] file.x ...
+#
+
+use strict;
+use warnings 'all';
+use Getopt::Long;
+use File::Path qw(mkpath rmtree);
+use File::Spec;
+use Cwd;
+use Time::HiRes qw(time);
+
+my $rpcgen  = 'rpcgen';
+my $jobs    = 4;
+my $reps    = 3;
+my $flags   = '';
+my $dir     = 'rpcgenbench.tmp';
+
+Usage() if (! GetOptions(
+                'rpcgen=s'  => \$rpcgen,
+                'jobs=i'    => \$jobs,
+                'reps=i'    => \$reps,
+                'flags=s'   => \$flags,
+                'dir=s'     => \$dir
+                ) || !scalar @ARGV || $jobs < 1 || $reps < 1);
+
+my @inputs = map { File::Spec->rel2abs($_) } @ARGV;
+my @flags = split(' ', $flags);
+my %outputs = ('-h' => '.h', '-c' => '_xdr.c', '-l' => '_clnt.c', '-m' => '_svc.c');
+
+$rpcgen = File::Spec->rel2abs($rpcgen) if ($rpcgen =~ m/[\/\\]/);
+$dir = File::Spec->rel2abs($dir);
+
+sub
+Usage
+{
+        print "usage: rpcgenbench.pl [--rpcgen path] [--jobs n] [--reps n] [--flags \"...\"] [--dir scratch] file.x ...\n";
+        exit(3);
+}
+
+sub
+Run             # (args ...)
+{
+        system($rpcgen, @_) == 0
+                or die "rpcgenbench: $rpcgen @_: failed\n";
+}
+
+sub
+Single
+{
+        foreach my $x (@inputs) {
+                my ($base) = ((File::Spec->splitpath($x))[2] =~ m/^(.*?)(\.[^.]*)?$/);
+                foreach my $opt (sort keys %outputs) {
+                        Run(@flags, $opt, '-o', $base.$outputs{$opt}, $x);
+                }
+        }
+}
+
+sub
+Multiple        # (jobs, update)
+{
+        my ($n, $update) = @_;
+        my @opts = (@flags, '-j', $n, sort keys %outputs);
+        push @opts, '-u' if ($update);
+        Run(@opts, @inputs);
+}
+
+sub
+Time            # (setup, code)
+{
+        my ($setup, $code) = @_;
+        my $best;
+
+        for (my $i = 0; $i < $reps; ++$i) {
+                &$setup() if ($setup);
+                my $start = time();
+                &$code();
+                my $elapsed = time() - $start;
+                $best = $elapsed if (!defined $best || $elapsed < $best);
+        }
+        return $best;
+}
+
+sub
+Clean
+{
+        unlink(glob('*'));
+}
+
+my $cwd = getcwd();
+
+rmtree($dir);
+mkpath($dir);
+chdir($dir) or die "rpcgenbench: $dir: $!\n";
+
+my @results = (
+        [ 'single',   Time(\&Clean, \&Single) ],
+        [ 'multiple', Time(\&Clean, sub { Multiple(1, 0) }) ],
+        [ 'parallel', Time(\&Clean, sub { Multiple($jobs, 0) }) ],
+        [ 'update',   Time(sub { Clean(); Multiple($jobs, 1) }, sub { Multiple($jobs, 1) }) ]
+        );
+
+chdir($cwd);
+rmtree($dir);
+
+my $base = $results[0][1];
+printf "%d inputs, %d outputs each, best of %d\n", scalar @inputs, scalar keys %outputs, $reps;
+printf "%-10s %10s %8s\n", 'mode', 'seconds', 'speedup';
+foreach my $r (@results) {
+        printf "%-10s %10.3f %7.1fx\n", $r->[0], $r->[1], ($r->[1] > 0 ? $base / $r->[1] : 0);
+}
+
+#end
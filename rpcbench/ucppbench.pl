@@ -0,0 +1,111 @@
+#!/usr/bin/perl -w
+# -*- mode: perl; -*-
+# $Id: ucppbench.pl,v 1.1 2022/06/25 10:02:17 cvsuser Exp $
+# ucpp macro-heavy preprocessing benchmark
+#
+# Copyright (c) 2022, Adam Young.
+# All rights reserved.
+#
+# This file is part of oncrpc4-win32.
+#
+# The applications are free software: you can redistribute it
+# and/or modify it under the terms of the oncrpc4-win32 License.
+#
+# Redistributions of source code must retain the above copyright
+# notice, and must be distributed with the license document above.
+#
+# Redistributions in binary form must reproduce the above copyright
+# notice, and must include the license document above in
+# the documentation and/or other materials provided with the
+# distribution.
+#
+# This project is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the Licence for details.
+# ==end==
+#
+# Generates a source defining --macros object-like and function-like
+# macros, and --lines lines expanding them amongst plain identifiers,
+# with #ifdef/#undef traffic; then times each preprocessor on it, for
+# example rpccpp built with and without MACRO_OPEN_HASH.
+#
+# usage: ucppbench.pl [--macros n] [--lines n] [--reps n]
+#               [--keep file] cpp ...
+#
+
+use strict;
+use warnings 'all';
+use Getopt::Long;
+use File::Spec;
+use Time::HiRes qw(time);
+
+my $macros  = 20000;
+my $lines   = 100000;
+my $reps    = 3;
+my $keep    = undef;
+
+Usage() if (! GetOptions(
+                'macros=i'  => \$macros,
+                'lines=i'   => \$lines,
+                'reps=i'    => \$reps,
+                'keep=s'    => \$keep
+                ) || !scalar @ARGV || $macros < 1 || $lines < 1 || $reps < 1);
+
+my @cpps = @ARGV;
+my $source = defined $keep ? $keep : File::Spec->catfile(File::Spec->tmpdir(), "ucppbench$$.c");
+
+sub
+Usage
+{
+        print "usage: ucppbench.pl [--macros n] [--lines n] [--reps n] [--keep file] cpp ...\n";
+        exit(3);
+}
+
+sub
+Generate
+{
+        open(my $fh, '>', $source) or die "ucppbench: $source: $!\n";
+        for (my $i = 0; $i < $macros; ++$i) {
+                print $fh "#define OBJ_$i ($i)\n";
+                print $fh "#define FN_$i(a, b) ((a) + OBJ_$i * (b))\n";
+        }
+        for (my $i = 0; $i < $lines; ++$i) {
+                my ($a, $b, $c) = (($i * 7919) % $macros, ($i * 104729) % $macros, ($i * 31) % $macros);
+                if ($i % 64 == 0) {
+                        print $fh "#undef OBJ_$c\n#define OBJ_$c ($c + 1)\n";
+                        print $fh "#ifdef FN_$a\nint present_$i;\n#endif\n";
+                }
+                print $fh "int v_$i = FN_$a(OBJ_$b, var_$c) + OBJ_$c + func_$a(id_$b);\n";
+        }
+        close($fh);
+}
+
+sub
+Time            # (cpp)
+{
+        my ($cpp) = @_;
+        my $best;
+
+        for (my $i = 0; $i < $reps; ++$i) {
+                my $start = time();
+                system("\"$cpp\" \"$source\" > " . File::Spec->devnull()) == 0
+                        or die "ucppbench: $cpp: failed\n";
+                my $elapsed = time() - $start;
+                $best = $elapsed if (!defined $best || $elapsed < $best);
+        }
+        return $best;
+}
+
+Generate();
+my @results = map { [ $_, Time($_) ] } @cpps;
+unlink($source) if (! defined $keep);
+
+my $base = $results[0][1];
+printf "%d macros, %d lines, best of %d\n", 2 * $macros, $lines, $reps;
+printf "%-40s %10s %8s\n", 'cpp', 'seconds', 'speedup';
+foreach my $r (@results) {
+        printf "%-40s %10.3f %7.1fx\n", $r->[0], $r->[1], ($r->[1] > 0 ? $base / $r->[1] : 0);
+}
+
+#end
@@ -0,0 +1,337 @@
+/*
+ *  rpcbind access control list.
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+/*
+ * In-process replacement for the hosts.allow/hosts.deny lookup.
+ *
+ * Rules are read from the file named by -A, one per line:
+ *
+ *	# action  address[/prefix]  [program|*  [procedure|*]]
+ *	allow	127.0.0.0/8
+ *	deny	10.1.0.0/16	100003
+ *	deny	::/0		*	1
+ *
+ * and compiled into a binary prefix trie per address family.  The
+ * deepest (most specific) prefix holding a rule that matches the
+ * program and procedure decides; on equal prefixes the earlier rule
+ * wins.  A source with no matching rule is allowed.  Decisions are
+ * remembered in a small direct-mapped cache keyed by the source
+ * address, program and procedure; the cache is discarded when the list
+ * is reloaded (SIGHUP).
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <rpc/rpc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "rpcbind.h"
+
+#define	ACL_ANY		(~(u_int32_t)0)	/* wildcard program/procedure */
+#define	ACL_CACHESZ	1024		/* decision cache slots, power of 2 */
+
+struct acl_rule {
+	struct acl_rule *next;
+	int allow;
+	u_int32_t prog;
+	u_int32_t proc;
+};
+
+struct acl_node {
+	struct acl_node *child[2];
+	struct acl_rule *rules;		/* rules anchored at this prefix */
+};
+
+struct acl_cache {
+	u_int32_t gen;			/* 0 = empty */
+	int family;
+	u_int8_t addr[16];
+	u_int32_t prog;
+	u_int32_t proc;
+	int allow;
+};
+
+static struct acl_node *acl_inet;	/* AF_INET trie */
+#ifdef INET6
+static struct acl_node *acl_inet6;	/* AF_INET6 trie */
+#endif
+static struct acl_cache acl_cache[ACL_CACHESZ];
+static u_int32_t acl_gen = 1;
+static const char *acl_file;
+static volatile sig_atomic_t acl_reload;
+
+static void acl_free(struct acl_node *);
+static int acl_insert(struct acl_node **, const u_int8_t *, int, struct acl_rule *);
+static int acl_parse(char *, int, struct acl_node **, struct acl_node **);
+static int acl_lookup(const struct acl_node *, const u_int8_t *, int, u_int32_t, u_int32_t);
+
+static void
+acl_free(struct acl_node *node)
+{
+	struct acl_rule *rule;
+
+	if (node == NULL)
+		return;
+	acl_free(node->child[0]);
+	acl_free(node->child[1]);
+	while ((rule = node->rules) != NULL) {
+		node->rules = rule->next;
+		free(rule);
+	}
+	free(node);
+}
+
+/*
+ * Anchor the rule at the node for addr/bits, creating the path as
+ * required; rules are appended so file order is retained.
+ */
+static int
+acl_insert(struct acl_node **root, const u_int8_t *addr, int bits,
+    struct acl_rule *rule)
+{
+	struct acl_node **np = root;
+	struct acl_rule **rp;
+	int i;
+
+	for (i = 0;; ++i) {
+		if (*np == NULL && (*np = calloc(1, sizeof(**np))) == NULL)
+			return -1;
+		if (i == bits)
+			break;
+		np = &(*np)->child[(addr[i >> 3] >> (7 - (i & 7))) & 1];
+	}
+	for (rp = &(*np)->rules; *rp; rp = &(*rp)->next)
+		continue;
+	*rp = rule;
+	return 0;
+}
+
+static int
+acl_number(const char *word, u_int32_t *value)
+{
+	char *ep;
+
+	if (strcmp(word, "*") == 0) {
+		*value = ACL_ANY;
+		return 0;
+	}
+	*value = (u_int32_t)strtoul(word, &ep, 0);
+	return (*word == '\0' || *ep != '\0') ? -1 : 0;
+}
+
+/*
+ * Compile a single line; returns -1 on a syntax error.
+ */
+static int
+acl_parse(char *line, int lineno, struct acl_node **inet, struct acl_node **inet6)
+{
+	char *words[4], *cp, *slash;
+	u_int8_t addr[16];
+	struct acl_rule *rule;
+	int nwords = 0, family, maxbits, bits;
+
+	if ((cp = strchr(line, '#')) != NULL)
+		*cp = '\0';
+	for (cp = strtok(line, " \t\r\n"); cp && nwords < 4;
+	    cp = strtok(NULL, " \t\r\n"))
+		words[nwords++] = cp;
+	if (nwords == 0)
+		return 0;			/* blank or comment */
+	if (nwords < 2 || cp != NULL)
+		goto bad;
+
+	if ((rule = calloc(1, sizeof(*rule))) == NULL) {
+		syslog(LOG_ERR, "%s: Cannot allocate memory", __func__);
+		return -1;
+	}
+	rule->prog = rule->proc = ACL_ANY;
+	if (strcasecmp(words[0], "allow") == 0)
+		rule->allow = 1;
+	else if (strcasecmp(words[0], "deny") != 0)
+		goto badrule;
+	if ((nwords > 2 && acl_number(words[2], &rule->prog) != 0) ||
+	    (nwords > 3 && acl_number(words[3], &rule->proc) != 0))
+		goto badrule;
+
+	if ((slash = strchr(words[1], '/')) != NULL)
+		*slash++ = '\0';
+	if (inet_pton(AF_INET, words[1], addr) == 1) {
+		family = AF_INET, maxbits = 32;
+#ifdef INET6
+	} else if (inet_pton(AF_INET6, words[1], addr) == 1) {
+		family = AF_INET6, maxbits = 128;
+#endif
+	} else {
+		goto badrule;
+	}
+	bits = maxbits;
+	if (slash) {
+		char *ep;
+
+		bits = (int)strtol(slash, &ep, 10);
+		if (*slash == '\0' || *ep != '\0' || bits < 0 || bits > maxbits)
+			goto badrule;
+	}
+	if (acl_insert(family == AF_INET ? inet : inet6, addr, bits, rule) != 0) {
+		syslog(LOG_ERR, "%s: Cannot allocate memory", __func__);
+		free(rule);
+		return -1;
+	}
+	return 0;
+
+badrule:
+	free(rule);
+bad:
+	syslog(LOG_ERR, "%s, line %d: syntax error", acl_file, lineno);
+	return -1;
+}
+
+/*
+ * (Re)compile the access list; on error the current list is retained.
+ */
+int
+acl_load(const char *filename)
+{
+	struct acl_node *inet = NULL, *inet6 = NULL;
+	char line[256];
+	int lineno = 0, ret = 0;
+	FILE *fp;
+
+	if (filename)
+		acl_file = filename;
+	if (acl_file == NULL)
+		return 0;
+	if ((fp = fopen(acl_file, "r")) == NULL) {
+		syslog(LOG_ERR, "Cannot open `%s' (%m)", acl_file);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL)
+		if (acl_parse(line, ++lineno, &inet, &inet6) != 0)
+			ret = -1;
+	(void)fclose(fp);
+
+	if (ret != 0) {
+		acl_free(inet);
+		acl_free(inet6);
+		return ret;
+	}
+	acl_free(acl_inet);
+	acl_inet = inet;
+#ifdef INET6
+	acl_free(acl_inet6);
+	acl_inet6 = inet6;
+#endif
+	if (++acl_gen == 0)			/* invalidate cache */
+		acl_gen = 1;
+	return 0;
+}
+
+void
+acl_hangup(int dummy __unused)
+{
+	acl_reload = 1;
+}
+
+static int
+acl_lookup(const struct acl_node *node, const u_int8_t *addr, int maxbits,
+    u_int32_t prog, u_int32_t proc)
+{
+	const struct acl_rule *rule;
+	int allow = 1, i;
+
+	for (i = 0; node; ++i) {
+		for (rule = node->rules; rule; rule = rule->next)
+			if ((rule->prog == ACL_ANY || rule->prog == prog) &&
+			    (rule->proc == ACL_ANY || rule->proc == proc)) {
+				allow = rule->allow;
+				break;
+			}
+		if (i == maxbits)
+			break;
+		node = node->child[(addr[i >> 3] >> (7 - (i & 7))) & 1];
+	}
+	return allow;
+}
+
+/*
+ * Returns non-zero if the source may issue prog/proc.
+ */
+int
+acl_check(const struct sockaddr *sa, rpcprog_t prog, rpcproc_t proc)
+{
+	const struct acl_node *root;
+	const u_int8_t *addr;
+	struct acl_cache *ce;
+	u_int32_t hash;
+	int alen, i;
+
+	if (acl_reload) {
+		acl_reload = 0;
+		(void)acl_load(NULL);
+	}
+
+	switch (sa->sa_family) {
+	case AF_INET:
+		root = acl_inet;
+		addr = (const u_int8_t *)&SA2SINADDR(sa);
+		alen = 4;
+		break;
+#ifdef INET6
+	case AF_INET6:
+		root = acl_inet6;
+		addr = (const u_int8_t *)&SA2SIN6ADDR(sa);
+		alen = 16;
+		break;
+#endif
+	default:
+		return 1;			/* local transports */
+	}
+	if (root == NULL)
+		return 1;
+
+	hash = (u_int32_t)prog * 31 + (u_int32_t)proc;
+	for (i = 0; i < alen; ++i)
+		hash = hash * 31 + addr[i];
+	ce = acl_cache + ((hash ^ (hash >> 16)) & (ACL_CACHESZ - 1));
+	if (ce->gen == acl_gen && ce->family == sa->sa_family &&
+	    ce->prog == prog && ce->proc == proc &&
+	    memcmp(ce->addr, addr, alen) == 0)
+		return ce->allow;
+
+	ce->gen = acl_gen;
+	ce->family = sa->sa_family;
+	(void)memcpy(ce->addr, addr, alen);
+	ce->prog = prog;
+	ce->proc = proc;
+	ce->allow = acl_lookup(root, addr, alen * 8, prog, proc);
+	return ce->allow;
+}
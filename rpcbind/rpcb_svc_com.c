@@ -208,6 +208,9 @@ map_set(RPCB *regp, char *owner)
 	}
 #ifdef PORTMAP
 	(void) add_pmaplist(regp);
+#endif
+#ifdef WARMSTART
+	journal_set(regp, owner);
 #endif
 	return (TRUE);
 }
@@ -282,6 +285,10 @@ map_unset(RPCB *regp, const char *owner)
 #ifdef PORTMAP
 	if (ans)
 		(void) del_pmaplist(regp);
+#endif
+#ifdef WARMSTART
+	if (ans)
+		journal_unset(regp, owner);
 #endif
 	/*
 	 * We return 1 either when the entry was not there or it
@@ -123,6 +123,7 @@ int verboselog = 0;
 static char **hosts = NULL;
 static struct sockaddr **bound_sa;
 static int ipv6_only = 0;
+static const char *aclfile = NULL;
 static int nhosts = 0;
 static int on = 1;
 #ifndef RPCBIND_RUMP
@@ -208,6 +209,9 @@ rpcbind_main(void *arg)
 		errx(EXIT_FAILURE, "Sorry. You are not superuser\n");
 #endif
 #endif
+	if (aclfile && acl_load(aclfile) != 0)
+		errx(EXIT_FAILURE, "could not load access list `%s'", aclfile);
+
 	nc_handle = setnetconfig(); 	/* open netconfig file */
 	if (nc_handle == NULL)
 		errx(EXIT_FAILURE, "could not read /etc/netconfig");
@@ -244,7 +248,7 @@ rpcbind_main(void *arg)
 	/* ignore others that could get sent */
 	(void) signal(SIGPIPE, SIG_IGN);
 #ifndef RPCBIND_RUMP
-	(void) signal(SIGHUP,  SIG_IGN);
+	(void) signal(SIGHUP,  aclfile ? acl_hangup : SIG_IGN);
 #endif
 	(void) signal(SIGUSR1, SIG_IGN);
 	(void) signal(SIGUSR2, SIG_IGN);
@@ -254,6 +258,7 @@ rpcbind_main(void *arg)
 	if (warmstart) {
 		read_warmstart();
 	}
+	write_warmstart();	/* Snapshot and start the journal */
 #endif
 	if (debugging) {
 		printf("rpcbind debugging enabled.");
@@ -951,11 +956,14 @@ parseargs(int argc, char * const argv[])
 #else
 #define WRAPOP	""
 #endif
-	while ((c = getopt(argc, argv, "6adh:iLls" WRAPOP WSOP)) != -1) {
+	while ((c = getopt(argc, argv, "6A:adh:iLls" WRAPOP WSOP)) != -1) {
 		switch (c) {
 		case '6':
 			ipv6_only = 1;
 			break;
+		case 'A':
+			aclfile = optarg;
+			break;
 		case 'a':
 			doabort = 1;	/* when debugging, do an abort on */
 			break;		/* errors; for rpcbind developers */
@@ -997,7 +1005,7 @@ parseargs(int argc, char * const argv[])
 		default:	/* error */
 			fprintf(stderr,	"usage: rpcbind [-Idwils]\n");
 			fprintf(stderr,
-			    "Usage: %s [-6adiLls%s%s] [-h bindip]\n",
+			    "Usage: %s [-6adiLls%s%s] [-A aclfile] [-h bindip]\n",
 			    getprogname(), WRAPOP, WSOP);
 			exit(EXIT_FAILURE);
 		}
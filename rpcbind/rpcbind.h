@@ -138,12 +138,18 @@ int check_callit(SVCXPRT *, struct r_rmtcall_args *, int);
 void logit(int, struct sockaddr *, rpcproc_t, rpcprog_t, const char *);
 int is_loopback(struct netbuf *);
 
+int acl_load(const char *);
+int acl_check(const struct sockaddr *, rpcprog_t, rpcproc_t);
+void acl_hangup(int);
+
 #ifdef PORTMAP
 extern void pmap_service(struct svc_req *, SVCXPRT *);
 #endif
 
 void write_warmstart(void);
 void read_warmstart(void);
+void journal_set(RPCB *, const char *);
+void journal_unset(RPCB *, const char *);
 
 char *addrmerge(struct netbuf *caller, char *serv_uaddr, char *clnt_uaddr,
     const char *netid);
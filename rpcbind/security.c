@@ -19,6 +19,13 @@
 #endif
 #include <syslog.h>
 #include <netdb.h>
+#include <time.h>
+#if defined(_WIN32)
+#include <sthread.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 /*
  * XXX for special case checks in check_callit.
@@ -122,6 +129,12 @@ check_access(SVCXPRT *xprt, rpcproc_t proc, void *args, unsigned int rpcbvers)
 		break;
 	}
 
+	if (!acl_check(addr, prog, proc)) {
+		logit(log_severity, addr, proc, prog,
+		    ": request denied by access list");
+		return 0;
+	}
+
 #ifdef LIBWRAP
 	if (libwrap && addr->sa_family != AF_LOCAL) {
 		request_init(&req, RQ_DAEMON, "rpcbind", RQ_CLIENT_SIN, addr,
@@ -175,14 +188,285 @@ is_loopback(struct netbuf *nbuf)
 }
 
 
+/*
+ * Security events are queued to a background thread, which performs the
+ * name lookups and syslog() outside the request path.  Beyond LOG_BURST
+ * events per (source address, program, procedure) within LOG_WINDOW
+ * seconds, repeats are only counted; the count is reported with the next
+ * message logged for that source, or with the last repeat when the bucket
+ * is taken over by another source.  Events arriving while the queue is full
+ * are dropped and likewise counted.
+ *
+ * The queue is a bounded ring: producers reserve a slot by advancing
+ * log_head atomically, then publish it through the slot sequence, which
+ * the logger follows (see logit_queue()).  The mutex only parks an idle
+ * logger; buckets are held by a per-bucket spin flag.
+ */
+#define	LOG_RINGSZ	256		/* queued events, power of 2 */
+#define	LOG_BUCKETS	512		/* rate-limit buckets, power of 2 */
+#define	LOG_WINDOW	60		/* seconds */
+#define	LOG_BURST	8		/* events per bucket per window */
+
+#if defined(_WIN32)
+#define	LOG_LOAD(p)		((unsigned)InterlockedCompareExchange((volatile LONG *)(p), 0, 0))
+#define	LOG_STORE(p, v)		(void)InterlockedExchange((volatile LONG *)(p), (LONG)(v))
+#define	LOG_XCHG(p, v)		((unsigned)InterlockedExchange((volatile LONG *)(p), (LONG)(v)))
+#define	LOG_CAS(p, o, n)	(InterlockedCompareExchange((volatile LONG *)(p), (LONG)(n), (LONG)(o)) == (LONG)(o))
+#define	LOG_ADD(p, v)		(void)InterlockedExchangeAdd((volatile LONG *)(p), (LONG)(v))
+#define	LOG_YIELD()		Sleep(0)
+#else
+#define	LOG_LOAD(p)		__atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define	LOG_STORE(p, v)		__atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define	LOG_XCHG(p, v)		__atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define	LOG_CAS(p, o, n)	__sync_bool_compare_and_swap((p), (o), (n))
+#define	LOG_ADD(p, v)		(void)__atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#define	LOG_YIELD()		sched_yield()
+#endif
+
+struct logevent {
+	int severity;
+	struct sockaddr_storage addr;
+	rpcproc_t procnum;
+	rpcprog_t prognum;
+	unsigned suppressed;
+	unsigned dropped;
+	char text[64];
+};
+
+struct logslot {
+	volatile unsigned seq;		/* pos when free, pos + 1 when queued */
+	struct logevent ev;
+};
+
+struct logkey {			/* source, sans port, and call */
+	int family;
+	unsigned char addr[16];
+	rpcprog_t prognum;
+	rpcproc_t procnum;
+};
+
+struct logbucket {
+	volatile unsigned busy;
+	struct logkey key;
+	time_t window;
+	unsigned count;
+	unsigned suppressed;
+	struct logevent last;		/* latest suppressed */
+};
+
+static struct logslot log_ring[LOG_RINGSZ];
+static volatile unsigned log_head, log_dropped, log_waiting;
+static struct logbucket log_buckets[LOG_BUCKETS];
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static int log_threaded;
+
+static u_int32_t logit_key(struct logkey *, const struct sockaddr *,
+    rpcprog_t, rpcproc_t);
+static void logit_queue(const struct logevent *);
+static void logit_write(const struct logevent *);
+static void *logit_thread(void *);
+
+static void
+logit_init(void)
+{
+	pthread_attr_t attr;
+	pthread_t tid;
+	unsigned i;
+
+	for (i = 0; i < LOG_RINGSZ; ++i)
+		log_ring[i].seq = i;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&tid, &attr, logit_thread, NULL) == 0)
+		log_threaded = 1;
+	else
+		syslog(LOG_ERR, "%s: cannot create logger, logging inline", __func__);
+	pthread_attr_destroy(&attr);
+}
+
+/*
+ * The logger; it is the only consumer, so the tail is its own.  Before
+ * waiting it raises log_waiting and re-examines the slot, so that either
+ * it sees the event or the producer sees the flag and signals.
+ */
+static void *
+logit_thread(void *arg __unused)
+{
+	struct logslot *slot;
+	struct logevent ev;
+	unsigned tail = 0;
+
+	for (;;) {
+		slot = log_ring + (tail & (LOG_RINGSZ - 1));
+		if (LOG_LOAD(&slot->seq) != tail + 1) {
+			pthread_mutex_lock(&log_lock);
+			LOG_STORE(&log_waiting, 1);
+			while (LOG_LOAD(&slot->seq) != tail + 1)
+				pthread_cond_wait(&log_cond, &log_lock);
+			LOG_STORE(&log_waiting, 0);
+			pthread_mutex_unlock(&log_lock);
+		}
+		ev = slot->ev;
+		LOG_STORE(&slot->seq, tail + LOG_RINGSZ);
+		++tail;
+		logit_write(&ev);
+	}
+	/*NOTREACHED*/
+	return NULL;
+}
+
+/*
+ * Queue an event or, when the ring is full, count it as dropped along
+ * with the repeats it reports.
+ */
+static void
+logit_queue(const struct logevent *ev)
+{
+	struct logslot *slot;
+	unsigned pos, seq;
+
+	if (!log_threaded) {		/* no logger thread, inline */
+		struct logevent t_ev = *ev;
+
+		t_ev.dropped = LOG_XCHG(&log_dropped, 0);
+		logit_write(&t_ev);
+		return;
+	}
+
+	pos = LOG_LOAD(&log_head);
+	for (;;) {
+		slot = log_ring + (pos & (LOG_RINGSZ - 1));
+		seq = LOG_LOAD(&slot->seq);
+		if (seq == pos) {
+			if (LOG_CAS(&log_head, pos, pos + 1))
+				break;		/* reserved */
+		} else if ((int)(seq - pos) < 0) {
+			LOG_ADD(&log_dropped, 1 + ev->suppressed);
+			return;
+		}
+		pos = LOG_LOAD(&log_head);
+	}
+	slot->ev = *ev;
+	slot->ev.dropped = LOG_XCHG(&log_dropped, 0);
+	LOG_STORE(&slot->seq, pos + 1);	/* publish */
+
+	if (LOG_LOAD(&log_waiting)) {
+		pthread_mutex_lock(&log_lock);
+		pthread_cond_signal(&log_cond);
+		pthread_mutex_unlock(&log_lock);
+	}
+}
+
+/*
+ * The rate limiting key of an event, and its hash.  The port is left
+ * out, so that a source cannot escape suppression by changing it.
+ */
+static u_int32_t
+logit_key(struct logkey *key, const struct sockaddr *addr,
+    rpcprog_t prognum, rpcproc_t procnum)
+{
+	const unsigned char *cp = (const unsigned char *)key;
+	u_int32_t hash = 2166136261U;
+	size_t i;
+
+	(void)memset(key, 0, sizeof(*key));
+	key->family = addr->sa_family;
+	switch (addr->sa_family) {
+	case AF_INET:
+		(void)memcpy(key->addr,
+		    &((const struct sockaddr_in *)addr)->sin_addr,
+		    sizeof(struct in_addr));
+		break;
+#ifdef INET6
+	case AF_INET6:
+		(void)memcpy(key->addr,
+		    &((const struct sockaddr_in6 *)addr)->sin6_addr,
+		    sizeof(struct in6_addr));
+		break;
+#endif
+	default:			/* local */
+		break;
+	}
+	key->prognum = prognum;
+	key->procnum = procnum;
+
+	for (i = 0; i < sizeof(*key); ++i)
+		hash = (hash ^ cp[i]) * 16777619U;
+	return (hash);
+}
+
 /* logit - report events of interest via the syslog daemon */
 void
 logit(int severity, struct sockaddr *addr, rpcproc_t procnum, rpcprog_t prognum, const char *text)
 {
+	const size_t addrlen = SOCKLEN_SOCKADDR_PTR(addr);
+	struct logbucket *bucket;
+	struct logevent ev, evicted;
+	struct logkey key;
+	time_t now = time(NULL);
+	u_int32_t hash;
+	int evict = 0, logged;
+
+	hash = logit_key(&key, addr, prognum, procnum);
+
+	(void)memset(&ev, 0, sizeof(ev));
+	ev.severity = severity;
+	(void)memcpy(&ev.addr, addr, addrlen < sizeof(ev.addr) ? addrlen : sizeof(ev.addr));
+	ev.procnum = procnum;
+	ev.prognum = prognum;
+	(void)strlcpy(ev.text, text, sizeof(ev.text));
+
+	(void)pthread_once(&log_once, logit_init);
+
+	bucket = log_buckets + ((hash ^ (hash >> 16)) & (LOG_BUCKETS - 1));
+	while (LOG_XCHG(&bucket->busy, 1))
+		LOG_YIELD();
+
+	if (memcmp(&bucket->key, &key, sizeof(key)) != 0) {
+		if (bucket->suppressed) {
+			/* report the last repeat of the source evicted */
+			evicted = bucket->last;
+			evicted.suppressed = bucket->suppressed - 1;
+			evict = 1;
+		}
+		bucket->key = key;
+		bucket->window = now;
+		bucket->count = 0;
+		bucket->suppressed = 0;
+	} else if (now - bucket->window >= LOG_WINDOW) {
+		bucket->window = now;
+		bucket->count = 0;
+	}
+	if (++bucket->count > LOG_BURST) {
+		++bucket->suppressed;
+		bucket->last = ev;
+		logged = 0;
+	} else {
+		ev.suppressed = bucket->suppressed;
+		bucket->suppressed = 0;
+		logged = 1;
+	}
+	LOG_STORE(&bucket->busy, 0);
+
+	if (evict)
+		logit_queue(&evicted);
+	if (logged)
+		logit_queue(&ev);
+}
+
+static void
+logit_write(const struct logevent *ev)
+{
+	const struct sockaddr *addr = (const struct sockaddr *)&ev->addr;
+	const rpcproc_t procnum = ev->procnum;
+	const rpcprog_t prognum = ev->prognum;
 	const char *procname;
 	char	procbuf[32];
 	char   *progname;
 	char	progbuf[32];
+	char	suppressed[64] = "";
 	char fromname[NI_MAXHOST] = "unknown"; /*WIN32*/
 	struct rpcent *rpc;
 	static const char *procmap[] = {
@@ -200,54 +484,44 @@ logit(int severity, struct sockaddr *addr, rpcproc_t procnum, rpcprog_t prognum,
 	/* RPCBPROC_GETADDRLIST */	"getaddrlist",
 	/* RPCBPROC_GETSTAT */		"getstat"
 	};
-   
-	/*
-	 * Fork off a process or the portmap daemon might hang while
-	 * getrpcbynumber() or syslog() does its thing.
-	 */
-
-#if !defined(_WIN32) /*XXX: exec thread ? */
-	if (fork() == 0) {
-		setproctitle("logit");
-#endif
 
-		/* Try to map program number to name. */
+	/* Try to map program number to name. */
 
-		if (prognum == 0) {
-			progname = __UNCONST("");
-		} else if ((rpc = getrpcbynumber((int) prognum))) {
-			progname = rpc->r_name;
-		} else {
-			snprintf(progname = progbuf, sizeof(progbuf), "%u",
-			    (unsigned)prognum);
-		}
+	if (prognum == 0) {
+		progname = __UNCONST("");
+	} else if ((rpc = getrpcbynumber((int) prognum))) {
+		progname = rpc->r_name;
+	} else {
+		snprintf(progname = progbuf, sizeof(progbuf), "%u",
+		    (unsigned)prognum);
+	}
 
-		/* Try to map procedure number to name. */
+	/* Try to map procedure number to name. */
 
-		if (procnum >= (sizeof procmap / sizeof (char *))) {
-			snprintf(procbuf, sizeof procbuf, "%u",
-			    (unsigned)procnum);
-			procname = procbuf;
-		} else
-			procname = procmap[procnum];
+	if (procnum >= (sizeof procmap / sizeof (char *))) {
+		snprintf(procbuf, sizeof procbuf, "%u",
+		    (unsigned)procnum);
+		procname = procbuf;
+	} else
+		procname = procmap[procnum];
 
-		/* Write syslog record. */
+	/* Write syslog record. */
 
 #if defined(AF_LOCAL) /*WIN32*/
-		if (addr->sa_family == AF_LOCAL)
-			strlcpy(fromname, "local", sizeof(fromname));
-		else
+	if (addr->sa_family == AF_LOCAL)
+		strlcpy(fromname, "local", sizeof(fromname));
+	else
 #endif
-			getnameinfo(addr, SOCKLEN_SOCKADDR_PTR(addr), fromname,
-			    sizeof fromname, NULL, 0, NI_NUMERICHOST);
+		getnameinfo(addr, SOCKLEN_SOCKADDR_PTR(addr), fromname,
+		    sizeof fromname, NULL, 0, NI_NUMERICHOST);
 
-		syslog(severity, "connect from %s to %s(%s)%s",
-			fromname, procname, progname, text);
+	if (ev->suppressed || ev->dropped)
+		snprintf(suppressed, sizeof suppressed,
+		    " [%u similar suppressed, %u dropped]",
+		    ev->suppressed, ev->dropped);
 
-#if !defined(_WIN32)
-		_exit(0);
-	}
-#endif
+	syslog(ev->severity, "connect from %s to %s(%s)%s%s",
+		fromname, procname, progname, ev->text, suppressed);
 }
 
 
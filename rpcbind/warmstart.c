@@ -39,7 +39,12 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <err.h>
 #include <paths.h>
@@ -52,11 +57,22 @@
 #endif
 #include <syslog.h>
 #include <unistd.h>
+#if defined(_WIN32)
+#include <io.h>
+#endif
 
 #include "rpcbind.h"
 
 /*
- *  XXX this code is unsafe and is not used. It should be made safe.
+ *  Registrations are kept in two parts; a snapshot of the rpcb_list and
+ *  pmap_list, plus an append-only journal of the SET/UNSET operations
+ *  applied since the snapshot was taken.  Each journal record is
+ *  written with a single write() and flushed, so a crash loses at most
+ *  a torn trailing record, which is discarded on replay.
+ *
+ *  Both files are mapped and decoded with xdrmem, rather than through
+ *  the stdio XDR stream, and the journal is folded back into a fresh
+ *  snapshot once JOURNAL_COMPACT records have accumulated.
  */
 #ifdef WARMSTART
 
@@ -65,81 +81,342 @@
 #ifdef PORTMAP
 #define	PMAPFILE	_PATH_VARRUN "portmap.file"
 #endif
+#define	RPCBJOURNAL	_PATH_VARRUN "rpcbind.journal"
+
+#define	JOURNAL_MAGIC	0x524a4e4cU	/* "RJNL" */
+#define	JOURNAL_HDRSZ	(3 * BYTES_PER_XDR_UNIT)
+#define	JOURNAL_SET	1
+#define	JOURNAL_UNSET	2
+#define	JOURNAL_COMPACT	4096		/* records before a new snapshot */
+
+#ifndef O_BINARY
+#define	O_BINARY	0
+#endif
+#ifndef MAXPATHLEN
+#define	MAXPATHLEN	1024
+#endif
 
+#if defined(_WIN32)
+#define	fsync(__fd)	_commit(__fd)
+#define	ftruncate(__fd, __len) _chsize(__fd, __len)
+#endif
+
+struct wsmap {
+	char *addr;
+	size_t len;
+#if defined(_WIN32)
+	HANDLE hmap;
+#endif
+};
+
+static int journal_fd = -1;
+static unsigned journal_records;
+
+static bool_t map_file(const char *, int, struct wsmap *);
+static void unmap_file(struct wsmap *);
 static bool_t write_struct(const char *, xdrproc_t, void *);
 static bool_t read_struct(const char *, xdrproc_t, void *);
+static void journal_write(u_int, RPCB *, const char *);
+static void journal_replay(void);
+static void journal_reset(bool_t);
+
+/*
+ * Map the file read-only; an empty file results in a NULL mapping.
+ */
+static bool_t
+map_file(const char *filename, int fd, struct wsmap *map)
+{
+	struct stat sbuf;
+
+	(void)memset(map, 0, sizeof(*map));
+	if (fstat(fd, &sbuf) != 0) {
+		warn("Cannot stat `%s'", filename);
+		return FALSE;
+	}
+	if ((sbuf.st_uid != 0) || (sbuf.st_mode & S_IRWXG) ||
+	    (sbuf.st_mode & S_IRWXO)) {
+		warnx("Invalid permissions on `%s'", filename);
+		return FALSE;
+	}
+	if ((map->len = (size_t)sbuf.st_size) == 0)
+		return TRUE;
+#if defined(_WIN32)
+	map->hmap = CreateFileMapping((HANDLE)_get_osfhandle(fd), NULL,
+	    PAGE_READONLY, 0, 0, NULL);
+	if (map->hmap == NULL ||
+	    (map->addr = MapViewOfFile(map->hmap, FILE_MAP_READ, 0, 0, 0)) == NULL) {
+		if (map->hmap)
+			CloseHandle(map->hmap);
+		warnx("Cannot map `%s'", filename);
+		return FALSE;
+	}
+#else
+	map->addr = mmap(NULL, map->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map->addr == MAP_FAILED) {
+		map->addr = NULL;
+		warn("Cannot map `%s'", filename);
+		return FALSE;
+	}
+#endif
+	return TRUE;
+}
+
+static void
+unmap_file(struct wsmap *map)
+{
+	if (map->addr == NULL)
+		return;
+#if defined(_WIN32)
+	UnmapViewOfFile(map->addr);
+	CloseHandle(map->hmap);
+#else
+	(void)munmap(map->addr, map->len);
+#endif
+	map->addr = NULL;
+}
 
+/*
+ * Encode into memory and publish the result under its final name with a
+ * rename(), so a crash mid-write never leaves a truncated snapshot.
+ */
 static bool_t
 write_struct(const char *filename, xdrproc_t structproc, void *list)
 {
-	FILE *fp;
+	char tmpname[MAXPATHLEN];
+	u_long len;
+	char *buf;
 	int fd;
 	XDR xdrs;
 
-	(void)unlink(filename);
-	fd = open(filename, O_WRONLY|O_CREAT|O_EXCL, S_IRUSR|S_IWUSR);
-	if (fd == -1 || (fp = fdopen(fd, "w")) == NULL) {
-		syslog(LOG_ERR, "Cannot open `%s' (%m)", filename);
-		syslog(LOG_ERR, "Cannot save any registration");
+	len = xdr_sizeof(structproc, list);
+	if ((buf = malloc(len ? len : 1)) == NULL) {
+		syslog(LOG_ERR, "%s: Cannot allocate memory", __func__);
 		return FALSE;
 	}
-
-	xdrstdio_create(&xdrs, fp, XDR_ENCODE);
-
+	xdrmem_create(&xdrs, buf, (u_int)len, XDR_ENCODE);
 	if (structproc(&xdrs, list) == FALSE) {
 		syslog(LOG_ERR, "xdr_%s: failed", filename);
-		(void)fclose(fp);
+		XDR_DESTROY(&xdrs);
+		free(buf);
 		return (FALSE);
 	}
 	XDR_DESTROY(&xdrs);
-	(void)fclose(fp);
+
+	(void)snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+	(void)unlink(tmpname);
+	fd = open(tmpname, O_WRONLY|O_CREAT|O_EXCL|O_BINARY, S_IRUSR|S_IWUSR);
+	if (fd == -1) {
+		syslog(LOG_ERR, "Cannot open `%s' (%m)", tmpname);
+		syslog(LOG_ERR, "Cannot save any registration");
+		free(buf);
+		return FALSE;
+	}
+	if (write(fd, buf, len) != (ssize_t)len || fsync(fd) != 0) {
+		syslog(LOG_ERR, "Cannot write `%s' (%m)", tmpname);
+		(void)close(fd);
+		(void)unlink(tmpname);
+		free(buf);
+		return FALSE;
+	}
+	(void)close(fd);
+	free(buf);
+#if defined(_WIN32)
+	(void)unlink(filename);		/* rename() does not replace */
+#endif
+	if (rename(tmpname, filename) != 0) {
+		syslog(LOG_ERR, "Cannot rename `%s' (%m)", tmpname);
+		(void)unlink(tmpname);
+		return FALSE;
+	}
 	return TRUE;
 }
 
 static bool_t
 read_struct(const char *filename, xdrproc_t structproc, void *list)
 {
-	FILE *fp;
+	struct wsmap map;
 	XDR xdrs;
-	struct stat sbuf;
+	int fd;
 
-	if (stat(filename, &sbuf) != 0) {
-		warn("Cannot stat `%s'", filename);
-		goto error;
-	}
-	if ((sbuf.st_uid != 0) || (sbuf.st_mode & S_IRWXG) ||
-	    (sbuf.st_mode & S_IRWXO)) {
-		warnx("Invalid permissions on `%s'", filename);
+	if ((fd = open(filename, O_RDONLY|O_BINARY)) == -1) {
+		warn("cannot open `%s'", filename);
 		goto error;
 	}
-	fp = fopen(filename, "r");
-	if (fp == NULL) {
-		warn("cannot open `%s'", filename);
+	if (map_file(filename, fd, &map) == FALSE) {
+		(void)close(fd);
 		goto error;
 	}
-	xdrstdio_create(&xdrs, fp, XDR_DECODE);
+	(void)close(fd);
+	xdrmem_create(&xdrs, map.addr, (u_int)map.len, XDR_DECODE);
 
 	if (structproc(&xdrs, list) == FALSE) {
 		warnx("xdr_%s failed", filename);
-		(void)fclose(fp);
+		XDR_DESTROY(&xdrs);
+		unmap_file(&map);
 		goto error;
 	}
 	XDR_DESTROY(&xdrs);
-	(void)fclose(fp);
+	unmap_file(&map);
 	return TRUE;
 
 error:	warnx("Will start from scratch");
 	return FALSE;
 }
 
+/*
+ * Append a single SET/UNSET record, header and body written together.
+ */
+static void
+journal_write(u_int op, RPCB *regp, const char *owner)
+{
+	char sbuf[512], *buf = sbuf;
+	u_int magic = JOURNAL_MAGIC, len;
+	RPCB reg;
+	XDR xdrs;
+
+	if (journal_fd == -1)
+		return;			/* not open, or replaying */
+
+	reg = *regp;
+	reg.r_owner = (char *)(owner ? owner : rpcbind_superuser);
+	if (reg.r_netid == NULL)
+		reg.r_netid = "";
+	if (reg.r_addr == NULL)
+		reg.r_addr = "";
+
+	len = (u_int)xdr_sizeof((xdrproc_t) xdr_rpcb, &reg);
+	if (JOURNAL_HDRSZ + len > sizeof(sbuf) &&
+	    (buf = malloc(JOURNAL_HDRSZ + len)) == NULL) {
+		syslog(LOG_ERR, "%s: Cannot allocate memory", __func__);
+		return;
+	}
+	xdrmem_create(&xdrs, buf, JOURNAL_HDRSZ + len, XDR_ENCODE);
+	if (!xdr_u_int(&xdrs, &magic) || !xdr_u_int(&xdrs, &op) ||
+	    !xdr_u_int(&xdrs, &len) || !xdr_rpcb(&xdrs, &reg)) {
+		syslog(LOG_ERR, "xdr_%s: failed", RPCBJOURNAL);
+	} else if (write(journal_fd, buf, JOURNAL_HDRSZ + len) !=
+	    (ssize_t)(JOURNAL_HDRSZ + len) || fsync(journal_fd) != 0) {
+		syslog(LOG_ERR, "Cannot write `%s' (%m)", RPCBJOURNAL);
+	} else {
+		++journal_records;
+	}
+	XDR_DESTROY(&xdrs);
+	if (buf != sbuf)
+		free(buf);
+
+	if (journal_records >= JOURNAL_COMPACT)
+		write_warmstart();
+}
+
+/*
+ * Re-apply the journal over the current lists; replay stops at the first
+ * damaged record, which is then trimmed from the file.  Operations are
+ * idempotent, so a journal that survived a compaction is harmless.
+ */
+static void
+journal_replay(void)
+{
+	struct wsmap map;
+	size_t off = 0;
+	int fd;
+
+	if ((fd = open(RPCBJOURNAL, O_RDWR|O_BINARY)) == -1)
+		return;
+	if (map_file(RPCBJOURNAL, fd, &map) == FALSE) {
+		(void)close(fd);
+		return;
+	}
+
+	while (map.len - off >= JOURNAL_HDRSZ) {
+		u_int magic, op, len;
+		RPCB reg;
+		XDR xdrs;
+
+		xdrmem_create(&xdrs, map.addr + off, JOURNAL_HDRSZ, XDR_DECODE);
+		if (!xdr_u_int(&xdrs, &magic) || !xdr_u_int(&xdrs, &op) ||
+		    !xdr_u_int(&xdrs, &len))
+			magic = 0;
+		XDR_DESTROY(&xdrs);
+		if (magic != JOURNAL_MAGIC ||
+		    len > map.len - off - JOURNAL_HDRSZ)
+			break;
+
+		(void)memset(&reg, 0, sizeof(reg));
+		xdrmem_create(&xdrs, map.addr + off + JOURNAL_HDRSZ, len,
+		    XDR_DECODE);
+		if (!xdr_rpcb(&xdrs, &reg)) {
+			XDR_DESTROY(&xdrs);
+			xdr_free((xdrproc_t) xdr_rpcb, (char *)&reg);
+			break;
+		}
+		XDR_DESTROY(&xdrs);
+
+		if (op == JOURNAL_SET)
+			(void)map_set(&reg, reg.r_owner);
+		else if (op == JOURNAL_UNSET)
+			(void)map_unset(&reg, rpcbind_superuser);
+		xdr_free((xdrproc_t) xdr_rpcb, (char *)&reg);
+		off += JOURNAL_HDRSZ + len;
+	}
+
+	if (off != map.len) {
+		syslog(LOG_WARNING, "%s: discarding %lu trailing bytes",
+		    RPCBJOURNAL, (unsigned long)(map.len - off));
+		(void)ftruncate(fd, (off_t)off);
+	}
+	unmap_file(&map);
+	(void)close(fd);
+}
+
+/*
+ * (Re)open the journal for appending, truncated only once its records
+ * are held by a snapshot.
+ */
+static void
+journal_reset(bool_t truncate)
+{
+	if (journal_fd != -1)
+		(void)close(journal_fd);
+	if (truncate)
+		journal_records = 0;
+	journal_fd = open(RPCBJOURNAL,
+	    O_WRONLY|O_CREAT|O_APPEND|O_BINARY|(truncate ? O_TRUNC : 0),
+	    S_IRUSR|S_IWUSR);
+	if (journal_fd == -1)
+		syslog(LOG_ERR, "Cannot open `%s' (%m)", RPCBJOURNAL);
+}
+
+void
+journal_set(RPCB *regp, const char *owner)
+{
+	journal_write(JOURNAL_SET, regp, owner);
+}
+
+void
+journal_unset(RPCB *regp, const char *owner)
+{
+	journal_write(JOURNAL_UNSET, regp, owner);
+}
+
+/*
+ * Snapshot both lists, then start an empty journal; called on startup
+ * once registrations are restored, on compaction and on termination.
+ * Should the snapshot fail, the journal is kept, and appended to.
+ */
 void
 write_warmstart(void)
 {
-	(void)write_struct(RPCBFILE, (xdrproc_t) xdr_rpcblist_ptr, &list_rbl);
+	bool_t ok;
+
+	ok = write_struct(RPCBFILE, (xdrproc_t) xdr_rpcblist_ptr, &list_rbl);
 #ifdef PORTMAP
-	(void)write_struct(PMAPFILE, (xdrproc_t) xdr_pmaplist_ptr, &list_pml);
+	if (ok)
+		ok = write_struct(PMAPFILE, (xdrproc_t) xdr_pmaplist_ptr, &list_pml);
 #endif
-
+	if (ok)
+		journal_reset(TRUE);
+	else if (journal_fd == -1)
+		journal_reset(FALSE);
 }
 
 void
@@ -167,5 +444,6 @@ read_warmstart(void)
 	xdr_free((xdrproc_t) xdr_pmaplist_ptr, (char *)&list_pml);
 	list_pml = tmp_pmapl;
 #endif
+	journal_replay();
 }
 #endif
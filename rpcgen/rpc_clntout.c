@@ -57,6 +57,9 @@ static void write_program(definition *);
 static const char *ampr(const char *);
 static const char *aster(const char *);
 static void printbody(proc_list *);
+static void printasyncbody(proc_list *);
+static void printbatchbody(proc_list *);
+static void printresarg(proc_list *, const char *);
 
 #define DEFAULT_TIMEOUT 25	/* in seconds */
 static char RESULT[] = "clnt_res";
@@ -100,9 +103,81 @@ write_program(definition *def)
 			f_print(fout, "{\n");
 			printbody(proc);
 			f_print(fout, "}\n");
+			if (!asyncflag)
+				continue;
+			f_print(fout, "\nenum clnt_stat\n");
+			printasyncproto(proc, vp, 0);
+			f_print(fout, "\n{\n");
+			printasyncbody(proc);
+			f_print(fout, "}\n");
+			f_print(fout, "\nenum clnt_stat\n");
+			printasyncproto(proc, vp, 1);
+			f_print(fout, "\n{\n");
+			printbatchbody(proc);
+			f_print(fout, "}\n");
 		}
 	}
 }
+
+/*
+ * Asynchronous stubs (-P): foo_1_async() queues the call and returns,
+ * done() being called with the results once the reply is received; see
+ * clnt_call_async().  foo_1_batch() queues n calls and then waits for
+ * all of their replies.  Written for both the header and the stubs.
+ */
+void
+printasyncproto(proc_list *proc, version_list *vp, int batch)
+{
+	decl_list *l;
+	int     voidarg = (proc->arg_num < 2 &&
+		    streq(proc->args.decls->decl.type, "void"));
+
+	pvname(proc->proc_name, vp->vers_num);
+	if (batch) {
+		f_print(fout, "_batch(u_int n, ");
+		if (voidarg)
+			;
+		else if (proc->arg_num > 1)
+			f_print(fout, "%s *argv, ", proc->args.argname);
+		else {
+			ptype(proc->args.decls->decl.prefix,
+			    proc->args.decls->decl.type, 1);
+			f_print(fout, "*argv, ");
+		}
+		printresarg(proc, "*resv");
+	} else {
+		f_print(fout, "_async(");
+		if (!newstyle) {
+			ptype(proc->args.decls->decl.prefix,
+			    proc->args.decls->decl.type, 1);
+			f_print(fout, "*argp, ");
+		} else if (!voidarg) {
+			for (l = proc->args.decls; l != NULL; l = l->next)
+				pdeclaration(proc->args.argname,
+				    &l->decl, 0, ", ");
+		}
+		printresarg(proc, RESULT);
+	}
+	f_print(fout, ", void (*done)(enum clnt_stat, ");
+	printresarg(proc, "");
+	f_print(fout, ", void *), void *cookie, CLIENT *clnt)");
+}
+
+/*
+ * The result storage argument, as name.
+ */
+static void
+printresarg(proc_list *proc, const char *name)
+{
+	if (streq(proc->res_type, "void"))
+		f_print(fout, "char ");
+	else
+		ptype(proc->res_prefix, proc->res_type, 0);
+	if (*name == '*')
+		f_print(fout, "%s", name);
+	else
+		f_print(fout, "%s%s", aster(proc->res_type), name);
+}
 /* Writes out declarations of procedure's argument list.
    In either ANSI C style, in one of old rpcgen style (pass by reference),
    or new rpcgen style (multiple arguments, pass by value);
@@ -172,6 +247,66 @@ aster(const char *type)
 	}
 }
 
+/*
+ * The xdr routine and pointer for the arguments of an asynchronous
+ * call; argv indexed by i for a batch.
+ */
+static void
+printasyncargs(proc_list *proc, int batch)
+{
+	const char *argp = (newstyle ? proc->args.decls->decl.name : "argp");
+
+	if (proc->arg_num < 2 && streq(proc->args.decls->decl.type, "void")) {
+		f_print(fout, "(xdrproc_t)xdr_void, NULL");
+		return;
+	}
+	if (proc->arg_num > 1)
+		f_print(fout, "(xdrproc_t)xdr_%s, ", proc->args.argname);
+	else
+		f_print(fout, "(xdrproc_t)xdr_%s, ",
+		    stringfix(proc->args.decls->decl.type));
+	if (batch)
+		f_print(fout, "(const char *)&argv[i]");
+	else if (proc->arg_num > 1)
+		f_print(fout, "(const char *)&arg");
+	else
+		f_print(fout, "(const char *)%s%s", (newstyle ? "&" : ""),
+		    argp);
+}
+
+static void
+printasyncbody(proc_list *proc)
+{
+	decl_list *l;
+
+	if (newstyle && proc->arg_num > 1) {
+		f_print(fout, "\t%s arg;\n\n", proc->args.argname);
+		for (l = proc->args.decls; l != NULL; l = l->next)
+			f_print(fout, "\targ.%s = %s;\n",
+			    l->decl.name, l->decl.name);
+	}
+	f_print(fout, "\treturn (clnt_call_async(clnt, %s, ", proc->proc_name);
+	printasyncargs(proc, 0);
+	f_print(fout, ",\n\t    (xdrproc_t)xdr_%s, (caddr_t)%s, (clnt_done_t)done, cookie,\n",
+	    stringfix(proc->res_type), RESULT);
+	f_print(fout, "\t    TIMEOUT));\n");
+}
+
+static void
+printbatchbody(proc_list *proc)
+{
+	f_print(fout, "\tenum clnt_stat stat = RPC_SUCCESS, wstat;\n");
+	f_print(fout, "\tu_int i;\n\n");
+	f_print(fout, "\tfor (i = 0; i < n && stat == RPC_SUCCESS; i++)\n");
+	f_print(fout, "\t\tstat = clnt_call_async(clnt, %s, ", proc->proc_name);
+	printasyncargs(proc, 1);
+	f_print(fout, ",\n\t\t    (xdrproc_t)xdr_%s, (caddr_t)&resv[i], (clnt_done_t)done,\n",
+	    stringfix(proc->res_type));
+	f_print(fout, "\t\t    cookie, TIMEOUT);\n");
+	f_print(fout, "\twstat = clnt_async_wait(clnt, 0, TIMEOUT);\n");
+	f_print(fout, "\treturn (stat != RPC_SUCCESS ? stat : wstat);\n");
+}
+
 static void
 printbody(proc_list *proc)
 {
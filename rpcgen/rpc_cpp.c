@@ -0,0 +1,147 @@
+/*
+ *  rpc_cpp.c, C preprocessor for the RPC protocol compiler
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+/*
+ * The input is preprocessed by ucpp, linked in as libucpp, rather than
+ * by a separate process; its output is held in memory, handed over
+ * whole at the end, from which get_token() reads (see scan_text()).
+ * As rpccpp -C, comments are kept and #line directives emitted.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include "rpc_win32.h"
+#else
+#include <err.h>
+#endif
+
+#include "tune.h"
+#include "cpp.h"		/* not rpc_scan.h, as both define struct token */
+
+char *preprocess(const char *, const char **, int, size_t *);
+
+struct cppout {
+	char   *text;
+	size_t  len;
+	size_t  size;
+};
+
+static char *cpp_incpath[] = { STD_INCLUDE_PATH, 0 };
+static char *cpp_assertions[] = { STD_ASSERT, 0 };
+
+static void
+cpp_output(void *arg, const unsigned char *buf, size_t len)
+{
+	struct cppout *out = arg;
+
+	if (out->size - out->len <= len) {
+		size_t size = out->size * 2;
+
+		if (size - out->len <= len)
+			size = out->len + len + 1;
+		if ((out->text = realloc(out->text, size)) == NULL)
+			errx(EXIT_FAILURE, "Out of memory");
+		out->size = size;
+	}
+	(void) memcpy(out->text + out->len, buf, len);
+	out->len += len;
+}
+
+/*
+ * Preprocess infile, or stdin if NULL, with the given -D options;
+ * returns the text, terminated, and its length, or NULL on error.
+ */
+char *
+preprocess(const char *infile, const char **defines, int ndefines,
+    size_t *lenp)
+{
+	static int initialized;
+	struct lexer_state ls;
+	struct cppout out;
+	int     i, r, failed = 0;
+
+	if (!initialized) {
+		init_cpp();
+		initialized = 1;
+	}
+	(void) memset(&out, 0, sizeof(out));
+	init_lexer_state(&ls);
+	ls.flags = DEFAULT_CPP_FLAGS & ~DISCARD_COMMENTS;
+	ls.output_fn = cpp_output;
+	ls.output_arg = &out;
+#ifndef NO_UCPP_BUF
+	set_output_buffer(&ls, 0);		/* whole output, at once */
+#endif
+	init_tables(ls.flags & HANDLE_ASSERTIONS);
+	init_include_path(0);
+	if (infile != NULL) {
+#ifdef UCPP_MMAP
+		FILE   *f = fopen_mmap_file((char *)infile);
+
+		ls.input = 0;
+		if (f)
+			set_input_file(&ls, f);
+#else
+		ls.input = fopen(infile, "r");
+#endif
+		if (ls.input == NULL)
+			err(EXIT_FAILURE, "Can't open `%s'", infile);
+		set_init_filename((char *)infile, 1);
+	} else {
+		ls.input = stdin;
+		set_init_filename("<stdin>", 0);
+	}
+	for (i = 0; cpp_incpath[i]; i++)
+		add_incpath(cpp_incpath[i]);
+	for (i = 0; cpp_assertions[i]; i++)
+		make_assertion(cpp_assertions[i]);
+	for (i = 0; i < ndefines; i++)		/* -Dname[=value] */
+		if (define_macro(&ls, (char *)defines[i] + 2))
+			failed = 1;
+	if (!failed) {
+		enter_file(&ls, ls.flags);
+		while ((r = cpp(&ls)) < CPPERR_EOF)
+			if (r > 0)
+				failed = 1;
+		if (check_cpp_errors(&ls))
+			failed = 1;
+	}
+	if (ls.input == stdin)
+		ls.input = 0;
+	free_lexer_state(&ls);
+	wipeout();
+	if (failed) {
+		free(out.text);
+		return (NULL);
+	}
+	cpp_output(&out, (const unsigned char *)"", 0);
+	out.text[out.len] = 0;
+	*lenp = out.len;
+	return (out.text);
+}
+
+/*end*/
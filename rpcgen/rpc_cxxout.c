@@ -0,0 +1,587 @@
+/*
+ *  rpc_cxxout.c, C++ bindings outputter for the RPC protocol compiler
+ *
+ *  Copyright (c) 2022, Adam Young.
+ *  All rights reserved.
+ *
+ *  This file is part of oncrpc4-win32.
+ *
+ *  The applications are free software: you can redistribute it
+ *  and/or modify it under the terms of the oncrpc4-win32 License.
+ *
+ *  Redistributions of source code must retain the above copyright
+ *  notice, and must be distributed with the license document above.
+ *
+ *  Redistributions in binary form must reproduce the above copyright
+ *  notice, and must include the license document above in
+ *  the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *  This project is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the Licence for details.
+ *  ==end==
+ */
+
+/*
+ * Each definition becomes a C++ type plus its _view form, and a
+ * specialization of rpcxx::codec<> with inline encode() and decode();
+ * see <rpc/xdr_cxx.h>.  Runs of integral members are marshaled through
+ * a single XDR_INLINE() buffer, as rpc_cout does for C.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "rpc_scan.h"
+#include "rpc_parse.h"
+#include "rpc_util.h"
+#if defined(_WIN32)
+#include "rpc_win32.h"
+#endif
+
+static const char *cxx_elem(const char *, int);
+static void cxx_type(const declaration *, int);
+static void cxx_call(const declaration *, const char *, const char *,
+    const char *);
+static int cxx_inlinable(const declaration *);
+static void cxx_moveonly(const char *);
+static void cxx_decl(definition *, declaration *);
+static void cxx_typedef(definition *, int);
+static void cxx_datadef(definition *);
+static void cxx_forward(definition *);
+static int cxx_hascodec(definition *);
+static void cxx_codecdecl(definition *);
+static void cxx_inline(decl_list *, decl_list *, int);
+static void cxx_structimpl(definition *, const char *, int);
+static void cxx_unionimpl(definition *, const char *, int);
+static void cxx_typedefimpl(definition *, const char *, int);
+static void cxx_codecimpl(definition *);
+
+static const struct {
+	const char *xdr;
+	const char *cxx;
+} cxx_bases[] = {
+	{ "int",		"int32_t" },
+	{ "u_int",		"uint32_t" },
+	{ "long",		"int32_t" },
+	{ "u_long",		"uint32_t" },
+	{ "short",		"int16_t" },
+	{ "u_short",		"uint16_t" },
+	{ "char",		"char" },
+	{ "u_char",		"unsigned char" },
+	{ "longlong_t",		"int64_t" },
+	{ "u_longlong_t",	"uint64_t" },
+	{ "bool",		"bool" },
+	{ "float",		"float" },
+	{ "double",		"double" },
+	{ "quadruple",		"long double" },
+	{ NULL,			NULL }
+};
+
+static int
+cxx_findit(definition *def, const char *type)
+{
+	return (streq(def->def_name, type));
+}
+
+/*
+ * Element type; user types have a _view form.
+ */
+static const char *
+cxx_elem(const char *type, int view)
+{
+	static char buf[256];
+	int i;
+
+	for (i = 0; cxx_bases[i].xdr; i++)
+		if (streq(cxx_bases[i].xdr, type))
+			return (cxx_bases[i].cxx);
+	if (!view)
+		return (type);
+	(void) snprintf(buf, sizeof(buf), "%s_view", type);
+	return (buf);
+}
+
+/*
+ * Member type of a declaration.
+ */
+static void
+cxx_type(const declaration *dec, int view)
+{
+	const char *elem;
+
+	if (streq(dec->type, "string")) {
+		f_print(fout, view ? "std::string_view" : "std::string");
+		return;
+	}
+	if (streq(dec->type, "opaque")) {
+		if (dec->rel == REL_VECTOR)
+			f_print(fout, "std::array<char, %s>", dec->array_max);
+		else
+			f_print(fout, view ? "rpcxx::opaque_view" :
+			    "std::vector<char>");
+		return;
+	}
+	elem = cxx_elem(dec->type, view);
+	switch (dec->rel) {
+	case REL_VECTOR:
+		f_print(fout, "std::array<%s, %s>", elem, dec->array_max);
+		break;
+	case REL_ARRAY:
+		f_print(fout, "std::vector<%s>", elem);
+		break;
+	case REL_POINTER:
+		f_print(fout, "std::unique_ptr<%s>", elem);
+		break;
+	case REL_ALIAS:
+		f_print(fout, "%s", elem);
+		break;
+	}
+}
+
+/*
+ * Marshal obj, being prefix name; bounded types pass their limit.
+ */
+static void
+cxx_call(const declaration *dec, const char *op, const char *prefix,
+    const char *name)
+{
+	const char *kind;
+
+	if (dec->rel == REL_ARRAY) {
+		if (streq(dec->type, "string"))
+			kind = "string";
+		else if (streq(dec->type, "opaque"))
+			kind = "bytes";
+		else
+			kind = "array";
+		f_print(fout, "rpcxx::%s_%s(xdrs, %s%s, %s)",
+		    op, kind, prefix, name, dec->array_max);
+	} else
+		f_print(fout, "rpcxx::%s(xdrs, %s%s)", op, prefix, name);
+}
+
+/*
+ * Whether a member is an XDR unit, or a fixed array of them.
+ */
+static int
+cxx_inlinable(const declaration *dec)
+{
+	definition *def;
+
+	if (dec->rel != REL_ALIAS && dec->rel != REL_VECTOR)
+		return (0);
+	if (find_type(dec->type) != NULL)
+		return (1);
+	def = (definition *) FINDVAL(defined, dec->type, cxx_findit);
+	return (def != NULL && def->def_kind == DEF_ENUM);
+}
+
+static void
+cxx_moveonly(const char *name)
+{
+	f_print(fout, "\n");
+	f_print(fout, "\t%s() = default;\n", name);
+	f_print(fout, "\t%s(%s &&) = default;\n", name, name);
+	f_print(fout, "\t%s &operator=(%s &&) = default;\n", name, name);
+	f_print(fout, "\t%s(const %s &) = delete;\n", name, name);
+	f_print(fout, "\t%s &operator=(const %s &) = delete;\n", name, name);
+}
+
+static void
+cxx_decl(definition *def, declaration *dec)
+{
+	dec->prefix = def->def.ty.old_prefix;
+	dec->type = def->def.ty.old_type;
+	dec->rel = def->def.ty.rel;
+	dec->array_max = def->def.ty.array_max;
+	dec->name = "v";
+}
+
+/*
+ * Bounded typedefs are distinct types, so that their codecs carry
+ * the bound; the remainder are aliases.
+ */
+static void
+cxx_typedef(definition *def, int view)
+{
+	const char *name = def->def_name;
+	const char *suffix = (view ? "_view" : "");
+	const char *base, *ctor;
+	declaration dec;
+
+	cxx_decl(def, &dec);
+	if (dec.rel != REL_ARRAY) {
+		f_print(fout, "typedef ");
+		cxx_type(&dec, view);
+		f_print(fout, " %s%s;\n", name, suffix);
+		return;
+	}
+	if (streq(dec.type, "string")) {
+		base = (view ? "std::string_view" : "std::string");
+		ctor = (view ? "string_view" : "string");
+	} else if (streq(dec.type, "opaque")) {
+		base = (view ? "rpcxx::opaque_view" : "std::vector<char>");
+		ctor = (view ? "opaque_view" : "vector");
+	} else
+		base = NULL, ctor = "vector";
+
+	f_print(fout, "\nstruct %s%s : ", name, suffix);
+	if (base)
+		f_print(fout, "%s {\n\tusing %s::%s;\n", base, base, ctor);
+	else {
+		cxx_type(&dec, view);
+		f_print(fout, " {\n\tusing ");
+		cxx_type(&dec, view);
+		f_print(fout, "::%s;\n", ctor);
+	}
+	if (!view)
+		cxx_moveonly(name);
+	f_print(fout, "};\n");
+}
+
+static void
+cxx_datadef(definition *def)
+{
+	const char *name = def->def_name;
+	decl_list *dl;
+	case_list *cl;
+	enumval_list *el;
+	version_list *vp, *vq;
+	proc_list *pp, *pq;
+	declaration *dec;
+	int view;
+
+	switch (def->def_kind) {
+	case DEF_CONST:
+		f_print(fout, "\nconstexpr auto %s = %s;\n", name, def->def.co);
+		break;
+
+	case DEF_ENUM:
+		f_print(fout, "\nenum %s : int32_t {\n", name);
+		for (el = def->def.en.vals; el != NULL; el = el->next) {
+			f_print(fout, "\t%s", el->name);
+			if (el->assignment)
+				f_print(fout, " = %s", el->assignment);
+			f_print(fout, "%s\n", el->next ? "," : "");
+		}
+		f_print(fout, "};\n");
+		f_print(fout, "typedef %s %s_view;\n", name, name);
+		break;
+
+	case DEF_TYPEDEF:
+		if (def->def.ty.rel != REL_ARRAY)
+			f_print(fout, "\n");
+		cxx_typedef(def, 0);
+		cxx_typedef(def, 1);
+		break;
+
+	case DEF_STRUCT:
+		for (view = 0; view < 2; view++) {
+			f_print(fout, "\nstruct %s%s {\n", name,
+			    (view ? "_view" : ""));
+			for (dl = def->def.st.decls; dl; dl = dl->next) {
+				f_print(fout, "\t");
+				cxx_type(&dl->decl, view);
+				f_print(fout, " %s{};\n", dl->decl.name);
+			}
+			if (!view)
+				cxx_moveonly(name);
+			f_print(fout, "};\n");
+		}
+		break;
+
+	case DEF_UNION:
+		for (view = 0; view < 2; view++) {
+			f_print(fout, "\nstruct %s%s {\n", name,
+			    (view ? "_view" : ""));
+			dec = &def->def.un.enum_decl;
+			f_print(fout, "\t");
+			cxx_type(dec, view);
+			f_print(fout, " %s{};\n", dec->name);
+			for (cl = def->def.un.cases; cl; cl = cl->next) {
+				if (cl->contflag ||
+				    streq(cl->case_decl.type, "void"))
+					continue;
+				f_print(fout, "\t");
+				cxx_type(&cl->case_decl, view);
+				f_print(fout, " %s{};\n", cl->case_decl.name);
+			}
+			dec = def->def.un.default_decl;
+			if (dec && !streq(dec->type, "void")) {
+				f_print(fout, "\t");
+				cxx_type(dec, view);
+				f_print(fout, " %s{};\n", dec->name);
+			}
+			if (!view)
+				cxx_moveonly(name);
+			f_print(fout, "};\n");
+		}
+		break;
+
+	case DEF_PROGRAM:
+		f_print(fout, "\nconstexpr rpcprog_t %s = %s;\n", name,
+		    def->def.pr.prog_num);
+		for (vp = def->def.pr.versions; vp; vp = vp->next) {
+			f_print(fout, "constexpr rpcvers_t %s = %s;\n",
+			    vp->vers_name, vp->vers_num);
+			for (pp = vp->procs; pp; pp = pp->next) {
+				/* once only, where shared by versions */
+				for (vq = def->def.pr.versions; vq != vp;
+				    vq = vq->next) {
+					for (pq = vq->procs; pq; pq = pq->next)
+						if (streq(pq->proc_name,
+						    pp->proc_name))
+							break;
+					if (pq)
+						break;
+				}
+				if (vq == vp)
+					f_print(fout,
+					    "constexpr rpcproc_t %s = %s;\n",
+					    pp->proc_name, pp->proc_num);
+			}
+		}
+		break;
+	}
+}
+
+/*
+ * Structures, so that optional data may refer ahead.
+ */
+static void
+cxx_forward(definition *def)
+{
+	if (def->def_kind == DEF_STRUCT || def->def_kind == DEF_UNION ||
+	    (def->def_kind == DEF_TYPEDEF && def->def.ty.rel == REL_ARRAY))
+		f_print(fout, "struct %s;\nstruct %s_view;\n",
+		    def->def_name, def->def_name);
+}
+
+static int
+cxx_hascodec(definition *def)
+{
+	return (def->def_kind == DEF_STRUCT || def->def_kind == DEF_UNION ||
+	    (def->def_kind == DEF_TYPEDEF && def->def.ty.rel == REL_ARRAY));
+}
+
+static void
+cxx_codecdecl(definition *def)
+{
+	const char *name = def->def_name;
+	int view;
+
+	if (!cxx_hascodec(def))
+		return;
+	for (view = 0; view < 2; view++) {
+		f_print(fout, "\ntemplate <> struct codec<%s%s> {\n", name,
+		    (view ? "_view" : ""));
+		f_print(fout, "\tstatic bool encode(XDR *, const %s%s &);\n",
+		    name, (view ? "_view" : ""));
+		f_print(fout, "\tstatic bool decode(XDR *, %s%s &);\n",
+		    name, (view ? "_view" : ""));
+		f_print(fout, "};\n");
+	}
+}
+
+/*
+ * A run of XDR units, marshaled in place where the stream allows,
+ * otherwise member by member.
+ */
+static void
+cxx_inline(decl_list *first, decl_list *last, int encode)
+{
+	const char *op = (encode ? "encode" : "decode");
+	decl_list *dl;
+	const char *elem;
+	int units = 0, vectors = 0;
+
+	for (dl = first; dl != last; dl = dl->next)
+		if (dl->decl.rel == REL_VECTOR)
+			vectors++;
+		else
+			units++;
+	f_print(fout, "\tif ((buf = XDR_INLINE(xdrs, ");
+	if (vectors) {
+		f_print(fout, "(%d", units);
+		for (dl = first; dl != last; dl = dl->next)
+			if (dl->decl.rel == REL_VECTOR)
+				f_print(fout, " + %s", dl->decl.array_max);
+		f_print(fout, ")");
+	} else
+		f_print(fout, "%d", units);
+	f_print(fout, " * BYTES_PER_XDR_UNIT)) != NULL) {\n");
+
+	for (dl = first; dl != last; dl = dl->next) {
+		elem = cxx_elem(dl->decl.type, 0);
+		if (dl->decl.rel == REL_VECTOR) {
+			f_print(fout, "\t\tfor (%sauto &e : v.%s)\n\t",
+			    (encode ? "const " : ""), dl->decl.name);
+			if (encode)
+				f_print(fout, "\t\tIXDR_PUT_INT32(buf, e);\n");
+			else if (streq(elem, "bool"))
+				f_print(fout, "\t\te = (IXDR_GET_INT32(buf) != 0);\n");
+			else
+				f_print(fout, "\t\te = (%s)IXDR_GET_INT32(buf);\n",
+				    elem);
+		} else if (encode)
+			f_print(fout, "\t\tIXDR_PUT_INT32(buf, v.%s);\n",
+			    dl->decl.name);
+		else if (streq(elem, "bool"))
+			f_print(fout, "\t\tv.%s = (IXDR_GET_INT32(buf) != 0);\n",
+			    dl->decl.name);
+		else
+			f_print(fout, "\t\tv.%s = (%s)IXDR_GET_INT32(buf);\n",
+			    dl->decl.name, elem);
+	}
+
+	f_print(fout, "\t} else if (");
+	for (dl = first; dl != last; dl = dl->next) {
+		f_print(fout, "!");
+		cxx_call(&dl->decl, op, "v.", dl->decl.name);
+		if (dl->next != last)
+			f_print(fout, " ||\n\t    ");
+	}
+	f_print(fout, ")\n\t\treturn false;\n");
+}
+
+static void
+cxx_structimpl(definition *def, const char *suffix, int encode)
+{
+	const char *op = (encode ? "encode" : "decode");
+	decl_list *dl, *end;
+	int units, vectors, inlined = 0;
+
+	f_print(fout, "\ninline bool\ncodec<%s%s>::%s(XDR *xdrs, %s%s%s &v)\n{\n",
+	    def->def_name, suffix, op, (encode ? "const " : ""),
+	    def->def_name, suffix);
+
+	for (dl = def->def.st.decls; dl != NULL; dl = end) {
+		units = vectors = 0;
+		for (end = dl; end && cxx_inlinable(&end->decl);
+		    end = end->next)
+			if (end->decl.rel == REL_VECTOR)
+				vectors++;
+			else
+				units++;
+		if (doinline && (vectors || units >= doinline)) {
+			if (!inlined++)
+				f_print(fout, "\tint32_t *buf;\n\n");
+			cxx_inline(dl, end, encode);
+			continue;
+		}
+		if (end == dl)
+			end = dl->next;
+		for (; dl != end; dl = dl->next) {
+			f_print(fout, "\tif (!");
+			cxx_call(&dl->decl, op, "v.", dl->decl.name);
+			f_print(fout, ")\n\t\treturn false;\n");
+		}
+	}
+	f_print(fout, "\treturn true;\n}\n");
+}
+
+static void
+cxx_unionimpl(definition *def, const char *suffix, int encode)
+{
+	const char *op = (encode ? "encode" : "decode");
+	declaration *dec = &def->def.un.enum_decl;
+	case_list *cl;
+
+	f_print(fout, "\ninline bool\ncodec<%s%s>::%s(XDR *xdrs, %s%s%s &v)\n{\n",
+	    def->def_name, suffix, op, (encode ? "const " : ""),
+	    def->def_name, suffix);
+	f_print(fout, "\tif (!rpcxx::%s(xdrs, v.%s))\n\t\treturn false;\n",
+	    op, dec->name);
+	f_print(fout, "\tswitch (static_cast<int32_t>(v.%s)) {\n", dec->name);
+	for (cl = def->def.un.cases; cl != NULL; cl = cl->next) {
+		f_print(fout, "\tcase %s:\n", cl->case_name);
+		if (cl->contflag)
+			continue;
+		if (streq(cl->case_decl.type, "void")) {
+			f_print(fout, "\t\treturn true;\n");
+			continue;
+		}
+		f_print(fout, "\t\treturn (");
+		cxx_call(&cl->case_decl, op, "v.", cl->case_decl.name);
+		f_print(fout, ");\n");
+	}
+	f_print(fout, "\tdefault:\n");
+	dec = def->def.un.default_decl;
+	if (dec == NULL)
+		f_print(fout, "\t\treturn false;\n");
+	else if (streq(dec->type, "void"))
+		f_print(fout, "\t\treturn true;\n");
+	else {
+		f_print(fout, "\t\treturn (");
+		cxx_call(dec, op, "v.", dec->name);
+		f_print(fout, ");\n");
+	}
+	f_print(fout, "\t}\n}\n");
+}
+
+static void
+cxx_typedefimpl(definition *def, const char *suffix, int encode)
+{
+	const char *op = (encode ? "encode" : "decode");
+	declaration dec;
+
+	cxx_decl(def, &dec);
+	f_print(fout, "\ninline bool\ncodec<%s%s>::%s(XDR *xdrs, %s%s%s &v)\n{\n",
+	    def->def_name, suffix, op, (encode ? "const " : ""),
+	    def->def_name, suffix);
+	f_print(fout, "\treturn (");
+	cxx_call(&dec, op, "", "v");
+	f_print(fout, ");\n}\n");
+}
+
+static void
+cxx_codecimpl(definition *def)
+{
+	const char *suffix;
+	int view, encode;
+
+	if (!cxx_hascodec(def))
+		return;
+	for (view = 0; view < 2; view++) {
+		suffix = (view ? "_view" : "");
+		for (encode = 1; encode >= 0; encode--)
+			switch (def->def_kind) {
+			case DEF_STRUCT:
+				cxx_structimpl(def, suffix, encode);
+				break;
+			case DEF_UNION:
+				cxx_unionimpl(def, suffix, encode);
+				break;
+			default:
+				cxx_typedefimpl(def, suffix, encode);
+				break;
+			}
+	}
+}
+
+/*
+ * Write the bindings for all definitions: types in order, then the
+ * codecs, declared ahead of their definitions so that types may
+ * refer to each other.
+ */
+void
+write_cxx(void)
+{
+	list   *l;
+
+	f_print(fout, "\n");
+	for (l = defined; l != NULL; l = l->next)
+		cxx_forward(l->val);
+	for (l = defined; l != NULL; l = l->next)
+		cxx_datadef(l->val);
+
+	f_print(fout, "\nnamespace rpcxx {\n");
+	for (l = defined; l != NULL; l = l->next)
+		cxx_codecdecl(l->val);
+	for (l = defined; l != NULL; l = l->next)
+		cxx_codecimpl(l->val);
+	f_print(fout, "\n}\t/* namespace rpcxx */\n");
+}
+
+/*end*/
@@ -342,6 +342,14 @@ pprogramdef(definition *def)
 	for (vers = def->def.pr.versions; vers != NULL; vers = vers->next) {
 		for (proc = vers->procs; proc != NULL; proc = proc->next) {
 			pprocdef(proc, vers, "CLIENT *", 0);
+			if (asyncflag) {
+				f_print(fout, "enum clnt_stat ");
+				printasyncproto(proc, vers, 0);
+				f_print(fout, ";\n");
+				f_print(fout, "enum clnt_stat ");
+				printasyncproto(proc, vers, 1);
+				f_print(fout, ";\n");
+			}
 			pprocdef(proc, vers, "struct svc_req *", 1);
 		}
 	}
@@ -53,6 +53,7 @@ __RCSID("$NetBSD: rpc_main.c,v 1.44 2015/09/20 16:57:13 kamil Exp $");
 #if !defined(_WIN32)
 #include <sys/param.h>
 #include <sys/file.h>
+#include <sys/wait.h>
 #endif
 #include <sys/stat.h>
 #include <ctype.h>
@@ -94,16 +95,20 @@ struct commandline {
 	int     nflag;		/* netid flag */
 	int     sflag;		/* server stubs for the given transport */
 	int     tflag;		/* dispatch Table file */
+	int     xflag;		/* C++ bindings header */
 	int     Ssflag;		/* produce server sample code */
 	int     Scflag;		/* produce client sample code */
 	char   *infile;		/* input module name */
 	char   *outfile;	/* output module name */
+	char  **infiles;	/* input module names, multiple file mode */
+	int     ninfiles;
 };
 
 
 static char *cmdname;
 
 static const char *svcclosetime = "120";
+static const char *svcthreads;
 static const char *CPP;
 static char CPPFLAGS[] = "-C";
 static char pathbuf[MAXPATHLEN + 1];
@@ -159,9 +164,25 @@ int     exitnow;		/* If started by port monitors, exit after the call */
 int     timerflag;		/* TRUE if !indefinite && !exitnow */
 int     newstyle;		/* newstyle of passing arguments (by value) */
 int	Mflag = 0;		/* multithread safe */
+int	mtautoflag;		/* server main runs a worker pool */
+int	asyncflag;		/* asynchronous client stubs */
 static int allfiles;		/* generate all files */
 int     tirpcflag = 1;		/* generating code for tirpc, by default */
 
+static int jobs;		/* parallel jobs, multiple file mode */
+static int jobsarg;		/* ... argv index of their count */
+static int update;		/* leave outputs of unchanged inputs */
+static unsigned long long optdigest;	/* digest of the options */
+static unsigned long long outdigest;	/* ... and input, stamped if update */
+static int input_ready;		/* open_input() has its input */
+static char *cpptext;		/* preprocessed input, if in process */
+static size_t cpplen;
+
+#define DIGEST_INIT	14695981039346656037ULL	/* FNV-1a, 64 bit */
+#define DIGEST_PRIME	1099511628211ULL
+#define DIGEST_FMT	" * rpcgen digest %08lx%08lx\n"
+#define DIGEST_ARGS(h)	(unsigned long)((h) >> 32), (unsigned long)((h) & 0xffffffffUL)
+
 #if defined(__MSDOS__) || defined(_WIN32)
 static char *dos_cppfile = NULL;
 #endif
@@ -179,9 +200,20 @@ static void h_output(const char *, const char *, int, const char *);
 static void s_output(int, char *[], char *, const char *, int, const char *, int, int);
 static void l_output(const char *, const char *, int, const char *);
 static void t_output(const char *, const char *, int, const char *);
+static void x_output(const char *, const char *, int, const char *);
 static void svc_output(const char *, const char *, int, const char *);
 static void clnt_output(const char *, const char *, int, const char *);
 static int do_registers(int, char *[]);
+static char *read_all(FILE *, size_t *);
+static unsigned long long digest(unsigned long long, const char *, size_t);
+static int shared_input(const char *, unsigned long long *);
+static int uptodate(const char *, unsigned long long);
+static void close_files(void);
+struct minput;
+static int m_prepare(struct minput *, const char *, const char *);
+static void m_file(int, char *[], const struct commandline *, char *);
+static void m_spawn(int, char *[], const struct commandline *);
+static void m_files(int, char *[], const struct commandline *);
 static void addarg(const char *);
 static void putarg(int, const char *);
 static void checkfiles(const char *, const char *);
@@ -193,26 +225,10 @@ int
 main(int argc, char *argv[])
 {
 	struct commandline cmd;
+	int	i;
 
 	setprogname(argv[0]);
-	if ((CPP = getenv("RPCGEN_CPP")) == NULL) {
-#if defined(_WIN32)
-		CPP = "./rpccpp.exe";
-		if (access(CPP, 0)) {
-			char t_buffer[1024];
-			if (GetModuleFileNameA(NULL, t_buffer, sizeof(t_buffer)) > 0) {
-				strcpy(strrchr(t_buffer, '\\') + 1, "rpccpp.exe");
-				if (0 == access(t_buffer, 0)) {
-					CPP = strdup(t_buffer);
-				}
-			}
-		}
-#else
-		CPP = "/usr/bin/cpp";
-		if (access(CPP, X_OK))
-			CPP = "/usr/bin/clang-cpp";
-#endif
-	}
+	CPP = getenv("RPCGEN_CPP");	/* otherwise in process, see rpc_cpp.c */
 
 	(void) memset((char *) &cmd, 0, sizeof(struct commandline));
 	clear_args();
@@ -220,13 +236,23 @@ main(int argc, char *argv[])
 	if (!parseargs(argc, argv, &cmd))
 		usage();
 
+	if (cmd.ninfiles > 1 || jobs || update) {
+		for (i = 0; i < cmd.ninfiles; i++)
+			checkfiles(cmd.infiles[i], NULL);
+		m_files(argc, argv, &cmd);
+		docleanup = 0;
+		exit(nonfatalerrors);
+	}
+
 	if (cmd.cflag || cmd.hflag || cmd.lflag || cmd.tflag || cmd.sflag ||
-	    cmd.mflag || cmd.nflag || cmd.Ssflag || cmd.Scflag) {
+	    cmd.mflag || cmd.nflag || cmd.Ssflag || cmd.Scflag || cmd.xflag) {
 		checkfiles(cmd.infile, cmd.outfile);
 	} else
 		checkfiles(cmd.infile, NULL);
 
-	if (cmd.cflag) {
+	if (cmd.xflag) {
+		x_output(cmd.infile, "-DRPC_CXX", DONT_EXTEND, cmd.outfile);
+	} else if (cmd.cflag) {
 		c_output(cmd.infile, "-DRPC_XDR", DONT_EXTEND, cmd.outfile);
 	} else
 		if (cmd.hflag) {
@@ -344,6 +370,8 @@ add_warning(void)
 	f_print(fout, "/*\n");
 	f_print(fout, " * Please do not edit this file.\n");
 	f_print(fout, " * It was generated using rpcgen.\n");
+	if (update)
+		f_print(fout, DIGEST_FMT, DIGEST_ARGS(outdigest));
 	f_print(fout, " */\n\n");
 }
 
@@ -366,6 +394,21 @@ open_input(const char *infile, const char *define)
 	int     pd[2];
 
 	infilename = (infile == NULL) ? "<stdin>" : infile;
+	if (input_ready) {	/* see m_prepare() */
+		input_ready = 0;
+		return;
+	}
+	if (CPP == NULL) {
+		free(cpptext);
+		putarg(argcount, define);
+		if ((cpptext = preprocess(infile, arglist + FIXEDARGS,
+		    argcount - FIXEDARGS + 1, &cpplen)) == NULL) {
+			errx(EXIT_FAILURE, "C preprocessor failed [%s %s]",
+			    define, infilename);
+		}
+		scan_text(cpptext, cpplen);
+		return;
+	}
 #if defined(_WIN32)
 	{
 #define STDOUT_FILENO   1
@@ -742,6 +785,11 @@ s_output(int argc, char *argv[], char *infile,
 	f_print(fout, "\n#ifdef DEBUG\n#define RPC_SVC_FG\n#endif\n");
 	if (timerflag)
 		f_print(fout, "\n#define _RPCSVC_CLOSEDOWN %s\n", svcclosetime);
+	if (mtautoflag && !nomain) {
+		f_print(fout, "\n#ifndef _RPCSVC_THREADS\n");
+		f_print(fout, "#define _RPCSVC_THREADS %s\n", svcthreads);
+		f_print(fout, "#endif\n");
+	}
 	while ((def = get_definition()) != NULL) {
 		foundprogram |= (def->def_kind == DEF_PROGRAM);
 	}
@@ -816,6 +864,43 @@ t_output(const char *infile, const char *define, int extend,
 	}
 	write_tables();
 }
+
+/*
+ * Compile into a C++ bindings header
+ */
+static void
+x_output(const char *infile, const char *define, int extend,
+	 const char *outfile)
+{
+	const char *outfilename;
+	char   *guard;
+
+	c_initialize();
+	open_input(infile, define);
+	outfilename = extend ? extendfile(infile, outfile) : outfile;
+	open_output(infile, outfilename);
+	add_warning();
+	if (outfilename || infile)
+		guard = generate_guard(outfilename ? outfilename : infile);
+	else {
+		guard = strdup("STDIN_");
+		if (guard == NULL) {
+			err(EXIT_FAILURE, "strdup");
+		}
+	}
+
+	f_print(fout, "#ifndef _%s_CXX\n#define _%s_CXX\n\n", guard,
+	    guard);
+	f_print(fout, "#include <rpc/xdr_cxx.h>\n");
+
+	while (get_definition() != NULL)
+		continue;
+	write_cxx();
+
+	f_print(fout, "\n#endif /* !_%s_CXX */\n", guard);
+	free(guard);
+}
+
 /* sample routine for the server template */
 static void
 svc_output(const char *infile, const char *define, int extend,
@@ -888,6 +973,403 @@ clnt_output(const char *infile, const char *define, int extend,
 		(void) unlink(outfilename);
 	}
 }
+/*
+ * Multiple file mode, given several inputs, -j or -u.  Each input has
+ * the outputs requested, by default those of "rpcgen infile", named as
+ * extensions of its own.
+ *
+ * An input is preprocessed and parsed once for all its outputs, which
+ * replay its definitions, unless it tests the RPC_xxx symbols which
+ * distinguish them or includes other files; see shared_input().  With
+ * -j up to that many inputs are generated at once, each by its own
+ * process.  With -u each output is stamped with a digest of the options,
+ * the input and its own preprocessing, and left alone while that is
+ * unchanged; an unchanged shared input costs one preprocessor run, any
+ * other one per output.
+ */
+struct minput {
+	char   *infile;
+	int     shared;		/* one parse serves every output */
+	int     recorded;	/* ... which has been made */
+	int     digested;	/* shared digest complete, if update */
+	unsigned long long digest;	/* options and input */
+	unsigned long long odigest;	/* ... and preprocessing, if update */
+	char   *text;		/* preprocessed input, if shared or update */
+	size_t  len;
+};
+
+static const char *output_symbols[] = {
+	"RPC_HDR", "RPC_XDR", "RPC_CLNT", "RPC_SVC", "RPC_TBL", "RPC_CXX",
+	"RPC_SERVER", "RPC_CLIENT", NULL
+};
+
+static char *
+read_all(FILE *f, size_t *lenp)
+{
+	size_t  len = 0, size = 8192, n;
+	char   *buf;
+
+	if ((buf = malloc(size)) == NULL)
+		err(EXIT_FAILURE, "Out of memory");
+	while ((n = fread(buf + len, 1, size - len - 1, f)) > 0) {
+		len += n;
+		if (size - len < 2 &&
+		    (buf = realloc(buf, size *= 2)) == NULL)
+			err(EXIT_FAILURE, "Out of memory");
+	}
+	buf[len] = 0;
+	*lenp = len;
+	return (buf);
+}
+
+static unsigned long long
+digest(unsigned long long h, const char *p, size_t len)
+{
+	while (len--) {
+		h ^= (unsigned char)*p++;
+		h *= DIGEST_PRIME;
+	}
+	return (h);
+}
+
+/*
+ * Whether the input is the same for every output, as it neither
+ * mentions the RPC_xxx symbols nor includes a file, which might.
+ * The input is added to the digest.
+ */
+static int
+shared_input(const char *infile, unsigned long long *h)
+{
+	const char *p, *q;
+	char   *text;
+	size_t  len;
+	int     i, shared = 1;
+	FILE   *f;
+
+	if ((f = fopen(infile, "r")) == NULL)
+		err(EXIT_FAILURE, "Can't open `%s'", infile);
+	text = read_all(f, &len);
+	(void) fclose(f);
+	*h = digest(*h, text, len);
+	for (p = text; shared && (p = strstr(p, "include")) != NULL; p += 7) {
+		q = p;		/* a directive, not %#include */
+		while (q > text && (q[-1] == ' ' || q[-1] == '\t'))
+			q--;
+		if (q == text || *--q != '#')
+			continue;
+		while (q > text && (q[-1] == ' ' || q[-1] == '\t'))
+			q--;
+		if (q == text || q[-1] == '\n')
+			shared = 0;
+	}
+	for (p = text; shared && (p = strstr(p, "RPC_")) != NULL; p += 4) {
+		if (p > text && (isalnum((unsigned char)p[-1]) || p[-1] == '_'))
+			continue;
+		for (i = 0; output_symbols[i] != NULL; i++) {
+			len = strlen(output_symbols[i]);
+			if (strncmp(p, output_symbols[i], len) == 0 &&
+			    !isalnum((unsigned char)p[len]) && p[len] != '_')
+				shared = 0;
+		}
+	}
+	free(text);
+	return (shared);
+}
+
+/*
+ * Whether the output carries the digest.
+ */
+static int
+uptodate(const char *outfile, unsigned long long h)
+{
+	char    line[MAXLINESIZE], stamp[64];
+	int     i, ret = 0;
+	FILE   *f;
+
+	if ((f = fopen(outfile, "r")) == NULL)
+		return (0);
+	(void) snprintf(stamp, sizeof(stamp), DIGEST_FMT, DIGEST_ARGS(h));
+	for (i = 0; i < 6 && fgets(line, sizeof(line), f) != NULL; i++)
+		if (streq(line, stamp)) {
+			ret = 1;
+			break;
+		}
+	(void) fclose(f);
+	return (ret);
+}
+
+static void
+close_files(void)
+{
+	if (fout != NULL && fout != stdout)
+		(void) fclose(fout);
+	fout = NULL;
+	if (fin != NULL && fin != stdin)
+		(void) fclose(fin);
+	fin = NULL;
+#if !defined(_WIN32)
+	while (waitpid(-1, NULL, WNOHANG) > 0)
+		continue;	/* preprocessors */
+#endif
+}
+
+/*
+ * Ready the input for the output with the given extension; zero if
+ * it is up to date.
+ */
+static int
+m_prepare(struct minput *mi, const char *define, const char *ext)
+{
+	char   *outfilename;
+	int     stale = 1;
+
+	close_files();
+	reinitialize();
+	if (update) {
+		/* the preprocessing of each output, unless shared */
+		if (!mi->digested) {
+			free(mi->text);
+			open_input(mi->infile, define);
+			if (cpptext != NULL) {
+				mi->text = cpptext;
+				mi->len = cpplen;
+				cpptext = NULL;
+			} else
+				mi->text = read_all(fin, &mi->len);
+			close_files();
+			mi->odigest = digest(mi->digest, mi->text, mi->len);
+			mi->digested = mi->shared;
+		}
+		outfilename = extendfile(mi->infile, ext);
+		stale = !uptodate(outfilename, mi->odigest);
+		free(outfilename);
+		if (!stale)
+			return (0);
+		outdigest = mi->odigest;
+	}
+	if (mi->shared) {
+		if (!mi->recorded) {
+			if (mi->text != NULL) {
+				scan_text(mi->text, mi->len);
+				input_ready = 1;
+			}
+			open_input(mi->infile, define);
+			record_definitions();
+			close_files();
+			reinitialize();
+			mi->recorded = 1;
+		}
+		replay_definitions();
+		input_ready = 1;
+	} else if (mi->text != NULL) {
+		scan_text(mi->text, mi->len);	/* as digested */
+		input_ready = 1;
+	}
+	return (stale);
+}
+
+static void
+m_file(int argc, char *argv[], const struct commandline *cmd, char *infile)
+{
+	struct minput mi;
+	int     all;
+
+	all = !(cmd->cflag || cmd->hflag || cmd->lflag || cmd->mflag ||
+	    cmd->sflag || cmd->nflag || cmd->tflag || cmd->xflag ||
+	    cmd->Ssflag || cmd->Scflag);
+	(void) memset(&mi, 0, sizeof(mi));
+	mi.infile = infile;
+	mi.digest = optdigest;
+	mi.shared = shared_input(infile, &mi.digest);
+
+	if ((all || cmd->cflag) && m_prepare(&mi, "-DRPC_XDR", "_xdr.c"))
+		c_output(infile, "-DRPC_XDR", EXTEND, "_xdr.c");
+	if ((all || cmd->hflag) && m_prepare(&mi, "-DRPC_HDR", ".h"))
+		h_output(infile, "-DRPC_HDR", EXTEND, ".h");
+	if ((all || cmd->lflag) && m_prepare(&mi, "-DRPC_CLNT", "_clnt.c"))
+		l_output(infile, "-DRPC_CLNT", EXTEND, "_clnt.c");
+	if (cmd->sflag || cmd->mflag || cmd->nflag) {
+		if (m_prepare(&mi, "-DRPC_SVC", "_svc.c"))
+			s_output(argc, argv, infile, "-DRPC_SVC", EXTEND,
+			    "_svc.c", cmd->mflag, cmd->nflag);
+	} else if (all && m_prepare(&mi, "-DRPC_SVC", "_svc.c")) {
+		if (inetdflag || !tirpcflag)
+			s_output(allc, allv, infile, "-DRPC_SVC", EXTEND,
+			    "_svc.c", 0, 0);
+		else
+			s_output(allnc, allnv, infile, "-DRPC_SVC", EXTEND,
+			    "_svc.c", 0, 0);
+	}
+	if ((cmd->tflag || (all && tblflag)) &&
+	    m_prepare(&mi, "-DRPC_TBL", "_tbl.i"))
+		t_output(infile, "-DRPC_TBL", EXTEND, "_tbl.i");
+	if (cmd->xflag && m_prepare(&mi, "-DRPC_CXX", ".hpp"))
+		x_output(infile, "-DRPC_CXX", EXTEND, ".hpp");
+	if ((cmd->Ssflag || (all && allfiles)) &&
+	    m_prepare(&mi, "-DRPC_SERVER", "_server.c"))
+		svc_output(infile, "-DRPC_SERVER", EXTEND, "_server.c");
+	if ((cmd->Scflag || (all && allfiles)) &&
+	    m_prepare(&mi, "-DRPC_CLIENT", "_client.c"))
+		clnt_output(infile, "-DRPC_CLIENT", EXTEND, "_client.c");
+
+	close_files();
+	record_complete();
+	free(mi.text);
+}
+
+/*
+ * Generate the inputs by up to jobs processes.
+ */
+#if !defined(_WIN32)
+static void
+m_spawn(int argc, char *argv[], const struct commandline *cmd)
+{
+	int     i, running = 0, status;
+
+	(void) fflush(NULL);
+	for (i = 0; i < cmd->ninfiles || running; ) {
+		if (i < cmd->ninfiles && running < jobs) {
+			switch (fork()) {
+			case 0:
+				m_file(argc, argv, cmd, cmd->infiles[i]);
+				docleanup = 0;
+				exit(nonfatalerrors);
+			case -1:
+				err(EXIT_FAILURE, "fork");
+			}
+			running++;
+			i++;
+			continue;
+		}
+		if (wait(&status) == -1)
+			err(EXIT_FAILURE, "wait");
+		running--;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			nonfatalerrors = 1;
+	}
+}
+
+#else
+/*
+ * Quote an argument for the child's command line, which _spawnv() only
+ * joins with spaces; as parsed by the C runtime, backslashes are
+ * literal unless they precede a quote.
+ */
+static char *
+m_quote(const char *arg)
+{
+	const char *cp;
+	char   *quoted, *qp;
+	size_t  slashes;
+
+	if (*arg && strpbrk(arg, " \t\n\v\"") == NULL) {
+		if ((quoted = strdup(arg)) == NULL)
+			err(EXIT_FAILURE, "Out of memory");
+		return (quoted);
+	}
+	if ((quoted = malloc(strlen(arg) * 2 + 3)) == NULL)
+		err(EXIT_FAILURE, "Out of memory");
+	qp = quoted;
+	*qp++ = '"';
+	for (cp = arg;; cp++) {
+		for (slashes = 0; *cp == '\\'; cp++)
+			slashes++;
+		if (*cp == '\0' || *cp == '"') {
+			/* double those escaping the quote, or the closing one */
+			slashes *= 2;
+			while (slashes--)
+				*qp++ = '\\';
+			if (*cp == '\0')
+				break;
+			*qp++ = '\\';
+		} else {
+			while (slashes--)
+				*qp++ = '\\';
+		}
+		*qp++ = *cp;
+	}
+	*qp++ = '"';
+	*qp = '\0';
+	return (quoted);
+}
+
+static void
+m_spawn(int argc, char *argv[], const struct commandline *cmd)
+{
+	HANDLE  running[MAXIMUM_WAIT_OBJECTS];
+	char  **args;
+	char    exe[MAX_PATH];
+	DWORD   n = 0, w, status;
+	intptr_t h;
+	int     i, j, k;
+
+	if (jobs > MAXIMUM_WAIT_OBJECTS)
+		jobs = MAXIMUM_WAIT_OBJECTS;
+	if (GetModuleFileNameA(NULL, exe, sizeof(exe)) == 0)
+		errx(EXIT_FAILURE, "Can't find rpcgen");
+
+	/* each child: the options, with -j 1, then its input */
+	if ((args = calloc(argc + 1, sizeof(char *))) == NULL)
+		err(EXIT_FAILURE, "Out of memory");
+	for (j = k = 0; j < argc; j++) {
+		for (i = 0; i < cmd->ninfiles; i++)
+			if (argv[j] == cmd->infiles[i])
+				break;
+		if (i == cmd->ninfiles)
+			args[k++] = m_quote(j == jobsarg ? "1" : argv[j]);
+	}
+
+	(void) fflush(NULL);
+	for (i = 0; i < cmd->ninfiles || n; ) {
+		if (i < cmd->ninfiles && n < (DWORD)jobs) {
+			args[k] = m_quote(cmd->infiles[i++]);
+			h = _spawnv(_P_NOWAIT, exe, (const char * const *)args);
+			if (h == -1)
+				err(EXIT_FAILURE, "Can't run `%s'", exe);
+			free(args[k]);
+			args[k] = NULL;
+			running[n++] = (HANDLE)h;
+			continue;
+		}
+		w = WaitForMultipleObjects(n, running, FALSE, INFINITE) -
+		    WAIT_OBJECT_0;
+		if (w >= n)
+			errx(EXIT_FAILURE, "Can't wait for rpcgen");
+		if (!GetExitCodeProcess(running[w], &status) || status != 0)
+			nonfatalerrors = 1;
+		(void) CloseHandle(running[w]);
+		running[w] = running[--n];
+	}
+	while (k--)
+		free(args[k]);
+	free(args);
+}
+#endif
+
+static void
+m_files(int argc, char *argv[], const struct commandline *cmd)
+{
+	int     i, j;
+
+	/* the options, without the inputs and job count */
+	optdigest = digest(DIGEST_INIT, RPCGEN_VERSION, strlen(RPCGEN_VERSION));
+	for (j = 1; j < argc; j++) {
+		for (i = 0; i < cmd->ninfiles; i++)
+			if (argv[j] == cmd->infiles[i])
+				break;
+		if (i == cmd->ninfiles && j != jobsarg)
+			optdigest = digest(optdigest, argv[j],
+			    strlen(argv[j]) + 1);
+	}
+
+	if (jobs > 1 && cmd->ninfiles > 1) {
+		m_spawn(argc, argv, cmd);
+		return;
+	}
+	for (i = 0; i < cmd->ninfiles; i++)
+		m_file(argc, argv, cmd, cmd->infiles[i]);
+}
+
 /*
  * Perform registrations for service output
  * Return 0 if failed; 1 otherwise.
@@ -990,6 +1472,9 @@ parseargs(int argc, char *argv[], struct commandline *cmd)
 	if (argc < 2) {
 		return (0);
 	}
+	if ((cmd->infiles = calloc(argc, sizeof(char *))) == NULL) {
+		err(EXIT_FAILURE, "Out of memory");
+	}
 	allfiles = 0;
 	flag['c'] = 0;
 	flag['h'] = 0;
@@ -999,16 +1484,14 @@ parseargs(int argc, char *argv[], struct commandline *cmd)
 	flag['s'] = 0;
 	flag['n'] = 0;
 	flag['t'] = 0;
+	flag['x'] = 0;
 	flag['S'] = 0;
 	flag['C'] = 0;
 	for (i = 1; i < argc; i++) {
 		if (argv[i][0] != '-') {
-			if (cmd->infile) {
-				f_print(stderr, "Cannot specify more than one input file!\n");
-
-				return (0);
-			}
-			cmd->infile = argv[i];
+			if (cmd->infile == NULL)
+				cmd->infile = argv[i];
+			cmd->infiles[cmd->ninfiles++] = argv[i];
 		} else {
 			for (j = 1; argv[i][j] != 0; j++) {
 				c = argv[i][j];
@@ -1027,6 +1510,7 @@ parseargs(int argc, char *argv[], struct commandline *cmd)
 				case 'l':
 				case 'm':
 				case 't':
+				case 'x':
 					if (flag[c]) {
 						return (0);
 					}
@@ -1067,6 +1551,10 @@ parseargs(int argc, char *argv[], struct commandline *cmd)
 				case 'N':
 					newstyle = 1;
 					break;
+				case 'P':
+					asyncflag = 1;
+					Mflag = 1;
+					break;
 				case 'L':
 					logflag = 1;
 					break;
@@ -1079,12 +1567,30 @@ parseargs(int argc, char *argv[], struct commandline *cmd)
 				case 'T':
 					tblflag = 1;
 					break;
+				case 'u':
+					update = 1;
+					break;
+				case 'W':
+					if (++i == argc || atoi(argv[i]) <= 0) {
+						return (0);
+					}
+					svcthreads = argv[i];
+					mtautoflag = 1;
+					Mflag = 1;
+					goto nextarg;
 				case 'i':
 					if (++i == argc) {
 						return (0);
 					}
 					doinline = atoi(argv[i]);
 					goto nextarg;
+				case 'j':
+					if (++i == argc || atoi(argv[i]) <= 0) {
+						return (0);
+					}
+					jobs = atoi(argv[i]);
+					jobsarg = i;
+					goto nextarg;
 				case 'n':
 				case 'o':
 				case 's':
@@ -1146,6 +1652,7 @@ parseargs(int argc, char *argv[], struct commandline *cmd)
 	cmd->nflag = flag['n'];
 	cmd->sflag = flag['s'];
 	cmd->tflag = flag['t'];
+	cmd->xflag = flag['x'];
 	cmd->Ssflag = flag['S'];
 	cmd->Scflag = flag['C'];
 
@@ -1170,9 +1677,19 @@ parseargs(int argc, char *argv[], struct commandline *cmd)
 		f_print(stderr, "Cannot use table flags with newstyle!\n");
 		return (0);
 	}
+	/* multiple file mode: any file generation flags, no output file */
+	if (cmd->ninfiles > 1 || jobs || update) {
+		if (cmd->outfile != NULL) {
+			f_print(stderr, "Cannot specify an output file with multiple input files!\n");
+			return (0);
+		}
+		return (cmd->ninfiles != 0);
+	}
+
 	/* check no conflicts with file generation flags */
 	nflags = cmd->cflag + cmd->hflag + cmd->lflag + cmd->mflag +
-	    cmd->sflag + cmd->nflag + cmd->tflag + cmd->Ssflag + cmd->Scflag;
+	    cmd->sflag + cmd->nflag + cmd->tflag + cmd->Ssflag + cmd->Scflag +
+	    cmd->xflag;
 
 	if (nflags == 0) {
 		if (cmd->outfile != NULL || cmd->infile == NULL) {
@@ -1190,9 +1707,11 @@ static void
 usage(void)
 {
 	f_print(stderr, "usage:  %s infile\n", cmdname);
-	f_print(stderr, "\t%s [-AaBbILMNTv] [-Dname[=value]] [-i size] [-K seconds] [-Y pathname] infile\n",
+	f_print(stderr, "\t%s [-AaBbILMNPTv] [-Dname[=value]] [-i size] [-K seconds] [-W threads] [-Y pathname] infile\n",
+	    cmdname);
+	f_print(stderr, "\t%s [-u] [-j jobs] [-c] [-h] [-l] [-m] [-t] [-x] [-Sc] [-Ss] infile ...\n",
 	    cmdname);
-	f_print(stderr, "\t%s [-c | -h | -l | -m | -t | -Sc | -Ss] [-o outfile] [infile]\n",
+	f_print(stderr, "\t%s [-c | -h | -l | -m | -t | -x | -Sc | -Ss] [-o outfile] [infile]\n",
 	    cmdname);
 	f_print(stderr, "\t%s [-s nettype] [-o outfile] [infile]\n", cmdname);
 	f_print(stderr, "\t%s [-n netid] [-o outfile] [infile]\n", cmdname);
@@ -1213,6 +1732,7 @@ options_usage(void)
 	f_print(stderr, "-h\t\tgenerate header file\n");
 	f_print(stderr, "-I\t\tgenerate code for inetd support in server (for SunOS 4.1)\n");
 	f_print(stderr, "-i size\t\tsize at which to start generating inline code\n");
+	f_print(stderr, "-j jobs\t\tgenerate up to jobs input files at once\n");
 	f_print(stderr, "-K seconds\tserver exits after K seconds of inactivity\n");
 	f_print(stderr, "-L\t\tserver errors will be printed to syslog\n");
 	f_print(stderr, "-l\t\tgenerate client side stubs\n");
@@ -1220,13 +1740,17 @@ options_usage(void)
 	f_print(stderr, "-m\t\tgenerate server side stubs\n");
 	f_print(stderr, "-N\t\tsupports multiple arguments and call-by-value\n");
 	f_print(stderr, "-n netid\tgenerate server code that supports named netid\n");
+	f_print(stderr, "-P\t\tgenerate asynchronous client stubs (implies -M)\n");
 	f_print(stderr, "-o outfile\tname of the output file\n");
 	f_print(stderr, "-s nettype\tgenerate server code that supports named nettype\n");
 	f_print(stderr, "-Sc\t\tgenerate sample client code that uses remote procedures\n");
 	f_print(stderr, "-Ss\t\tgenerate sample server code that defines remote procedures\n");
-	f_print(stderr, "-T\t\tgenerate code to support RPC dispatch tables\n");
+	f_print(stderr, "-T\t\tgenerate code to support RPC dispatch tables,\n\t\tand table-driven server stubs with per-procedure counters\n");
 	f_print(stderr, "-t\t\tgenerate RPC dispatch table\n");
+	f_print(stderr, "-u\t\tleave the outputs of unchanged inputs\n");
 	f_print(stderr, "-v\t\tdisplay version number\n");
+	f_print(stderr, "-W threads\tserver serves transports with a pool of threads (implies -M)\n");
+	f_print(stderr, "-x\t\tgenerate C++ bindings header\n");
 	f_print(stderr, "-Y path\t\tdirectory name to find C preprocessor (cpp)\n");
 
 	exit(1);
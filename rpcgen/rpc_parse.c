@@ -72,6 +72,19 @@ static void get_prog_declaration(declaration *, defkind, int);
 static void get_type(const char **, const char **, defkind);
 static void unsigned_dec(const char **);
 
+/*
+ * A recorded input: its definitions in order, each with the directives
+ * which preceded it, and a final NULL definition with any trailing.
+ */
+struct recorded {
+	struct recorded *next;
+	char   *directives;
+	definition *def;
+};
+
+static struct recorded *recording;	/* record_definitions() */
+static struct recorded *replay;		/* next replayed, if replaying */
+
 /*
  * return the next definition you see
  */
@@ -81,6 +94,16 @@ get_definition(void)
 	definition *defp;
 	token   tok;
 
+	if (replay != NULL) {
+		struct recorded *r = replay;
+
+		if (r->directives != NULL)
+			f_print(fout, "%s", r->directives);
+		replay = r->next;
+		if (r->def != NULL)
+			isdefined(r->def);
+		return (r->def);
+	}
 	defp = ALLOC(definition);
 	get_token(&tok);
 	switch (tok.kind) {
@@ -113,6 +136,36 @@ get_definition(void)
 	return (defp);
 }
 
+/*
+ * Parse the input to its end, recording the definitions; each output
+ * then replays them by get_definition(), see replay_definitions(),
+ * rather than parsing the input again.
+ */
+void
+record_definitions(void)
+{
+	struct recorded **tailp = &recording;
+	struct recorded *r;
+
+	recording = replay = NULL;
+	hold_directives(1);
+	do {
+		r = ALLOC(struct recorded);
+		r->def = get_definition();
+		r->directives = take_directives();
+		r->next = NULL;
+		*tailp = r;
+		tailp = &r->next;
+	} while (r->def != NULL);
+	hold_directives(0);
+}
+
+void
+replay_definitions(void)
+{
+	replay = recording;
+}
+
 static void
 isdefined(definition *defp)
 {
@@ -157,6 +157,8 @@ struct definition {
 typedef struct definition definition;
 
 definition *get_definition(void);
+void record_definitions(void);
+void replay_definitions(void);
 
 struct bas_type
 {
@@ -50,6 +50,9 @@ __RCSID("$NetBSD: rpc_scan.c,v 1.15 2015/05/09 23:28:43 dholland Exp $");
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#if !defined(_WIN32)
+#include <err.h>
+#endif
 #include "rpc_scan.h"
 #include "rpc_parse.h"
 #include "rpc_util.h"
@@ -69,10 +72,18 @@ static int cppline(const char *);
 static int directive(const char *);
 static void printdirective(const char *);
 static void docppline(char *, int *, const char **);
+static int get_line(void);
 
 static int pushed = 0;		/* is a token pushed */
 static token lasttok;		/* last token, if pushed */
 
+static int holding;		/* directives held, not printed */
+static char *held;		/* ... in order */
+static size_t heldlen;
+
+static const char *text;	/* input, in place of fin */
+static const char *textend;
+
 /*
  * scan expecting 1 given token
  */
@@ -143,6 +154,41 @@ peekscan(tok_kind expect, token *tokp)
 	}
 	return (0);
 }
+/*
+ * Take the input from len bytes of text rather than fin, or from fin
+ * again if NULL; see preprocess().
+ */
+void
+scan_text(const char *t, size_t len)
+{
+	text = t;
+	textend = (t == NULL) ? NULL : t + len;
+}
+
+/*
+ * Read the next input line, as fgets().
+ */
+static int
+get_line(void)
+{
+	const char *nl;
+	size_t  len;
+
+	if (text == NULL)
+		return (fgets(curline, MAXLINESIZE, fin) != NULL);
+	if (text >= textend)
+		return (0);
+	len = textend - text;
+	if ((nl = memchr(text, '\n', len)) != NULL)
+		len = nl - text + 1;
+	if (len > MAXLINESIZE - 1)
+		len = MAXLINESIZE - 1;
+	(void) memcpy(curline, text, len);
+	curline[len] = 0;
+	text += len;
+	return (1);
+}
+
 /*
  * Get the next token, printing out any directive that are encountered.
  */
@@ -160,7 +206,7 @@ get_token(token *tokp)
 	for (;;) {
 		if (*where == 0) {
 			for (;;) {
-				if (!fgets(curline, MAXLINESIZE, fin)) {
+				if (!get_line()) {
 					tokp->kind = TOK_EOF;
 					*where = 0;
 					return;
@@ -451,7 +497,41 @@ directive(const char *line)
 static void
 printdirective(const char *line)
 {
-	f_print(fout, "%s", line + 1);
+	size_t len;
+
+	if (!holding) {
+		f_print(fout, "%s", line + 1);
+		return;
+	}
+	len = strlen(line + 1);
+	held = realloc(held, heldlen + len + 1);
+	if (held == NULL)
+		err(EXIT_FAILURE, "Out of memory");
+	(void) memcpy(held + heldlen, line + 1, len + 1);
+	heldlen += len;
+}
+
+/*
+ * While held, directives are kept for take_directives() rather than
+ * printed as they are scanned.
+ */
+void
+hold_directives(int hold)
+{
+	holding = hold;
+}
+
+/*
+ * The directives held since the last call, if any.
+ */
+char *
+take_directives(void)
+{
+	char *ret = held;
+
+	held = NULL;
+	heldlen = 0;
+	return (ret);
 }
 
 static void
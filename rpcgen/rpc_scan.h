@@ -106,3 +106,6 @@ void scan_num(token *);
 void peek(token *);
 int peekscan(tok_kind, token *);
 void get_token(token *);
+void scan_text(const char *, size_t);
+void hold_directives(int);
+char *take_directives(void);
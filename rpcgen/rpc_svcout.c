@@ -61,14 +61,17 @@ static char RESULT[] = "result";
 static char ROUTINE[] = "local";
 
 static void p_xdrfunc(const char *, const char *);
+static void p_argsize(proc_list *, version_list *);
 static void internal_proctype(proc_list *);
 static void write_real_program(definition *);
 static void write_program(definition *, const char *);
+static void write_dispatch(definition *, version_list *);
 static void printerr(const char *, const char *);
 static void printif(const char *, const char *, const char *, const char *);
 static void write_inetmost(char *);
 static void print_return(const char *);
 static void print_pmapunset(const char *);
+static void write_mt_auto(const char *);
 static void print_err_message(const char *);
 static void write_timeout_func(void);
 static void write_caller_func(void);
@@ -86,6 +89,22 @@ p_xdrfunc(const char *rname, const char *typename)
 	    stringfix(typename));
 }
 
+/*
+ * Size of the procedure's member of the argument union, so dispatch
+ * only clears what it decodes.
+ */
+static void
+p_argsize(proc_list *proc, version_list *vp)
+{
+	if (proc->arg_num < 2 && streq(proc->args.decls->decl.type, "void")) {
+		f_print(fout, "\t\t%s_size = 0;\n", ARG);
+		return;
+	}
+	f_print(fout, "\t\t%s_size = sizeof(%s.", ARG, ARG);
+	pvname(proc->proc_name, vp->vers_num);
+	f_print(fout, "_arg);\n");
+}
+
 static void
 internal_proctype(proc_list *plist)
 {
@@ -109,7 +128,20 @@ write_most(char *infile /* our name */, int netflag, int nomain)
 		f_print(fout, "\t\t/* Started by a port monitor ? */\n");
 		f_print(fout, "%sint _rpcfdtype;", var_type);
 		f_print(fout, "\t\t/* Whether Stream or Datagram ? */\n");
-		if (timerflag) {
+		if (timerflag && mtautoflag) {
+			/* workers update it while closedown() reads it */
+			f_print(fout, "%svolatile long _rpcsvcdirty;", var_type);
+			f_print(fout, "\t/* Requests in progress */\n");
+			f_print(fout, "#if defined(_WIN32)\n");
+			f_print(fout, "#define _RPCSVC_BUSY()\t(void) InterlockedIncrement(&_rpcsvcdirty)\n");
+			f_print(fout, "#define _RPCSVC_IDLE()\t(void) InterlockedDecrement(&_rpcsvcdirty)\n");
+			f_print(fout, "#define _RPCSVC_DIRTY()\tInterlockedCompareExchange(&_rpcsvcdirty, 0, 0)\n");
+			f_print(fout, "#else\n");
+			f_print(fout, "#define _RPCSVC_BUSY()\t(void) __atomic_add_fetch(&_rpcsvcdirty, 1, __ATOMIC_SEQ_CST)\n");
+			f_print(fout, "#define _RPCSVC_IDLE()\t(void) __atomic_sub_fetch(&_rpcsvcdirty, 1, __ATOMIC_SEQ_CST)\n");
+			f_print(fout, "#define _RPCSVC_DIRTY()\t__atomic_load_n(&_rpcsvcdirty, __ATOMIC_SEQ_CST)\n");
+			f_print(fout, "#endif\n");
+		} else if (timerflag) {
 			f_print(fout, "%sint _rpcsvcdirty;", var_type);
 			f_print(fout, "\t/* Still serving ? */\n");
 		}
@@ -254,6 +286,7 @@ write_rest(void)
 			f_print(fout, "\t}\n");
 		}
 	}
+	write_mt_auto("\t");
 	f_print(fout, "\tsvc_run();\n");
 	(void) sprintf(_errbuf, "svc_run returned");
 	print_err_message("\t");
@@ -277,6 +310,8 @@ write_programs(const char *storage)
 	}
 
 	/* write out dispatcher for each program */
+	if (tblflag)
+		write_svc_tabletype();
 	for (l = defined; l != NULL; l = l->next) {
 		def = (definition *) l->val;
 		if (def->def_kind == DEF_PROGRAM) {
@@ -345,9 +380,12 @@ write_program(definition *def, const char *storage)
 {
 	version_list *vp;
 	proc_list *proc;
-	int     filled;
+	int     filled, table;
 
 	for (vp = def->def.pr.versions; vp != NULL; vp = vp->next) {
+		table = (tblflag && svc_table_size(vp) != 0);
+		if (table)
+			write_svc_table(def, vp);
 		f_print(fout, "\n");
 		if (storage != NULL) {
 			f_print(fout, "%s ", storage);
@@ -412,6 +450,7 @@ write_program(definition *def, const char *storage)
 			f_print(fout, "\tchar *%s;\n", RESULT);
 
 		f_print(fout, "\txdrproc_t xdr_%s, xdr_%s;\n", ARG, RESULT);
+		f_print(fout, "\tsize_t %s_size;\n", ARG);
 		if (Mflag)
 			f_print(fout,
 			    "\tbool_t (*%s)(char *, void *, struct svc_req *);\n",
@@ -420,13 +459,25 @@ write_program(definition *def, const char *storage)
 			f_print(fout,
 			    "\tchar *(*%s)(char *, struct svc_req *);\n",
 			    ROUTINE);
+		if (table) {
+			f_print(fout, "\tconst struct rpcgen_dispatch *ent;\n");
+			f_print(fout, "\tstruct svc_proccount *pc;\n");
+			f_print(fout, "\tstruct timeval start;\n");
+			f_print(fout, "\tbool_t failed = FALSE;\n");
+			f_print(fout, "\tstatic int registered;\n");
+		}
 
 		f_print(fout, "\n");
 
 		if (callerflag)
 			f_print(fout, "\tcaller = transp;\n");	/* EVAS */
 		if (timerflag)
-			f_print(fout, "\t_rpcsvcdirty = 1;\n");
+			f_print(fout, mtautoflag ? "\t_RPCSVC_BUSY();\n" :
+			    "\t_rpcsvcdirty = 1;\n");
+		if (table) {
+			write_dispatch(def, vp);
+			goto getargs;
+		}
 		f_print(fout, "\tswitch (%s->rq_proc) {\n", RQSTP);
 		if (!nullproc(vp->procs)) {
 			f_print(fout, "\tcase NULLPROC:\n");
@@ -442,6 +493,7 @@ write_program(definition *def, const char *storage)
 			} else {
 				p_xdrfunc(ARG, proc->args.argname);
 			}
+			p_argsize(proc, vp);
 			p_xdrfunc(RESULT, proc->res_type);
 			if (Mflag)
 				f_print(fout,
@@ -466,9 +518,15 @@ write_program(definition *def, const char *storage)
 		print_return("\t\t");
 		f_print(fout, "\t}\n");
 
-		f_print(fout, "\t(void) memset(&%s, 0, sizeof(%s));\n", ARG, ARG);
+getargs:
+		/* clear only the member being decoded */
+		f_print(fout, "\tif (%s_size != 0)\n", ARG);
+		f_print(fout, "\t\t(void) memset(&%s, 0, %s_size);\n", ARG, ARG);
 		printif("getargs", TRANSP, "(caddr_t)&", ARG);
 		printerr("decode", TRANSP);
+		if (table)
+			f_print(fout,
+			    "\t\tsvc_proccount_done(pc, &start, TRUE);\n");
 		print_return("\t\t");
 		f_print(fout, "\t}\n");
 
@@ -487,7 +545,11 @@ write_program(definition *def, const char *storage)
 			    "\tif (%s != NULL && !svc_sendreply(%s, xdr_%s, %s)) {\n",
 			    RESULT, TRANSP, RESULT, RESULT);
 		printerr("systemerr", TRANSP);
+		if (table)
+			f_print(fout, "\t\tfailed = TRUE;\n");
 		f_print(fout, "\t}\n");
+		if (table)
+			f_print(fout, "\tsvc_proccount_done(pc, &start, failed);\n");
 
 		printif("freeargs", TRANSP, "(caddr_t)&", ARG);
 		(void) sprintf(_errbuf, "unable to free arguments");
@@ -512,6 +574,53 @@ write_program(definition *def, const char *storage)
 	}
 }
 
+/*
+ * Table-driven dispatch (-T): select the procedure by indexing the
+ * version's table, rather than by switch, and time it.
+ */
+static void
+write_dispatch(definition *def, version_list *vp)
+{
+	if (svc_table_proc(vp, 0) == NULL) {
+		f_print(fout, "\tif (%s->rq_proc == NULLPROC) {\n", RQSTP);
+		f_print(fout,
+		    "\t\t(void) svc_sendreply(%s, (xdrproc_t)xdr_void, NULL);\n", TRANSP);
+		print_return("\t\t");
+		f_print(fout, "\t}\n");
+	}
+	f_print(fout, "\tif (%s->rq_proc >= sizeof(", RQSTP);
+	pvname(def->def_name, vp->vers_num);
+	f_print(fout, "_dispatch) / sizeof(");
+	pvname(def->def_name, vp->vers_num);
+	f_print(fout, "_dispatch[0]) ||\n\t    (ent = &");
+	pvname(def->def_name, vp->vers_num);
+	f_print(fout, "_dispatch[%s->rq_proc])->routine == NULL) {\n", RQSTP);
+	printerr("noproc", TRANSP);
+	print_return("\t\t");
+	f_print(fout, "\t}\n");
+	f_print(fout, "\txdr_%s = ent->xdr_arg;\n", ARG);
+	f_print(fout, "\t%s_size = ent->len_arg;\n", ARG);
+	f_print(fout, "\txdr_%s = ent->xdr_res;\n", RESULT);
+	f_print(fout, "\t%s = ent->routine;\n", ROUTINE);
+
+	/* counters are registered by the first request */
+	f_print(fout, "\tif (!registered) {\n");
+	f_print(fout, "\t\tregistered = 1;\n");
+	f_print(fout, "\t\t(void) svc_proccount_reg(%s, %s, ",
+	    def->def_name, vp->vers_name);
+	pvname(def->def_name, vp->vers_num);
+	f_print(fout, "_counts,\n\t\t    (u_int)(sizeof(");
+	pvname(def->def_name, vp->vers_num);
+	f_print(fout, "_counts) / sizeof(");
+	pvname(def->def_name, vp->vers_num);
+	f_print(fout, "_counts[0])));\n");
+	f_print(fout, "\t}\n");
+	f_print(fout, "\tpc = &");
+	pvname(def->def_name, vp->vers_num);
+	f_print(fout, "_counts[%s->rq_proc];\n", RQSTP);
+	f_print(fout, "\tsvc_proccount_start(&start);\n");
+}
+
 static void
 printerr(const char *err, const char *transp)
 {
@@ -571,7 +680,8 @@ print_return(const char *space)
 		f_print(fout, "%sexit(0);\n", space);
 	else {
 		if (timerflag)
-			f_print(fout, "%s_rpcsvcdirty = 0;\n", space);
+			f_print(fout, mtautoflag ? "%s_RPCSVC_IDLE();\n" :
+			    "%s_rpcsvcdirty = 0;\n", space);
 		f_print(fout, "%sreturn;\n", space);
 	}
 }
@@ -595,6 +705,29 @@ print_pmapunset(const char *space)
 	}
 }
 
+/*
+ * Have svc_run() serve transports with a pool of _RPCSVC_THREADS.
+ */
+static void
+write_mt_auto(const char *sp)
+{
+	char tmpbuf[32];
+
+	if (!mtautoflag)
+		return;
+	f_print(fout, "%s{\n", sp);
+	f_print(fout, "%s\tint mode = RPC_SVC_MT_AUTO;\n", sp);
+	f_print(fout, "%s\tint threads = _RPCSVC_THREADS;\n\n", sp);
+	f_print(fout, "%s\tif (!rpc_control(RPC_SVC_MTMODE_SET, &mode) ||\n", sp);
+	f_print(fout, "%s\t    !rpc_control(RPC_SVC_THRMAX_SET, &threads)) {\n", sp);
+	(void) sprintf(_errbuf, "unable to set automatic MT mode.");
+	(void) sprintf(tmpbuf, "%s\t\t", sp);
+	print_err_message(tmpbuf);
+	f_print(fout, "%s\t\texit(1);\n", sp);
+	f_print(fout, "%s\t}\n", sp);
+	f_print(fout, "%s}\n", sp);
+}
+
 static void
 print_err_message(const char *space)
 {
@@ -654,7 +787,8 @@ write_timeout_func(void)
 	f_print(fout, "static void\n");
 	f_print(fout, "closedown(void)\n");
 	f_print(fout, "{\n");
-	f_print(fout, "\tif (_rpcsvcdirty == 0) {\n");
+	f_print(fout, mtautoflag ? "\tif (_RPCSVC_DIRTY() == 0) {\n" :
+	    "\tif (_rpcsvcdirty == 0) {\n");
 	f_print(fout, "\t\tstatic int size;\n");
 	f_print(fout, "\t\tint i, openfd;\n");
 	if (tirpcflag && pmflag) {
@@ -796,6 +930,7 @@ write_pm_most(char *infile, int netflag)
 		f_print(fout, "\t\t\t(void) alarm(_RPCSVC_CLOSEDOWN);\n");
 		f_print(fout, "\t\t}\n");
 	}
+	write_mt_auto("\t\t");
 	f_print(fout, "\t\tsvc_run();\n");
 	f_print(fout, "\t\texit(1);\n");
 	f_print(fout, "\t\t/* NOTREACHED */\n");
@@ -71,8 +71,13 @@ static const char null_entry[] = "\t(char *(*)())0,\n\
 static const char tbl_nproc[] =
     "unsigned int %s_nproc =\n\t(unsigned int)(sizeof(%s_table)/sizeof(%s_table[0]));\n\n";
 
+#define	SVCTBL_MAXPROC	256	/* largest procedure table dispatched */
+
 static void write_table(definition *);
 static void printit(const char *, const char *);
+static int findconst(definition *, const char *);
+static int proc_number(const char *, unsigned long *);
+static void psizeof(const char *, const char *);
 
 void
 write_tables(void)
@@ -182,3 +187,153 @@ printit(const char *prefix, const char *type)
 	}
 	f_print(fout, ",\n");
 }
+
+/*
+ * Table-driven service dispatch (-T): the dispatcher in the server
+ * stub indexes a table of the version's procedures by rq_proc, and
+ * counts each request; see svc_proccount_reg().
+ *
+ * This is not the rpcgen_table of -t: that table is compiled from its
+ * own file, holds the unprototyped RPCGEN_ACTION() routines the user
+ * supplies, and has no form for the -M calling convention; so the stub
+ * keeps a private table of the _svc routines it calls itself.
+ */
+void
+write_svc_tabletype(void)
+{
+	f_print(fout, "\nstruct rpcgen_dispatch {\n");
+	if (Mflag)
+		f_print(fout, "\tbool_t\t(*routine)(char *, void *, struct svc_req *);\n");
+	else
+		f_print(fout, "\tchar\t*(*routine)(char *, struct svc_req *);\n");
+	f_print(fout, "\txdrproc_t\txdr_arg;\n");
+	f_print(fout, "\tsize_t\tlen_arg;\n");
+	f_print(fout, "\txdrproc_t\txdr_res;\n");
+	f_print(fout, "};\n");
+}
+
+static int
+findconst(definition *def, const char *name)
+{
+	return (def->def_kind == DEF_CONST && streq(def->def_name, name));
+}
+
+/*
+ * Resolve a procedure number, following const definitions; returns 0
+ * where it cannot be, as for a name given by %#define.
+ */
+static int
+proc_number(const char *val, unsigned long *nump)
+{
+	definition *def;
+	char   *end;
+	int     depth;
+
+	for (depth = 0; depth < 32; depth++) {	/* bound any cycle */
+		*nump = strtoul(val, &end, 0);
+		if (end != val && *end == '\0')
+			return (1);
+		def = (definition *) FINDVAL(defined, val, findconst);
+		if (def == NULL)
+			return (0);
+		val = def->def.co;
+	}
+	return (0);
+}
+
+/*
+ * The procedure numbered num, if any.
+ */
+proc_list *
+svc_table_proc(version_list *vp, unsigned long num)
+{
+	proc_list *proc;
+	unsigned long pnum;
+
+	for (proc = vp->procs; proc != NULL; proc = proc->next)
+		if (proc_number(proc->proc_num, &pnum) && pnum == num)
+			return (proc);
+	return (NULL);
+}
+
+/*
+ * sizeof() an argument type, as ptype() would declare it.
+ */
+static void
+psizeof(const char *prefix, const char *type)
+{
+	f_print(fout, "sizeof(");
+	if (prefix != NULL)
+		f_print(fout, "%s ", streq(prefix, "enum") ? "enum" : "struct");
+	if (streq(type, "bool"))
+		f_print(fout, "bool_t)");
+	else if (streq(type, "string"))
+		f_print(fout, "char *)");
+	else
+		f_print(fout, "%s)", type);
+}
+
+/*
+ * Entries in the version's dispatch table, or 0 where the procedure
+ * numbers are too sparse to index, or not all known; the dispatcher
+ * then keeps its switch.
+ */
+unsigned long
+svc_table_size(version_list *vp)
+{
+	proc_list *proc;
+	unsigned long num, max = 0;
+
+	for (proc = vp->procs; proc != NULL; proc = proc->next) {
+		if (! proc_number(proc->proc_num, &num))
+			return (0);
+		if (num > max)
+			max = num;
+	}
+	return (max < SVCTBL_MAXPROC ? max + 1 : 0);
+}
+
+void
+write_svc_table(definition *def, version_list *vp)
+{
+	proc_list *proc;
+	unsigned long num, size = svc_table_size(vp);
+
+	f_print(fout, "\nstatic const struct rpcgen_dispatch ");
+	pvname(def->def_name, vp->vers_num);
+	f_print(fout, "_dispatch[] = {\n");
+	for (num = 0; num < size; num++) {
+		if ((proc = svc_table_proc(vp, num)) == NULL) {
+			f_print(fout, "\t{ NULL, NULL, 0, NULL },\n");
+			continue;
+		}
+		f_print(fout, "\t{ /* %s */\n", proc->proc_name);
+		if (Mflag)
+			f_print(fout,
+			    "\t    (bool_t (*)(char *, void *, struct svc_req *))");
+		else
+			f_print(fout,
+			    "\t    (char *(*)(char *, struct svc_req *))");
+		pvname_svc(proc->proc_name, vp->vers_num);
+		f_print(fout, ",\n");
+
+		if (proc->arg_num > 1)
+			f_print(fout, "\t    (xdrproc_t)xdr_%s, sizeof(%s),\n",
+			    proc->args.argname, proc->args.argname);
+		else if (streq(proc->args.decls->decl.type, "void"))
+			f_print(fout, "\t    (xdrproc_t)xdr_void, 0,\n");
+		else {
+			f_print(fout, "\t    (xdrproc_t)xdr_%s, ",
+			    stringfix(proc->args.decls->decl.type));
+			psizeof(proc->args.decls->decl.prefix,
+			    proc->args.decls->decl.type);
+			f_print(fout, ",\n");
+		}
+		f_print(fout, "\t    (xdrproc_t)xdr_%s },\n",
+		    stringfix(proc->res_type));
+	}
+	f_print(fout, "};\n");
+	f_print(fout, "static struct svc_proccount ");
+	pvname(def->def_name, vp->vers_num);
+	f_print(fout, "_counts[%lu];\n", size);
+}
@@ -101,6 +101,7 @@ reinitialize(void)
 	where = curline;
 	linenum = 0;
 	defined = NULL;
+	scan_text(NULL, 0);
 #if defined(_WIN32)
 	if (fin && fin != stdin)
 		fclose(fin);
@@ -308,6 +309,15 @@ crash(void)
 	}
 }
 
+/*
+ * The files recorded are complete; keep them should we crash.
+ */
+void
+record_complete(void)
+{
+	nfiles = 0;
+}
+
 void
 record_open(const char *file)
 {
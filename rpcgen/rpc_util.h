@@ -79,6 +79,8 @@ extern int BSDflag;
 extern int logflag;
 extern int newstyle;
 extern int Mflag;     /* multithread flag */
+extern int mtautoflag; /* worker pool server flag */
+extern int asyncflag;  /* asynchronous client stubs flag */
 extern int tirpcflag; /* flag for generating tirpc code */
 extern int doinline; /* if this is 0, then do not generate inline code */
 extern int callerflag;
@@ -120,6 +122,7 @@ void error(const char *, ...);
 #endif
 void crash(void);
 void record_open(const char *);
+void record_complete(void);
 void expected1(tok_kind) /*__dead*/;
 void expected2(tok_kind, tok_kind) /*__dead*/;
 void expected3(tok_kind, tok_kind, tok_kind) /*__dead*/;
@@ -166,12 +169,27 @@ void write_inetd_register(const char *);
  */
 void write_stubs(void);
 void printarglist(proc_list *, const char *, const char *, const char *);
+void printasyncproto(proc_list *, version_list *, int);
 
 
 /*
  * rpc_tblout routines
  */
 void write_tables(void);
+void write_svc_tabletype(void);
+unsigned long svc_table_size(version_list *);
+proc_list *svc_table_proc(version_list *, unsigned long);
+void write_svc_table(definition *, version_list *);
+
+/*
+ * rpc_cxxout routines
+ */
+void write_cxx(void);
+
+/*
+ * rpc_cpp routines
+ */
+char *preprocess(const char *, const char **, int, size_t *);
 
 /*
  * rpc_sample routines
@@ -44,7 +44,7 @@
  * the list of 'questions' which yield a true answer.
  */
 
-static HTT assertions;
+static SYMTAB assertions;
 static int assertions_init_done = 0;
 
 static struct assert *new_assertion(void)
@@ -143,7 +143,7 @@ int handle_assert(struct lexer_state *ls)
 		if (ls->ctok->type == NEWLINE) break;
 		if (ttMWS(ls->ctok->type)) continue;
 		if (ls->ctok->type == NAME) {
-			if (!(a = HTT_get(&assertions, ls->ctok->name))) {
+			if (!(a = SYM_get(&assertions, ls->ctok->name))) {
 				a = new_assertion();
 				aname = sdup(ls->ctok->name);
 				ina = 1;
@@ -206,7 +206,7 @@ handle_assert_next3:
 	/* This is a new assertion. Let's keep it. */
 	aol(a->val, a->nbval, *atl, TOKEN_LIST_MEMG);
 	if (ina) {
-		HTT_put(&assertions, a, aname);
+		SYM_put(&assertions, a, aname);
 		freemem(aname);
 	}
 	if (emit_assertions) {
@@ -257,7 +257,7 @@ int handle_unassert(struct lexer_state *ls)
 		if (ls->ctok->type == NEWLINE) break;
 		if (ttMWS(ls->ctok->type)) continue;
 		if (ls->ctok->type == NAME) {
-			if (!(a = HTT_get(&assertions, ls->ctok->name))) {
+			if (!(a = SYM_get(&assertions, ls->ctok->name))) {
 				ret = 0;
 				goto handle_unassert_warp;
 			}
@@ -280,7 +280,7 @@ handle_unassert_next:
 	}
 	if (emit_assertions)
 		fprintf(emit_output, "#unassert %s\n", HASH_ITEM_NAME(a));
-	HTT_del(&assertions, HASH_ITEM_NAME(a));
+	SYM_del(&assertions, HASH_ITEM_NAME(a));
 	return 0;
 
 handle_unassert_next2:
@@ -391,7 +391,7 @@ int destroy_assertion(char *aval)
  */
 void wipe_assertions(void)
 {
-	if (assertions_init_done) HTT_kill(&assertions);
+	if (assertions_init_done) SYM_kill(&assertions);
 	assertions_init_done = 0;
 }
 
@@ -401,7 +401,7 @@ void wipe_assertions(void)
 void init_assertions(void)
 {
 	wipe_assertions();
-	HTT_init(&assertions, del_assertion);
+	SYM_init(&assertions, del_assertion);
 	assertions_init_done = 1;
 }
 
@@ -410,7 +410,7 @@ void init_assertions(void)
  */
 struct assert *get_assertion(char *name)
 {
-	return HTT_get(&assertions, name);
+	return SYM_get(&assertions, name);
 }
 
 /*
@@ -418,5 +418,5 @@ struct assert *get_assertion(char *name)
  */
 void print_assertions(void)
 {
-	HTT_scan(&assertions, print_assert);
+	SYM_scan(&assertions, print_assert);
 }
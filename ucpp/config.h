@@ -45,6 +45,16 @@
  */
 #define LOW_MEM
 
+/* ====================================================================== */
+/*
+ * The MACRO_OPEN_HASH macro selects open addressing tables (HTO, see
+ * nhash.h) for macros and assertions, in place of the default hashed
+ * trees (HTT). Each name is hashed once per lookup, which then usually
+ * costs a single probe; this speeds up sources defining and expanding
+ * many macros, at the price of a slot array sized to the table.
+ */
+#define MACRO_OPEN_HASH
+
 /* ====================================================================== */
 /*
  * Define AMIGA for systems using "drive letters" at the beginning of
@@ -76,6 +86,13 @@
 /* #define NO_LIBC_BUF */
 /* #define NO_UCPP_BUF */
 
+/*
+ * The size of the ucpp output buffer (see also set_output_buffer()).
+ * Larger blocks reach a pipe, such as from rpccpp to rpcgen, in fewer
+ * writes.
+ */
+#define OUTPUT_BUF_MEMG		65536
+
 /*
  * On Unix stations, the system call mmap() might be used on input files.
  * This option is a subclause of ucpp internal buffering. On one station,
@@ -240,14 +240,15 @@ const char *token_name(struct token *t)
  * To speed up deeply nested and repeated inclusions, we:
  * -- use a hash table to remember where we found each file
  * -- remember when the file is protected by a #ifndef/#define/#endif
- *    construction; we can then avoid including several times a file
- *    when this is not necessary.
+ *    (or #if !defined) construction, or by #pragma once; we can then
+ *    avoid including several times a file when this is not necessary.
  * -- remember in which directory, in the include path, the file was found.
  */
 struct found_file {
 	hash_item_header head;    /* first field */
 	char *name;
 	char *protect;
+	int once;
 };
 
 /*
@@ -268,6 +269,7 @@ static struct found_file *new_found_file(void)
 
 	ff->name = 0;
 	ff->protect = 0;
+	ff->once = 0;
 	return ff;
 }
 
@@ -365,9 +367,13 @@ void init_buf_lexer_state(struct lexer_state *ls, int wb)
 	reinit_lexer_state(ls, wb);
 #ifndef NO_UCPP_BUF
 	ls->output_buf = wb ? getmem(OUTPUT_BUF_MEMG) : 0;
+	ls->output_size = wb ? OUTPUT_BUF_MEMG : 0;
+	ls->output_whole = 0;
 #endif
 	ls->sbuf = 0;
 	ls->output_fifo = 0;
+	ls->output_fn = 0;
+	ls->output_arg = 0;
 
 	ls->ctok = getmem(sizeof(struct token));
 	ls->ctok->name = getmem(ls->tknl = TOKEN_NAME_MEMG);
@@ -829,6 +835,10 @@ zero_out:
 	 * cache.
 	 */
 found_file_cache:
+	if (ff->once) {
+		find_file_error = FF_PROTECT;
+		goto zero_out;
+	}
 	if (ff->protect) {
 		if (get_macro(ff->protect)) {
 			/* file is protected, do not include it */
@@ -927,6 +937,11 @@ static FILE *find_file_next(char *name)
 		ff = HTT_get(&found_files, s);
 		if (ff) {
 			/* file was found in the cache */
+			if (ff->once) {
+				find_file_error = FF_PROTECT;
+				freemem(s);
+				return 0;
+			}
 			if (ff->protect) {
 				if (get_macro(ff->protect)) {
 					find_file_error = FF_PROTECT;
@@ -986,6 +1001,57 @@ static FILE *find_file_next(char *name)
 	return 0;
 }
 
+/*
+ * A #if opening the file may be a guardian, as #ifndef: the condition
+ * is then "!defined X" or "!defined(X)".
+ */
+static void protect_if(struct token_fifo *tf)
+{
+	struct token *t = tf->t;
+	size_t i = 0, n = tf->nt;
+	char *name;
+
+#define skip_mws()	do { if (i < n && ttMWS(t[i].type)) i ++; } while (0)
+	if (t[i ++].type != LNOT) return;
+	skip_mws();
+	if (i >= n || t[i].type != NAME || strcmp(t[i].name, "defined"))
+		return;
+	i ++;
+	skip_mws();
+	if (i < n && t[i].type == LPAR) {
+		i ++;
+		skip_mws();
+		if (i >= n || t[i].type != NAME) return;
+		name = t[i ++].name;
+		skip_mws();
+		if (i >= n || t[i ++].type != RPAR) return;
+	} else if (i < n && t[i].type == NAME) {
+		name = t[i ++].name;
+	} else return;
+#undef skip_mws
+	if (i < n) return;
+	protect_detect.state = 2;
+	protect_detect.macro = sdup(name);
+}
+
+/*
+ * #pragma once: the current file is not to be included again. Any
+ * other pragma has its first token read again.
+ */
+static int handle_pragma_once(struct lexer_state *ls)
+{
+	int r;
+
+	while (!(r = next_token(ls)) && ttMWS(ls->ctok->type));
+	if (r) return 0;
+	if (ls->ctok->type == NAME && !strcmp(ls->ctok->name, "once")) {
+		if (protect_detect.ff) protect_detect.ff->once = 1;
+		return 1;
+	}
+	ls->flags |= READ_AGAIN;
+	return 0;
+}
+
 /*
  * The #if directive. This function parse the expression, performs macro
  * expansion (and handles the "defined" operator), and call eval_expr.
@@ -1018,6 +1084,7 @@ static int handle_if(struct lexer_state *ls)
 		error(l, "void condition for a #if/#elif");
 		return -1;
 	}
+	if (protect_detect.state == 1) protect_if(&tf);
 	/* handle the "defined" operator */
 	tf1.art = tf1.nt = 0;
 	while (tf.art < tf.nt) {
@@ -1852,16 +1919,26 @@ static int handle_cpp(struct lexer_state *ls, int sharp_type)
 				ret = handle_include(ls, save_flags, 1);
 				goto handle_exit3;
 			} else if (!strcmp(ls->ctok->name, "pragma")) {
+				if (handle_pragma_once(ls)) goto handle_warp;
 				if (!(save_flags & LEXER)) {
 #ifdef PRAGMA_DUMP
 					/* dump #pragma in output */
-					struct token u;
+					struct token u, p;
+					long save_line = ls->line;
 
 					u.type = sharp_type;
 					u.line = l;
-					ls->flags = save_flags;
+					p.type = NAME;
+					p.line = l;
+					p.name = "pragma";
+					ls->flags = save_flags
+						| (ls->flags & READ_AGAIN);
+					ls->line = l;
 					print_token(ls, &u, 0);
-					print_token(ls, ls->ctok, 0);
+					print_token(ls, &p, 0);
+					if (ls->ctok->type != NEWLINE)
+						put_char(ls, ' ');
+					ls->line = save_line;
 					while (ls->flags |= LEXER,
 						!next_token(ls)) {
 						long save_line;
@@ -167,9 +167,13 @@ struct lexer_state {
 
 	/* output control */
 	FILE *output;
+	void (*output_fn)(void *, const unsigned char *, size_t);
+	void *output_arg;	/* output_fn, if set, in place of output */
 	struct token_fifo *output_fifo, *toplevel_of;
 #ifndef NO_UCPP_BUF
 	unsigned char *output_buf;
+	size_t output_size;	/* of output_buf */
+	int output_whole;	/* grow output_buf rather than flush it */
 #endif
 	size_t sbuf;
 
@@ -268,6 +272,7 @@ void flush_output(struct lexer_state *);
 #define cpp			libucpp_cpp
 #define set_identifier_char	libucpp_set_identifier_cha
 #define unset_identifier_char	libucpp_unset_identifier_c
+#define set_output_buffer	libucpp_set_output_buffer
 #endif
 
 void init_assertions(void);
@@ -295,6 +300,9 @@ int enter_file(struct lexer_state *, unsigned long);
 int cpp(struct lexer_state *);
 void set_identifier_char(int c);
 void unset_identifier_char(int c);
+#ifndef NO_UCPP_BUF
+void set_output_buffer(struct lexer_state *, size_t);
+#endif
 
 #ifdef UCPP_MMAP
 #if defined(LIBUCPP)
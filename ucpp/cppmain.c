@@ -97,6 +97,7 @@ usage(char *command_name)
 		"  -M                     emit Makefile-like dependencies instead of normal output\n"
 		"  -Ma                    emit also dependancies for system files\n"
 		"  -o file                store output in file\n"
+		"  -ob size               output buffer size, 0 to write the output once\n"
 		"\n"
 		"macro and assertion options:\n"
 		"  -Dmacro                predefine 'macro'\n"
@@ -256,6 +257,15 @@ parse_opt(int argc, char *argv[], struct lexer_state *ls)
 		} else if (!strcmp(argv[i], "-I") || !strcmp(argv[i], "-J")) {
 			i ++;
 
+#ifndef NO_UCPP_BUF
+		} else if (!strcmp(argv[i], "-ob")) {
+			if ((++ i) >= argc) {
+				error(-1, "missing size after -ob");
+				return 2;
+			}
+			set_output_buffer(ls, (size_t)strtoul(argv[i], NULL, 0));
+#endif
+
 		} else if (!strcmp(argv[i], "-o")) {
 			if ((++ i) >= argc) {
 				error(-1, "missing filename after -o");
@@ -439,6 +439,11 @@ void flush_output(struct lexer_state *ls)
 	size_t x = ls->sbuf, y = 0, z;
 
 	if (ls->sbuf == 0) return;
+	if (ls->output_fn) {
+		ls->output_fn(ls->output_arg, ls->output_buf, ls->sbuf);
+		ls->sbuf = 0;
+		return;
+	}
 	do {
 		z = fwrite(ls->output_buf + y, 1, x, ls->output);
 		x -= z;
@@ -450,6 +455,21 @@ void flush_output(struct lexer_state *ls)
 	}
 	ls->sbuf = 0;
 }
+
+/*
+ * Set the size of the output buffer, which is written, or handed to
+ * output_fn, whenever full. With a size of 0, the buffer grows instead
+ * and the whole output is handed over at once, by the final flush in
+ * check_cpp_errors().
+ */
+void set_output_buffer(struct lexer_state *ls, size_t size)
+{
+	flush_output(ls);
+	if (ls->output_buf) freemem(ls->output_buf);
+	ls->output_whole = (size == 0);
+	ls->output_size = size ? size : OUTPUT_BUF_MEMG;
+	ls->output_buf = getmem(ls->output_size);
+}
 #endif
 
 /*
@@ -460,9 +480,17 @@ static inline void write_char(struct lexer_state *ls, unsigned char c)
 {
 #ifndef NO_UCPP_BUF
 	ls->output_buf[ls->sbuf ++] = c;
-	if (ls->sbuf == OUTPUT_BUF_MEMG) flush_output(ls);
+	if (ls->sbuf == ls->output_size) {
+		if (ls->output_whole) {
+			ls->output_buf = incmem(ls->output_buf,
+				ls->output_size, 2 * ls->output_size);
+			ls->output_size *= 2;
+		} else flush_output(ls);
+	}
 #else
-	if (putc((int)c, ls->output) == EOF) {
+	if (ls->output_fn) {
+		ls->output_fn(ls->output_arg, &c, 1);
+	} else if (putc((int)c, ls->output) == EOF) {
 		error(ls->line, "output write error (disk full ?)");
 		die();
 	}
@@ -42,7 +42,7 @@
  * we store macros in a hash table, and retrieve them using their name
  * as identifier.
  */
-static HTT macros;
+static SYMTAB macros;
 static int macros_init_done = 0;
 
 static void del_macro(void *m)
@@ -121,14 +121,14 @@ static void add_special_macros(void)
 {
 	struct macro *m;
 
-	HTT_put(&macros, new_macro(), "__LINE__");
-	HTT_put(&macros, new_macro(), "__FILE__");
-	HTT_put(&macros, new_macro(), "__DATE__");
-	HTT_put(&macros, new_macro(), "__TIME__");
-	HTT_put(&macros, new_macro(), "__STDC__");
+	SYM_put(&macros, new_macro(), "__LINE__");
+	SYM_put(&macros, new_macro(), "__FILE__");
+	SYM_put(&macros, new_macro(), "__DATE__");
+	SYM_put(&macros, new_macro(), "__TIME__");
+	SYM_put(&macros, new_macro(), "__STDC__");
 	m = new_macro(); m->narg = 1;
 	m->arg = getmem(sizeof(char *)); m->arg[0] = sdup("foo");
-	HTT_put(&macros, m, "_Pragma");
+	SYM_put(&macros, m, "_Pragma");
 	if (c99_compliant) {
 #ifndef LOW_MEM
 		struct token t;
@@ -146,7 +146,7 @@ static void add_special_macros(void)
 		t.name = sdup("199901L");
 		aol(m->val.t, m->val.nt, t, TOKEN_LIST_MEMG);
 #endif
-		HTT_put(&macros, m, "__STDC_VERSION__");
+		SYM_put(&macros, m, "__STDC_VERSION__");
 	}
 	if (c99_hosted) {
 #ifndef LOW_MEM
@@ -165,7 +165,7 @@ static void add_special_macros(void)
 		t.name = sdup("1");
 		aol(m->val.t, m->val.nt, t, TOKEN_LIST_MEMG);
 #endif
-		HTT_put(&macros, m, "__STDC_HOSTED__");
+		SYM_put(&macros, m, "__STDC_HOSTED__");
 	}
 }
 
@@ -358,7 +358,7 @@ int handle_define(struct lexer_state *ls)
 	 * Since it is easy to avoid this error (with a #undef directive),
 	 * we choose to enforce the rule and emit an error.
 	 */
-	if ((n = HTT_get(&macros, mname)) != 0) {
+	if ((n = SYM_get(&macros, mname)) != 0) {
 		/* redefinition of a macro: we must check that we define
 		   it identical */
 		redef = 1;
@@ -671,7 +671,7 @@ define_end:
 		if (mval.nt) freemem(mval.t);
 	}
 #endif
-	HTT_put(&macros, m, mname);
+	SYM_put(&macros, m, mname);
 	freemem(mname);
 	if (emit_defines) print_macro(m);
 	return 0;
@@ -1286,7 +1286,7 @@ collect_args:
 
 #define ZAP_LINE(t)	do { \
 		if ((t).type == NAME) { \
-			struct macro *zlm = HTT_get(&macros, (t).name); \
+			struct macro *zlm = SYM_get(&macros, (t).name); \
 			if (zlm && zlm->nest > reject_nested) \
 				(t).line = -1 - (t).line; \
 		} \
@@ -1446,7 +1446,7 @@ collect_args:
 					cct = atl[z].t + (atl[z].art ++);
 					if (cct->type == NAME
 						&& cct->line >= 0
-						&& (nm = HTT_get(&macros,
+						&& (nm = SYM_get(&macros,
 						    cct->name))
 						&& nm->nest <=
 						    (reject_nested + 1)) {
@@ -1617,7 +1617,7 @@ collect_args:
 
 		ct = etl.t + (etl.art ++);
 		if (ct->type == NAME && ct->line >= 0
-			&& (nm = HTT_get(&macros, ct->name))) {
+			&& (nm = SYM_get(&macros, ct->name))) {
 			if (substitute_macro(ls, nm, &etl,
 				penury, reject_nested, l)) {
 				m->nest = save_nest;
@@ -1667,7 +1667,7 @@ exit_error:
  */
 void print_defines(void)
 {
-	HTT_scan(&macros, print_macro);
+	SYM_scan(&macros, print_macro);
 }
 
 /*
@@ -1713,7 +1713,7 @@ int define_macro(struct lexer_state *ls, char *def)
 		if (!*c) {
 			error(-1, "void macro name");
 			ret = 1;
-		} else if ((m = HTT_get(&macros, c))
+		} else if ((m = SYM_get(&macros, c))
 #ifdef LOW_MEM
 			&& (m->cval.length != 3
 			|| m->cval.t[0] != NUMBER
@@ -1742,7 +1742,7 @@ int define_macro(struct lexer_state *ls, char *def)
 			t.name = sdup("1");
 			aol(m->val.t, m->val.nt, t, TOKEN_LIST_MEMG);
 #endif
-			HTT_put(&macros, m, c);
+			SYM_put(&macros, m, c);
 		}
 	}
 	freemem(c);
@@ -1764,11 +1764,11 @@ int undef_macro(struct lexer_state *ls, char *def)
 		error(-1, "void macro name");
 		return 1;
 	}
-	if (HTT_get(&macros, c)) {
+	if (SYM_get(&macros, c)) {
 		if (check_special_macro(c)) {
 			error(-1, "trying to undef special macro %s", c);
 			return 1;
-		} else HTT_del(&macros, c);
+		} else SYM_del(&macros, c);
 	}
 	return 0;
 }
@@ -1785,7 +1785,7 @@ int handle_ifdef(struct lexer_state *ls)
 		if (ls->ctok->type == NEWLINE) break;
 		if (ttMWS(ls->ctok->type)) continue;
 		if (ls->ctok->type == NAME) {
-			int x = (HTT_get(&macros, ls->ctok->name) != 0);
+			int x = (SYM_get(&macros, ls->ctok->name) != 0);
 			while (!next_token(ls) && ls->ctok->type != NEWLINE)
 				if (tgd && !ttWHI(ls->ctok->type)
 					&& (ls->flags & WARN_STANDARD)) {
@@ -1820,7 +1820,7 @@ int handle_undef(struct lexer_state *ls)
 		if (ls->ctok->type == NEWLINE) break;
 		if (ttMWS(ls->ctok->type)) continue;
 		if (ls->ctok->type == NAME) {
-			struct macro *m = HTT_get(&macros, ls->ctok->name);
+			struct macro *m = SYM_get(&macros, ls->ctok->name);
 			int tgd = 1;
 
 			if (m != 0) {
@@ -1833,7 +1833,7 @@ int handle_undef(struct lexer_state *ls)
 				if (emit_defines)
 					fprintf(emit_output, "#undef %s\n",
 						ls->ctok->name);
-				HTT_del(&macros, ls->ctok->name);
+				SYM_del(&macros, ls->ctok->name);
 			}
 			while (!next_token(ls) && ls->ctok->type != NEWLINE)
 				if (tgd && !ttWHI(ls->ctok->type)
@@ -1865,8 +1865,13 @@ int handle_ifndef(struct lexer_state *ls)
 		if (ls->ctok->type == NEWLINE) break;
 		if (ttMWS(ls->ctok->type)) continue;
 		if (ls->ctok->type == NAME) {
-			int x = (HTT_get(&macros, ls->ctok->name) == 0);
+			int x = (SYM_get(&macros, ls->ctok->name) == 0);
 
+			/* before the name is overwritten by what follows */
+			if (protect_detect.state == 1) {
+				protect_detect.state = 2;
+				protect_detect.macro = sdup(ls->ctok->name);
+			}
 			while (!next_token(ls) && ls->ctok->type != NEWLINE)
 				if (tgd && !ttWHI(ls->ctok->type)
 					&& (ls->flags & WARN_STANDARD)) {
@@ -1874,10 +1879,6 @@ int handle_ifndef(struct lexer_state *ls)
 						"in #ifndef");
 					tgd = 0;
 				}
-			if (protect_detect.state == 1) {
-				protect_detect.state = 2;
-				protect_detect.macro = sdup(ls->ctok->name);
-			}
 			return x;
 		}
 		error(ls->line, "illegal macro name for #ifndef");
@@ -1899,7 +1900,7 @@ int handle_ifndef(struct lexer_state *ls)
  */
 void wipe_macros(void)
 {
-	if (macros_init_done) HTT_kill(&macros);
+	if (macros_init_done) SYM_kill(&macros);
 	macros_init_done = 0;
 }
 
@@ -1909,7 +1910,7 @@ void wipe_macros(void)
 void init_macros(void)
 {
 	wipe_macros();
-	HTT_init(&macros, del_macro);
+	SYM_init(&macros, del_macro);
 	macros_init_done = 1;
 	if (!no_special_macros) add_special_macros();
 }
@@ -1919,5 +1920,5 @@ void init_macros(void)
  */
 struct macro *get_macro(char *name)
 {
-	return HTT_get(&macros, name);
+	return SYM_get(&macros, name);
 }
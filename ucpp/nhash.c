@@ -480,3 +480,169 @@ void HTT2_kill(HTT2 *htt)
 	scan_node(htt->tree[0], htt->deldata, 1);
 	scan_node(htt->tree[1], htt->deldata, 1);
 }
+
+/*
+ * Open addressing tables. The slot array holds, for each item, its full
+ * hash value, which is computed here by FNV-1a: unlike the ELF hash, its
+ * low bits, that index the array, depend on all the name characters.
+ * A deleted item leaves a tombstone, so that probe sequences crossing its
+ * slot are not broken; tombstones are reused by insertions and dropped
+ * when the array is rebuilt.
+ */
+struct HTO_slot_ {
+	unsigned hash;
+	hash_item_header *item;
+};
+
+#define HTO_MIN_SIZE	256
+
+static hash_item_header hto_deleted;
+
+#define HTO_LIVE(s)	((s)->item != NULL && (s)->item != &hto_deleted)
+
+static unsigned hash_ident(char *name)
+{
+	unsigned h = 2166136261U;
+
+	for (; *name; name ++) {
+		h ^= *(unsigned char *)name;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/*
+ * Find the slot holding the named item or, if there is none, the slot
+ * where it should be inserted. There is always an empty slot, as the
+ * array is never more than half used.
+ */
+static struct HTO_slot_ *hto_find(HTO *hto, char *name, unsigned h)
+{
+	unsigned mask = hto->size - 1, u;
+	struct HTO_slot_ *tomb = NULL;
+
+	for (u = h & mask;; u = (u + 1) & mask) {
+		struct HTO_slot_ *s = hto->slot + u;
+
+		if (s->item == NULL) return tomb ? tomb : s;
+		if (s->item == &hto_deleted) {
+			if (tomb == NULL) tomb = s;
+		} else if (s->hash == h
+			&& strcmp(HASH_ITEM_NAME(s->item), name) == 0) {
+			return s;
+		}
+	}
+}
+
+/*
+ * Rebuild the slot array with the given size, a power of 2.
+ */
+static void hto_resize(HTO *hto, unsigned size)
+{
+	struct HTO_slot_ *old = hto->slot;
+	unsigned osize = hto->size, mask = size - 1, u;
+
+	hto->slot = getmem(size * sizeof *old);
+	for (u = 0; u < size; u ++) hto->slot[u].item = NULL;
+	hto->size = size;
+	hto->used = hto->count;
+	for (u = 0; u < osize; u ++) {
+		unsigned v;
+
+		if (!HTO_LIVE(old + u)) continue;
+		for (v = old[u].hash & mask; hto->slot[v].item != NULL;
+			v = (v + 1) & mask);
+		hto->slot[v] = old[u];
+	}
+	if (old != NULL) freemem(old);
+}
+
+/* see nhash.h */
+void HTO_init(HTO *hto, void (*deldata)(void *))
+{
+	hto->deldata = deldata;
+	hto->slot = NULL;
+	hto->size = hto->count = hto->used = 0;
+}
+
+/* see nhash.h */
+void *HTO_get(HTO *hto, char *name)
+{
+	struct HTO_slot_ *s;
+
+	if (hto->count == 0) return NULL;
+	s = hto_find(hto, name, hash_ident(name));
+	return HTO_LIVE(s) ? s->item : NULL;
+}
+
+/* see nhash.h */
+void *HTO_put(HTO *hto, void *item, char *name)
+{
+	unsigned h = hash_ident(name);
+	hash_item_header *itemg = item;
+	struct HTO_slot_ *s;
+
+	if ((hto->used + 1) * 2 > hto->size) {
+		unsigned size = HTO_MIN_SIZE;
+
+		while ((hto->count + 1) * 2 > size / 2) size *= 2;
+		hto_resize(hto, size);
+	}
+	s = hto_find(hto, name, h);
+	if (HTO_LIVE(s)) return s->item;
+	if (s->item == NULL) hto->used ++;
+	itemg->left = itemg->right = NULL;
+	itemg->ident = make_ident(name, h);
+	s->hash = h;
+	s->item = itemg;
+	hto->count ++;
+	return NULL;
+}
+
+/* see nhash.h */
+int HTO_del(HTO *hto, char *name)
+{
+	struct HTO_slot_ *s;
+	hash_item_header *node;
+	char *tmp;
+
+	if (hto->count == 0) return 0;
+	s = hto_find(hto, name, hash_ident(name));
+	if (!HTO_LIVE(s)) return 0;
+	node = s->item;
+	s->item = &hto_deleted;
+	hto->count --;
+	tmp = node->ident;
+	hto->deldata(node);
+	freemem(tmp);
+	return 1;
+}
+
+/* see nhash.h */
+void HTO_scan(HTO *hto, void (*action)(void *))
+{
+	unsigned u;
+
+	for (u = 0; u < hto->size; u ++) {
+		if (HTO_LIVE(hto->slot + u)) action(hto->slot[u].item);
+	}
+}
+
+/* see nhash.h */
+void HTO_kill(HTO *hto)
+{
+	unsigned u;
+
+	for (u = 0; u < hto->size; u ++) {
+		struct HTO_slot_ *s = hto->slot + u;
+
+		if (HTO_LIVE(s)) {
+			char *tmp = s->item->ident;
+
+			hto->deldata(s->item);
+			freemem(tmp);
+		}
+	}
+	if (hto->slot != NULL) freemem(hto->slot);
+	HTO_init(hto, hto->deldata);
+}
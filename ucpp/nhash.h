@@ -129,4 +129,32 @@ int HTT2_del(HTT2 *htt, char *name);
 void HTT2_scan(HTT2 *htt, void (*action)(void *));
 void HTT2_kill(HTT2 *htt);
 
+/*
+ * Type for an open addressing hash table, an alternative to HTT for
+ * large, lookup intensive tables (see MACRO_OPEN_HASH in tune.h). The
+ * slots are probed linearly; each holds the full hash value of its
+ * item, so that a lookup compares names only on a hash match. Items
+ * begin with a `hash_item_header', whose `left' and `right' fields are
+ * unused, and HASH_ITEM_NAME() applies. The slot array is allocated on
+ * the first insertion, and rebuilt, larger as needed, whenever it
+ * becomes half used.
+ */
+typedef struct {
+	void (*deldata)(void *);
+	struct HTO_slot_ *slot;
+	unsigned size, count, used;
+} HTO;
+
+/*
+ * The following functions are identical to the HTT_*() functions, except
+ * that they operate on the open addressing HTO tables. HTO_scan() visits
+ * the items in no particular order.
+ */
+void HTO_init(HTO *hto, void (*deldata)(void *));
+void *HTO_put(HTO *hto, void *item, char *name);
+void *HTO_get(HTO *hto, char *name);
+int HTO_del(HTO *hto, char *name);
+void HTO_scan(HTO *hto, void (*action)(void *));
+void HTO_kill(HTO *hto);
+
 #endif
@@ -44,6 +44,16 @@
  */
 #define LOW_MEM
 
+/* ====================================================================== */
+/*
+ * The MACRO_OPEN_HASH macro selects open addressing tables (HTO, see
+ * nhash.h) for macros and assertions, in place of the default hashed
+ * trees (HTT). Each name is hashed once per lookup, which then usually
+ * costs a single probe; this speeds up sources defining and expanding
+ * many macros, at the price of a slot array sized to the table.
+ */
+/* #define MACRO_OPEN_HASH */
+
 /* ====================================================================== */
 /*
  * Define AMIGA for systems using "drive letters" at the beginning of
@@ -367,7 +377,9 @@
 /* for cpp.c */
 #define COPY_LINE_LENGTH	80
 #define INPUT_BUF_MEMG		8192
-#define OUTPUT_BUF_MEMG		8192
+#ifndef OUTPUT_BUF_MEMG
+#define OUTPUT_BUF_MEMG		8192	/* see set_output_buffer() */
+#endif
 #define TOKEN_NAME_MEMG		64	/* must be at least 4 */
 #define TOKEN_LIST_MEMG		32
 #define INCPATH_MEMG		16
@@ -59,6 +59,27 @@ struct comp_token_fifo {
 #define ttMWS(x)	((x) == NONE || (x) == COMMENT || (x) == OPT_NONE)
 #define ttWHI(x)	(ttMWS(x) || (x) == NEWLINE)
 
+/*
+ * The macro and assertion tables (see MACRO_OPEN_HASH in tune.h).
+ */
+#ifdef MACRO_OPEN_HASH
+#define SYMTAB		HTO
+#define SYM_init	HTO_init
+#define SYM_put		HTO_put
+#define SYM_get		HTO_get
+#define SYM_del		HTO_del
+#define SYM_scan	HTO_scan
+#define SYM_kill	HTO_kill
+#else
+#define SYMTAB		HTT
+#define SYM_init	HTT_init
+#define SYM_put		HTT_put
+#define SYM_get		HTT_get
+#define SYM_del		HTT_del
+#define SYM_scan	HTT_scan
+#define SYM_kill	HTT_kill
+#endif
+
 /*
  * Function prototypes
  */